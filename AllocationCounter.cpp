@@ -0,0 +1,87 @@
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32) || defined(__linux__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+namespace
+{
+	thread_local size_t allocations = 0;
+	thread_local long long liveBytes = 0;
+	thread_local long long peakBytes = 0;
+
+	// Size of the block malloc really handed out, so frees subtract what was added
+	size_t blockSize(void* memory)
+	{
+#if defined(_WIN32)
+		return _msize(memory);
+#elif defined(__linux__)
+		return malloc_usable_size(memory);
+#elif defined(__APPLE__)
+		return malloc_size(memory);
+#else
+		return 0;
+#endif
+	}
+}
+
+size_t AllocationCounter::Count()
+{
+	return allocations;
+}
+
+long long AllocationCounter::LiveBytes()
+{
+	return liveBytes;
+}
+
+long long AllocationCounter::PeakBytes()
+{
+	return peakBytes;
+}
+
+void AllocationCounter::ResetPeak()
+{
+	peakBytes = liveBytes;
+}
+
+void AllocationCounter::Add(size_t otherAllocations, long long otherBytes, long long otherPeakBytes)
+{
+	allocations += otherAllocations;
+	peakBytes = std::max(peakBytes, liveBytes + otherPeakBytes);
+	liveBytes += otherBytes;
+	peakBytes = std::max(peakBytes, liveBytes);
+}
+
+// The array forms forward to these by default
+void* operator new(std::size_t size)
+{
+	allocations++;
+	if (void* memory = std::malloc(size ? size : 1))
+	{
+		liveBytes += blockSize(memory);
+		if (liveBytes > peakBytes)
+			peakBytes = liveBytes;
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (memory)
+		liveBytes -= blockSize(memory);
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	if (memory)
+		liveBytes -= blockSize(memory);
+	std::free(memory);
+}
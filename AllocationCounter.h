@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the heap allocations every thread makes through operator new. Loaders compare the
+// count of their own thread before and after an import, so the texture streaming threads
+// allocating at the same time don't show up in it. Work a thread hands to the WorkerPool is
+// counted for that thread once the loop returns, see parallelFor.
+//
+// Bytes are counted per thread as well, a thread freeing memory of another one lowers its own
+// count, so only differences within one thread mean something.
+class AllocationCounter
+{
+public:
+	// Allocations made by the calling thread since it started
+	static size_t Count();
+	// Bytes the calling thread allocated minus the bytes it freed
+	static long long LiveBytes();
+	// Highest LiveBytes since the last ResetPeak
+	static long long PeakBytes();
+	static void ResetPeak();
+	// Counts allocations other threads made for the calling one. peakBytes is their highest
+	// LiveBytes above where they started, on top of the calling thread's current LiveBytes.
+	static void Add(size_t allocations, long long bytes, long long peakBytes);
+};
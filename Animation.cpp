@@ -0,0 +1,412 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <glm/gtc/quaternion.hpp>
+
+#include "MeshProcessing.h"
+#include "WorkerPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ANIMATION_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+// MSVC compiles any intrinsic without flags
+#define TARGET_SSE41
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#endif
+#endif
+
+namespace
+{
+	// Joints a thread has to pose at least to be worth waking, about the cost of a wake-up
+	const size_t MIN_JOINTS_PER_THREAD = 512;
+
+	// Key before the time, the caller handles times outside the keys. Clips play forward, so the
+	// key of the last frame or the one after it usually is the answer without a search.
+	size_t findKey(const std::vector<float>& times, float time, unsigned int& hint)
+	{
+		size_t key = hint;
+		if (key + 1 < times.size() && times[key] <= time && time < times[key + 1])
+			return key;
+		if (key + 2 < times.size() && times[key + 1] <= time && time < times[key + 2])
+			key++;
+		else
+			key = (size_t)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+		hint = (unsigned int)key;
+		return key;
+	}
+
+	// Model space matrix of a joint's local pose, scale first, then rotation and translation
+	glm::mat4 poseMatrix(const JointPose& pose)
+	{
+		float x = pose.rotation.x, y = pose.rotation.y, z = pose.rotation.z, w = pose.rotation.w;
+		glm::mat4 matrix;
+		matrix[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * pose.scale.x;
+		matrix[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * pose.scale.y;
+		matrix[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * pose.scale.z;
+		matrix[3] = glm::vec4(glm::vec3(pose.translation), 1.0f);
+		return matrix;
+	}
+
+	void sampleChannelsScalar(const AnimationClip& clip, float time, JointPose* locals, unsigned int* keys)
+	{
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const AnimationChannel& channel = clip.channels[i];
+			size_t numKeys = std::min(channel.times.size(), channel.values.size());
+			if (numKeys == 0)
+				continue;
+			glm::vec4 value;
+			if (numKeys == 1 || time <= channel.times[0])
+			{
+				value = channel.values[0];
+			}
+			else if (time >= channel.times[numKeys - 1])
+			{
+				value = channel.values[numKeys - 1];
+			}
+			else
+			{
+				size_t key = findKey(channel.times, time, keys[i]);
+				glm::vec4 a = channel.values[key];
+				glm::vec4 b = channel.values[key + 1];
+				float span = channel.times[key + 1] - channel.times[key];
+				float t = channel.step || span <= 0.0f ? 0.0f : (time - channel.times[key]) / span;
+				// Rotations take the short way, q and -q are the same rotation
+				if (channel.path == ANIMATION_ROTATION && glm::dot(a, b) < 0.0f)
+					b = -b;
+				value = a + (b - a) * t;
+				if (channel.path == ANIMATION_ROTATION)
+					value = glm::normalize(value);
+			}
+
+			JointPose& pose = locals[channel.joint];
+			if (channel.path == ANIMATION_TRANSLATION)
+				pose.translation = value;
+			else if (channel.path == ANIMATION_ROTATION)
+				pose.rotation = value;
+			else
+				pose.scale = value;
+		}
+	}
+
+	void composeScalar(const Skeleton& skeleton, const JointPose* locals, glm::mat4* globals, glm::vec4* palette)
+	{
+		for (size_t i = 0; i < skeleton.NumJoints(); i++)
+		{
+			int parent = skeleton.parents[i];
+			globals[i] = parent >= 0 ? globals[parent] * poseMatrix(locals[i]) : poseMatrix(locals[i]);
+		}
+		for (size_t i = 0; i < skeleton.PaletteSize(); i++)
+		{
+			glm::mat4 matrix = globals[skeleton.paletteJoints[i]] * skeleton.inverseBindMatrices[i];
+			for (int row = 0; row < 3; row++)
+				palette[i * 3 + row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+		}
+	}
+
+#ifdef ANIMATION_SIMD_X86
+	// Columns of b combined with the columns of a, the product a * b
+	TARGET_SSE41 inline void multiplySse41(const __m128* a, const __m128* b, __m128* out)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			__m128 sum = _mm_mul_ps(a[0], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(0, 0, 0, 0)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a[1], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(1, 1, 1, 1))));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a[2], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(2, 2, 2, 2))));
+			out[column] = _mm_add_ps(sum, _mm_mul_ps(a[3], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(3, 3, 3, 3))));
+		}
+	}
+
+	TARGET_SSE41 void sampleChannelsSse41(const AnimationClip& clip, float time, JointPose* locals, unsigned int* keys)
+	{
+		const __m128 signBits = _mm_set1_ps(-0.0f);
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const AnimationChannel& channel = clip.channels[i];
+			size_t numKeys = std::min(channel.times.size(), channel.values.size());
+			if (numKeys == 0)
+				continue;
+			glm::vec4* target = channel.path == ANIMATION_TRANSLATION ? &locals[channel.joint].translation :
+				channel.path == ANIMATION_ROTATION ? &locals[channel.joint].rotation : &locals[channel.joint].scale;
+			if (numKeys == 1 || time <= channel.times[0])
+			{
+				*target = channel.values[0];
+				continue;
+			}
+			if (time >= channel.times[numKeys - 1])
+			{
+				*target = channel.values[numKeys - 1];
+				continue;
+			}
+
+			size_t key = findKey(channel.times, time, keys[i]);
+			float span = channel.times[key + 1] - channel.times[key];
+			float t = channel.step || span <= 0.0f ? 0.0f : (time - channel.times[key]) / span;
+			__m128 a = _mm_loadu_ps(&channel.values[key].x);
+			__m128 b = _mm_loadu_ps(&channel.values[key + 1].x);
+			if (channel.path == ANIMATION_ROTATION)
+			{
+				// Flips b by its sign bits when the dot product is negative
+				__m128 dot = _mm_dp_ps(a, b, 0xFF);
+				b = _mm_xor_ps(b, _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBits));
+			}
+			__m128 value = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+			if (channel.path == ANIMATION_ROTATION)
+				value = _mm_div_ps(value, _mm_sqrt_ps(_mm_dp_ps(value, value, 0xFF)));
+			_mm_storeu_ps(&target->x, value);
+		}
+	}
+
+	// poseMatrix with the products of the quaternion three at a time
+	TARGET_SSE41 inline void poseMatrixSse41(const JointPose& pose, __m128* out)
+	{
+		__m128 q = _mm_loadu_ps(&pose.rotation.x);
+		__m128 q2 = _mm_add_ps(q, q);
+		// 2yy 2xx 2xx and 2zz 2zz 2yy, the squares on the diagonal
+		__m128 squaresA = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 0, 0, 1)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 0, 0, 1)));
+		__m128 squaresB = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 2, 2)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 1, 2, 2)));
+		__m128 diagonal = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), squaresA), squaresB);
+		// 2xy 2xz 2yz and 2wz 2wy 2wx
+		__m128 mixed = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 0)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 2, 2, 1)));
+		__m128 byW = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3)), _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 0, 1, 2)));
+		__m128 sum = _mm_add_ps(mixed, byW);
+		__m128 difference = _mm_sub_ps(mixed, byW);
+
+		__m128 column0 = _mm_shuffle_ps(_mm_shuffle_ps(diagonal, sum, _MM_SHUFFLE(0, 0, 0, 0)), difference, _MM_SHUFFLE(3, 1, 2, 0));
+		__m128 column1 = _mm_shuffle_ps(_mm_shuffle_ps(difference, diagonal, _MM_SHUFFLE(1, 1, 0, 0)), sum, _MM_SHUFFLE(3, 2, 2, 0));
+		__m128 column2 = _mm_shuffle_ps(_mm_shuffle_ps(sum, difference, _MM_SHUFFLE(2, 2, 1, 1)), diagonal, _MM_SHUFFLE(3, 2, 2, 0));
+		__m128 scale = _mm_loadu_ps(&pose.scale.x);
+		__m128 zero = _mm_setzero_ps();
+		out[0] = _mm_blend_ps(_mm_mul_ps(column0, _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0))), zero, 8);
+		out[1] = _mm_blend_ps(_mm_mul_ps(column1, _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1, 1, 1, 1))), zero, 8);
+		out[2] = _mm_blend_ps(_mm_mul_ps(column2, _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2, 2, 2, 2))), zero, 8);
+		out[3] = _mm_blend_ps(_mm_loadu_ps(&pose.translation.x), _mm_set1_ps(1.0f), 8);
+	}
+
+	TARGET_SSE41 void composeSse41(const Skeleton& skeleton, const JointPose* locals, glm::mat4* globals, glm::vec4* palette)
+	{
+		for (size_t i = 0; i < skeleton.NumJoints(); i++)
+		{
+			__m128 local[4], product[4];
+			poseMatrixSse41(locals[i], local);
+			int parent = skeleton.parents[i];
+			if (parent >= 0)
+			{
+				__m128 a[4];
+				for (int column = 0; column < 4; column++)
+					a[column] = _mm_loadu_ps(&globals[parent][column].x);
+				multiplySse41(a, local, product);
+			}
+			else
+			{
+				std::copy(local, local + 4, product);
+			}
+			for (int column = 0; column < 4; column++)
+				_mm_storeu_ps(&globals[i][column].x, product[column]);
+		}
+
+		for (size_t i = 0; i < skeleton.PaletteSize(); i++)
+		{
+			const glm::mat4& global = globals[skeleton.paletteJoints[i]];
+			const glm::mat4& inverseBind = skeleton.inverseBindMatrices[i];
+			__m128 a[4], b[4], m[4];
+			for (int column = 0; column < 4; column++)
+			{
+				a[column] = _mm_loadu_ps(&global[column].x);
+				b[column] = _mm_loadu_ps(&inverseBind[column].x);
+			}
+			multiplySse41(a, b, m);
+			// Columns to rows, the last row of an affine matrix isn't stored
+			_MM_TRANSPOSE4_PS(m[0], m[1], m[2], m[3]);
+			_mm_storeu_ps(&palette[i * 3].x, m[0]);
+			_mm_storeu_ps(&palette[i * 3 + 1].x, m[1]);
+			_mm_storeu_ps(&palette[i * 3 + 2].x, m[2]);
+		}
+	}
+#endif
+}
+
+JointPose decomposePose(const glm::mat4& matrix)
+{
+	JointPose pose;
+	glm::vec3 scale(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+	// Axes scaled to nothing keep a length of one instead of becoming NaNs
+	glm::vec3 divisor = glm::max(scale, glm::vec3(1e-20f));
+	glm::mat3 rotation(glm::vec3(matrix[0]) / divisor.x, glm::vec3(matrix[1]) / divisor.y, glm::vec3(matrix[2]) / divisor.z);
+	// A mirroring matrix keeps a proper rotation with one axis scaled by -1
+	if (glm::determinant(rotation) < 0.0f)
+	{
+		scale.x = -scale.x;
+		rotation[0] = -rotation[0];
+	}
+	glm::quat quaternion = glm::normalize(glm::quat_cast(rotation));
+	pose.translation = glm::vec4(glm::vec3(matrix[3]), 0.0f);
+	pose.rotation = glm::vec4(quaternion.x, quaternion.y, quaternion.z, quaternion.w);
+	pose.scale = glm::vec4(scale, 0.0f);
+	return pose;
+}
+
+int Skeleton::AddJoint(const std::string& name, int parent, const JointPose& rest)
+{
+	parents.push_back(parent < (int)parents.size() ? parent : -1);
+	names.push_back(name);
+	restPose.push_back(rest);
+	return (int)parents.size() - 1;
+}
+
+int Skeleton::AddPaletteEntry(int joint, const glm::mat4& inverseBind)
+{
+	paletteJoints.push_back(joint);
+	inverseBindMatrices.push_back(inverseBind);
+	return (int)paletteJoints.size() - 1;
+}
+
+int Skeleton::FindJoint(const std::string& name) const
+{
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void JointInfluences::Add(int joint, float weight)
+{
+	// Replaces the weakest influence if the new one is stronger
+	int weakest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (weights[i] < weights[weakest])
+			weakest = i;
+	}
+	if (weight > weights[weakest])
+	{
+		joints[weakest] = joint;
+		weights[weakest] = weight;
+	}
+}
+
+VertexSkin JointInfluences::Pack() const
+{
+	VertexSkin skin = {};
+	float sum = weights[0] + weights[1] + weights[2] + weights[3];
+	if (sum <= 0.0f)
+	{
+		skin.weights[0] = 255;
+		return skin;
+	}
+	// Rounding can miss 255 by a few, the strongest influence makes up for it
+	int total = 0;
+	int strongest = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		skin.joints[i] = (GLushort)std::max(joints[i], 0);
+		skin.weights[i] = (GLubyte)std::lround(std::max(weights[i], 0.0f) / sum * 255.0f);
+		total += skin.weights[i];
+		if (weights[i] > weights[strongest])
+			strongest = i;
+	}
+	skin.weights[strongest] = (GLubyte)(skin.weights[strongest] + 255 - total);
+	return skin;
+}
+
+std::vector<JointBounds> computeJointBounds(const glm::vec3* positions, const VertexSkin* skins, size_t count)
+{
+	std::vector<JointBounds> bounds;
+	// Index into bounds of every entry seen so far, -1 for the others
+	std::vector<int> slots;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			if (skins[i].weights[j] == 0)
+				continue;
+			int entry = skins[i].joints[j];
+			if ((size_t)entry >= slots.size())
+				slots.resize(entry + 1, -1);
+			if (slots[entry] < 0)
+			{
+				slots[entry] = (int)bounds.size();
+				JointBounds added;
+				added.entry = entry;
+				added.boundsMin = added.boundsMax = positions[i];
+				bounds.push_back(added);
+				continue;
+			}
+			JointBounds& grown = bounds[slots[entry]];
+			grown.boundsMin = glm::min(grown.boundsMin, positions[i]);
+			grown.boundsMax = glm::max(grown.boundsMax, positions[i]);
+		}
+	}
+	return bounds;
+}
+
+void posedBounds(const Skeleton& skeleton, const glm::mat4* joints, const std::vector<JointBounds>& jointBounds, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (const JointBounds& bounds : jointBounds)
+	{
+		if ((size_t)bounds.entry >= skeleton.PaletteSize())
+			continue;
+		glm::mat4 matrix = joints[skeleton.paletteJoints[bounds.entry]] * skeleton.inverseBindMatrices[bounds.entry];
+		glm::vec3 entryMin, entryMax;
+		transformBounds(matrix, bounds.boundsMin, bounds.boundsMax, entryMin, entryMax);
+		boundsMin = glm::min(boundsMin, entryMin);
+		boundsMax = glm::max(boundsMax, entryMax);
+	}
+	if (boundsMin.x > boundsMax.x)
+		boundsMin = boundsMax = glm::vec3(0.0f);
+}
+
+void samplePose(const PoseJob& job)
+{
+	const Skeleton& skeleton = *job.skeleton;
+	PoseScratch& scratch = *job.scratch;
+	size_t numJoints = skeleton.NumJoints();
+	if (scratch.locals.size() < numJoints)
+	{
+		scratch.locals.resize(numJoints);
+		scratch.globals.resize(numJoints);
+	}
+	std::copy(skeleton.restPose.begin(), skeleton.restPose.end(), scratch.locals.begin());
+	if (job.clip && scratch.keys.size() != job.clip->channels.size())
+		scratch.keys.assign(job.clip->channels.size(), 0);
+
+	float time = 0.0f;
+	if (job.clip && job.clip->duration > 0.0f)
+	{
+		time = std::fmod(job.time, job.clip->duration);
+		if (time < 0.0f)
+			time += job.clip->duration;
+	}
+#ifdef ANIMATION_SIMD_X86
+	if (activeSimdLevel() >= SIMD_SSE41)
+	{
+		if (job.clip)
+			sampleChannelsSse41(*job.clip, time, scratch.locals.data(), scratch.keys.data());
+		return composeSse41(skeleton, scratch.locals.data(), scratch.globals.data(), job.palette);
+	}
+#endif
+	if (job.clip)
+		sampleChannelsScalar(*job.clip, time, scratch.locals.data(), scratch.keys.data());
+	composeScalar(skeleton, scratch.locals.data(), scratch.globals.data(), job.palette);
+}
+
+void samplePoses(const PoseJob* jobs, size_t count, unsigned int numThreads)
+{
+	size_t numJoints = 0;
+	for (size_t i = 0; i < count; i++)
+		numJoints += jobs[i].skeleton->NumJoints();
+	if (numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	numThreads = (unsigned int)std::max<size_t>(std::min<size_t>(std::min<size_t>(numThreads, numJoints / MIN_JOINTS_PER_THREAD), count), 1);
+
+	parallelFor(count, numThreads, [&](size_t i) { samplePose(jobs[i]); });
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "VertexBuffer.h"
+
+// CPU side of skeletal animation: joint hierarchies, clips and the sampler that turns them into
+// skinning matrices. Like MeshProcessing it needs no GL, so the micro benchmarks can run it.
+//
+// Poses are kept as 4 wide vectors, translations and scales with a zero w and rotations as
+// quaternions in x, y, z, w order. Interpolating keys and building the matrices run SSE4.1
+// kernels when activeSimdLevel() allows it and a scalar loop anywhere else.
+
+// Local transformation of a joint relative to its parent
+struct JointPose
+{
+	glm::vec4 translation = glm::vec4(0.0f);
+	glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	glm::vec4 scale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+};
+
+// Splits an affine matrix without shear into translation, rotation and scale
+JointPose decomposePose(const glm::mat4& matrix);
+
+// Joint hierarchy of a model and the palette its skinned meshes are weighted to. A palette
+// entry moves vertices with its joint's model space matrix times the entry's inverse bind
+// matrix, so the same joint can be bound differently by two skins.
+class Skeleton
+{
+public:
+	// Every parent comes before its children, -1 for the roots
+	std::vector<int> parents;
+	std::vector<std::string> names;
+	// Where a joint is while no clip moves it
+	std::vector<JointPose> restPose;
+	std::vector<int> paletteJoints;
+	std::vector<glm::mat4> inverseBindMatrices;
+
+	size_t NumJoints() const { return parents.size(); }
+	size_t PaletteSize() const { return paletteJoints.size(); }
+	bool Empty() const { return paletteJoints.empty(); }
+
+	// The parent has to be added first, returns the index of the joint
+	int AddJoint(const std::string& name, int parent, const JointPose& rest);
+	// Returns the index of the entry, which the vertex skins of the meshes refer to
+	int AddPaletteEntry(int joint, const glm::mat4& inverseBind);
+	// -1 if no joint has the name
+	int FindJoint(const std::string& name) const;
+};
+
+enum animationPath
+{
+	ANIMATION_TRANSLATION,
+	ANIMATION_ROTATION,
+	ANIMATION_SCALE
+};
+
+// Keys of one property of one joint, times in seconds and ascending
+struct AnimationChannel
+{
+	int joint = 0;
+	animationPath path = ANIMATION_TRANSLATION;
+	// Holds every key until the next one instead of interpolating
+	bool step = false;
+	std::vector<float> times;
+	// Laid out like JointPose
+	std::vector<glm::vec4> values;
+};
+
+// Channels of a skeleton that play together, looping after duration seconds
+struct AnimationClip
+{
+	std::string name;
+	float duration = 0.0f;
+	std::vector<AnimationChannel> channels;
+};
+
+// Collects the joints that move a vertex in any order and keeps the four strongest
+struct JointInfluences
+{
+	int joints[4] = { 0, 0, 0, 0 };
+	float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	void Add(int joint, float weight);
+	// Weights scaled to bytes that add up to 255, a vertex without any follows palette entry 0
+	VertexSkin Pack() const;
+};
+
+// Local box of the vertices one palette entry moves with some weight
+struct JointBounds
+{
+	int entry = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Boxes of every palette entry the skins give a weight
+std::vector<JointBounds> computeJointBounds(const glm::vec3* positions, const VertexSkin* skins, size_t count);
+// Box around a skinned mesh posed with the model space matrices of the skeleton's joints. A
+// vertex blends the points its entries move it to, so it stays inside their boxes.
+void posedBounds(const Skeleton& skeleton, const glm::mat4* joints, const std::vector<JointBounds>& jointBounds, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+// Memory the sampler works in, one per skeleton being posed at the same time
+struct PoseScratch
+{
+	std::vector<JointPose> locals;
+	std::vector<glm::mat4> globals;
+	// Key each channel was at in the last pose, only a hint for the search
+	std::vector<unsigned int> keys;
+};
+
+// One skeleton to pose. A null clip leaves it in its rest pose.
+struct PoseJob
+{
+	const Skeleton* skeleton = nullptr;
+	const AnimationClip* clip = nullptr;
+	// Seconds into the clip, wrapped around its duration
+	float time = 0.0f;
+	PoseScratch* scratch = nullptr;
+	// Receives 3 texels per palette entry, the rows of its affine matrix. Only written to, so
+	// it may point into a mapped buffer.
+	glm::vec4* palette = nullptr;
+};
+
+// Samples the clip, walks the hierarchy and writes the palette of one skeleton
+void samplePose(const PoseJob& job);
+// Poses every job on up to numThreads threads of the WorkerPool, the calling thread included, 0
+// for one per core. Few joints are posed on the calling thread alone, waking workers costs more.
+void samplePoses(const PoseJob* jobs, size_t count, unsigned int numThreads);
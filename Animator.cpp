@@ -0,0 +1,243 @@
+#include "Animator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "Profiler.h"
+
+namespace
+{
+	// Room for 64 skeletons of 64 palette entries per frame to begin with
+	const size_t INITIAL_REGION_BYTES = 64 * 64 * Animator::TEXELS_PER_ENTRY * sizeof(glm::vec4);
+
+	struct Instance
+	{
+		const Skeleton* skeleton = nullptr;
+		const AnimationClip* clip = nullptr;
+		float startSeconds = 0.0f;
+		// Set by Add and Play, the next frame becomes the start of the clip
+		bool restart = true;
+		int paletteBase = -1;
+		bool used = false;
+		PoseScratch scratch;
+	};
+
+	StreamBuffer buffer;
+	std::vector<Instance> instances;
+	std::vector<int> freeInstances;
+	std::vector<PoseJob> jobs;
+	size_t paletteEntries = 0;
+	float poseMilliseconds = 0.0f;
+
+	bool valid(int instance)
+	{
+		return instance >= 0 && (size_t)instance < instances.size() && instances[instance].used;
+	}
+}
+
+unsigned int Animator::numThreads = 0;
+
+int Animator::Add(const Skeleton& skeleton, const AnimationClip* clip)
+{
+	int instance;
+	if (!freeInstances.empty())
+	{
+		instance = freeInstances.back();
+		freeInstances.pop_back();
+	}
+	else
+	{
+		instance = (int)instances.size();
+		instances.push_back(Instance());
+	}
+	Instance& added = instances[instance];
+	added.skeleton = &skeleton;
+	added.clip = clip;
+	added.restart = true;
+	added.paletteBase = -1;
+	added.used = true;
+	return instance;
+}
+
+void Animator::Play(int instance, const AnimationClip* clip)
+{
+	if (!valid(instance))
+		return;
+	instances[instance].clip = clip;
+	instances[instance].restart = true;
+}
+
+void Animator::Remove(int instance)
+{
+	if (!valid(instance))
+		return;
+	// The scratch memory stays for the next instance in the slot
+	instances[instance].used = false;
+	instances[instance].skeleton = nullptr;
+	instances[instance].clip = nullptr;
+	freeInstances.push_back(instance);
+}
+
+void Animator::BeginFrame(float seconds)
+{
+	PROFILE_SCOPE("Pose sampling");
+	auto start = std::chrono::high_resolution_clock::now();
+	paletteEntries = 0;
+	for (Instance& instance : instances)
+	{
+		instance.paletteBase = -1;
+		if (instance.used)
+			paletteEntries += instance.skeleton->PaletteSize();
+	}
+	if (buffer.textureID)
+		buffer.BeginFrame();
+	if (paletteEntries == 0)
+	{
+		poseMilliseconds = 0.0f;
+		return;
+	}
+
+	if (!buffer.textureID)
+	{
+		buffer.Create(INITIAL_REGION_BYTES);
+		buffer.BeginFrame();
+	}
+	size_t bytes = paletteEntries * TEXELS_PER_ENTRY * sizeof(glm::vec4);
+	if (!buffer.Fits(bytes))
+	{
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		size_t regionBytes = std::max(buffer.RegionBytes() * 2, bytes * 2);
+		if (maxTexels > 0 && regionBytes * StreamBuffer::NUM_REGIONS > (size_t)maxTexels * sizeof(glm::vec4))
+			std::cout << "ERROR::ANIMATOR::" << regionBytes * StreamBuffer::NUM_REGIONS / sizeof(glm::vec4)
+				<< " texels exceed GL_MAX_TEXTURE_BUFFER_SIZE of " << maxTexels << std::endl;
+		buffer.Grow(regionBytes);
+	}
+
+	// One mapping for every palette of the frame, the workers write their own parts of it
+	size_t offset;
+	glm::vec4* texels = (glm::vec4*)buffer.Map(bytes, offset);
+	if (texels)
+	{
+		int firstTexel = (int)(offset / sizeof(glm::vec4));
+		jobs.clear();
+		for (Instance& instance : instances)
+		{
+			if (!instance.used || instance.skeleton->Empty())
+				continue;
+			if (instance.restart)
+			{
+				instance.startSeconds = seconds;
+				instance.restart = false;
+			}
+			PoseJob job;
+			job.skeleton = instance.skeleton;
+			job.clip = instance.clip;
+			job.time = seconds - instance.startSeconds;
+			job.scratch = &instance.scratch;
+			job.palette = texels;
+			jobs.push_back(job);
+			instance.paletteBase = firstTexel;
+			texels += instance.skeleton->PaletteSize() * TEXELS_PER_ENTRY;
+			firstTexel += (int)instance.skeleton->PaletteSize() * TEXELS_PER_ENTRY;
+		}
+		samplePoses(jobs.data(), jobs.size(), numThreads);
+		buffer.Unmap();
+	}
+	poseMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Animator::EndFrame()
+{
+	if (buffer.textureID)
+		buffer.EndFrame();
+}
+
+int Animator::PaletteBase(int instance)
+{
+	return valid(instance) ? instances[instance].paletteBase : -1;
+}
+
+const glm::mat4* Animator::JointMatrices(int instance)
+{
+	if (PaletteBase(instance) < 0)
+		return nullptr;
+	return instances[instance].scratch.globals.data();
+}
+
+void Animator::Bind()
+{
+	if (buffer.textureID)
+		buffer.Bind(PALETTE_UNIT);
+}
+
+void Animator::SetTextureUnits(Shader& shader)
+{
+	shader.SetInt("bonePalette", PALETTE_UNIT);
+}
+
+void Animator::Delete()
+{
+	if (buffer.textureID)
+		buffer.Delete();
+	std::vector<Instance>().swap(instances);
+	std::vector<int>().swap(freeInstances);
+	std::vector<PoseJob>().swap(jobs);
+}
+
+size_t Animator::NumInstances()
+{
+	return instances.size() - freeInstances.size();
+}
+
+size_t Animator::NumPlaying()
+{
+	size_t playing = 0;
+	for (const Instance& instance : instances)
+	{
+		if (instance.used && instance.clip && instance.clip->duration > 0.0f)
+			playing++;
+	}
+	return playing;
+}
+
+size_t Animator::NumPaletteEntries()
+{
+	return paletteEntries;
+}
+
+float Animator::PoseMilliseconds()
+{
+	return poseMilliseconds;
+}
+
+const StreamBuffer& Animator::Buffer()
+{
+	return buffer;
+}
+
+AnimationInstance::AnimationInstance(AnimationInstance&& other) noexcept : ID(other.ID)
+{
+	other.ID = -1;
+}
+
+AnimationInstance& AnimationInstance::operator=(AnimationInstance&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = -1;
+	}
+	return *this;
+}
+
+void AnimationInstance::Delete()
+{
+	if (ID < 0)
+		return;
+	Animator::Remove(ID);
+	ID = -1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Animation.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+// Every skeleton that is drawn this frame and the clip it plays. BeginFrame poses all of them
+// at once, spread over worker threads, and writes their palettes into one StreamBuffer, so a
+// hundred characters cost one upload instead of a hundred. Skinned shaders fetch their joints
+// from the bonePalette texture buffer starting at the instance's paletteBase.
+//
+// Layout, TEXELS_PER_ENTRY RGBA32F texels per palette entry:
+//   0-2: rows of the affine joint matrix
+class Animator
+{
+public:
+	static const GLuint PALETTE_UNIT = 10;
+	static const int TEXELS_PER_ENTRY = 3;
+
+	// Threads to pose with, 0 for one per core
+	static unsigned int numThreads;
+
+	// Starts playing the clip on the skeleton, both must outlive the instance. A null clip holds
+	// the rest pose. Returns the instance.
+	static int Add(const Skeleton& skeleton, const AnimationClip* clip);
+	// Switches to another clip, which starts from its beginning
+	static void Play(int instance, const AnimationClip* clip);
+	static void Remove(int instance);
+
+	// Poses every instance at seconds since the start and writes the palettes of this frame
+	static void BeginFrame(float seconds);
+	static void EndFrame();
+	// First texel of the instance's palette in this frame, -1 until BeginFrame wrote it
+	static int PaletteBase(int instance);
+	// Model space matrices of the instance's joints in this frame, null until BeginFrame posed it
+	static const glm::mat4* JointMatrices(int instance);
+
+	static void Bind();
+	static void SetTextureUnits(Shader& shader);
+	static void Delete();
+
+	static size_t NumInstances();
+	// Instances with a clip, which need a new frame to move
+	static size_t NumPlaying();
+	static size_t NumPaletteEntries();
+	static float PoseMilliseconds();
+	static const StreamBuffer& Buffer();
+};
+
+// Owns one instance of the Animator, moving hands it over and destruction removes it
+class AnimationInstance
+{
+public:
+	int ID = -1;
+	AnimationInstance() {}
+	AnimationInstance(const Skeleton& skeleton, const AnimationClip* clip) : ID(Animator::Add(skeleton, clip)) {}
+	AnimationInstance(AnimationInstance&& other) noexcept;
+	AnimationInstance& operator=(AnimationInstance&& other) noexcept;
+	AnimationInstance(const AnimationInstance&) = delete;
+	AnimationInstance& operator=(const AnimationInstance&) = delete;
+	~AnimationInstance() { Delete(); }
+
+	void Play(const AnimationClip* clip) { Animator::Play(ID, clip); }
+	int PaletteBase() const { return Animator::PaletteBase(ID); }
+	const glm::mat4* JointMatrices() const { return Animator::JointMatrices(ID); }
+	// Removes the instance early, the destructor does it otherwise
+	void Delete();
+};
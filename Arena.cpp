@@ -0,0 +1,45 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+void* Arena::AllocateBytes(size_t bytes, size_t alignment)
+{
+	if (!blocks.empty())
+	{
+		uintptr_t start = (uintptr_t)blocks.back().memory.get();
+		size_t aligned = (size_t)(((start + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - start);
+		if (aligned <= blocks.back().size && bytes <= blocks.back().size - aligned)
+		{
+			offset = aligned + bytes;
+			bytesUsed += bytes;
+			return blocks.back().memory.get() + aligned;
+		}
+	}
+
+	// Larger allocations get a block of their own, the rest of the current block is given up
+	if (bytes > (size_t)-1 - alignment)
+		return nullptr;
+	Block block;
+	block.size = std::max(blockBytes, bytes + alignment);
+	block.memory.reset(new unsigned char[block.size]);
+	blocks.push_back(std::move(block));
+	offset = 0;
+	return AllocateBytes(bytes, alignment);
+}
+
+void Arena::Reset()
+{
+	if (blocks.size() > 1)
+		blocks.erase(blocks.begin() + 1, blocks.end());
+	offset = 0;
+	bytesUsed = 0;
+}
+
+size_t Arena::BytesReserved() const
+{
+	size_t bytes = 0;
+	for (const Block& block : blocks)
+		bytes += block.size;
+	return bytes;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Hands out memory from large blocks and frees all of it at once. Loaders decode a file into
+// one, so parsing makes a handful of allocations instead of one per element. Nothing handed
+// out is ever destroyed, only trivially destructible types can live in it. Owns its blocks,
+// it can be moved but not copied.
+class Arena
+{
+public:
+	explicit Arena(size_t blockBytes = 1 << 20) : blockBytes(blockBytes) {}
+	Arena(Arena&&) = default;
+	Arena& operator=(Arena&&) = default;
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Uninitialized room for count elements, null if the size overflows
+	template <typename T>
+	T* Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+		if (count > (size_t)-1 / sizeof(T))
+			return nullptr;
+		return (T*)AllocateBytes(count * sizeof(T), alignof(T));
+	}
+	void* AllocateBytes(size_t bytes, size_t alignment);
+	// Frees every block but the first, which is reused
+	void Reset();
+
+	// Bytes handed out and bytes held in blocks since the last Reset
+	size_t BytesUsed() const { return bytesUsed; }
+	size_t BytesReserved() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> memory;
+		size_t size;
+	};
+
+	size_t blockBytes;
+	std::vector<Block> blocks;
+	// Offset of the free space in the last block
+	size_t offset = 0;
+	size_t bytesUsed = 0;
+};
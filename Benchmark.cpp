@@ -0,0 +1,373 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Json.h"
+
+void CameraPath::Clear()
+{
+	positions.clear();
+	orientations.clear();
+}
+
+void CameraPath::Record(const Camera& camera, float time)
+{
+	// Sample at fixed times, slow frames repeat the pose and fast frames are skipped
+	size_t samples = (size_t)(time / timestep) + 1;
+	while (positions.size() < samples)
+	{
+		positions.push_back(camera.Position);
+		orientations.push_back(camera.Orientation);
+	}
+}
+
+void CameraPath::Apply(Camera& camera, float time) const
+{
+	if (positions.empty())
+		return;
+
+	float sample = std::max(time, 0.0f) / timestep;
+	size_t index = std::min((size_t)sample, positions.size() - 1);
+	size_t next = std::min(index + 1, positions.size() - 1);
+	float blend = std::min(sample - (float)index, 1.0f);
+
+	camera.Position = glm::mix(positions[index], positions[next], blend);
+	glm::vec3 orientation = glm::mix(orientations[index], orientations[next], blend);
+	if (glm::length(orientation) > 0.0f)
+		camera.Orientation = glm::normalize(orientation);
+}
+
+float CameraPath::Duration() const
+{
+	return positions.empty() ? 0.0f : (positions.size() - 1) * timestep;
+}
+
+bool CameraPath::Save(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	// Plain text so recorded paths can be diffed and edited by hand
+	char line[160];
+	snprintf(line, sizeof(line), "camerapath 1 %.9g %d\n", timestep, (int)positions.size());
+	out << line;
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		snprintf(line, sizeof(line), "%.9g %.9g %.9g %.9g %.9g %.9g\n",
+			positions[i].x, positions[i].y, positions[i].z, orientations[i].x, orientations[i].y, orientations[i].z);
+		out << line;
+	}
+	return (bool)out;
+}
+
+bool CameraPath::Load(const std::string& path)
+{
+	Clear();
+	std::ifstream in(path);
+	std::string magic;
+	int version = 0;
+	int count = 0;
+	if (!(in >> magic >> version >> timestep >> count) || magic != "camerapath" || version != 1 || timestep <= 0.0f || count < 0)
+	{
+		std::cout << "Failed to read camera path " << path << std::endl;
+		return false;
+	}
+
+	positions.resize(count);
+	orientations.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		in >> positions[i].x >> positions[i].y >> positions[i].z >> orientations[i].x >> orientations[i].y >> orientations[i].z;
+		if (!in)
+		{
+			std::cout << "Camera path " << path << " ends after " << i << " of " << count << " samples" << std::endl;
+			Clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+static BenchmarkScenario makeScenario(const char* name, const char* modelPath, const char* shading)
+{
+	BenchmarkScenario scenario;
+	scenario.name = name;
+	scenario.modelPath = modelPath;
+	scenario.shading = shading;
+	return scenario;
+}
+
+const std::vector<BenchmarkScenario>& benchmarkScenarios()
+{
+	static std::vector<BenchmarkScenario> scenarios;
+	if (!scenarios.empty())
+		return scenarios;
+
+	scenarios.push_back(makeScenario("deccer-cubes", "Resources/deccer-cubes/SM_Deccer_Cubes.glb", "default"));
+	scenarios.push_back(makeScenario("deccer-cubes-textured", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "default"));
+	scenarios.push_back(makeScenario("deccer-cubes-complex", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured_Complex.gltf", "default"));
+	scenarios.push_back(makeScenario("deccer-cubes-depth", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "depth"));
+
+	BenchmarkScenario shadows = makeScenario("deccer-cubes-shadows", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "default");
+	shadows.shadows = true;
+	scenarios.push_back(shadows);
+
+	BenchmarkScenario clustered = makeScenario("deccer-cubes-clustered", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "default");
+	clustered.clusteredLighting = true;
+	clustered.shadows = true;
+	clustered.pointLights = 1024;
+	scenarios.push_back(clustered);
+
+	// Same counts as the Light Stress Test entry of the Scene menu
+	BenchmarkScenario stress = makeScenario("light-stress", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "default");
+	stress.clusteredLighting = true;
+	stress.pointLights = 3584;
+	stress.spotLights = 512;
+	scenarios.push_back(stress);
+
+	BenchmarkScenario deferred = makeScenario("deccer-cubes-deferred", "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb", "deferred");
+	deferred.pointLights = 1024;
+	scenarios.push_back(deferred);
+
+	scenarios.push_back(makeScenario("matilda", "Resources/matilda/scene.gltf", "default"));
+	// Resources/Seele-Starchasm-Nyx/<Seele>.pmx, spelled as UTF-8 bytes so the source encoding doesn't matter
+	scenarios.push_back(makeScenario("seele-pmx", "Resources/Seele-Starchasm-Nyx/\xE5\xB8\x8C\xE5\x84\xBF.pmx", "default"));
+	scenarios.push_back(makeScenario("dyson-rings", "Resources/dyson_rings/scene.gltf", "default"));
+
+	BenchmarkScenario dysonShadows = makeScenario("dyson-rings-clustered-shadows", "Resources/dyson_rings/scene.gltf", "default");
+	dysonShadows.clusteredLighting = true;
+	dysonShadows.shadows = true;
+	dysonShadows.pointLights = 1024;
+	scenarios.push_back(dysonShadows);
+
+	return scenarios;
+}
+
+bool selectScenarios(const HeadlessOptions& options, std::vector<BenchmarkScenario>& scenarios)
+{
+	scenarios.clear();
+	if (options.benchmark.empty())
+	{
+		BenchmarkScenario scenario;
+		scenario.name = "headless";
+		scenario.modelPath = options.modelPath;
+		scenario.shading = options.shading;
+		scenario.lighting = options.lighting;
+		scenario.clusteredLighting = options.clusteredLighting;
+		scenario.shadows = options.shadows;
+		scenario.pointLights = options.pointLights;
+		scenario.warmupFrames = std::max(options.warmupFrames, 0);
+		if (options.frames > 0)
+			scenario.frames = options.frames;
+		scenario.cameraPath = options.cameraPath;
+		scenarios.push_back(scenario);
+		return true;
+	}
+
+	std::stringstream names(options.benchmark);
+	std::string name;
+	bool known = true;
+	while (std::getline(names, name, ','))
+	{
+		bool found = false;
+		for (const BenchmarkScenario& scenario : benchmarkScenarios())
+		{
+			if (name == "all" || name == scenario.name)
+			{
+				scenarios.push_back(scenario);
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			if (name != "list")
+				std::cout << "Unknown benchmark: " << name << std::endl;
+			known = false;
+		}
+	}
+
+	if (!known || scenarios.empty())
+	{
+		std::cout << "Benchmarks:";
+		for (const BenchmarkScenario& scenario : benchmarkScenarios())
+			std::cout << " " << scenario.name;
+		std::cout << std::endl;
+		return false;
+	}
+
+	// Explicitly given options override the suite's defaults
+	for (BenchmarkScenario& scenario : scenarios)
+	{
+		if (!options.cameraPath.empty())
+			scenario.cameraPath = options.cameraPath;
+		if (options.warmupFrames >= 0)
+			scenario.warmupFrames = options.warmupFrames;
+		if (options.frames > 0)
+			scenario.frames = options.frames;
+	}
+	return true;
+}
+
+
+
+BenchmarkResult summarizeBenchmark(const BenchmarkScenario& scenario, const std::vector<float>& frameMilliseconds, double drawCalls, double triangles)
+{
+	BenchmarkResult result;
+	result.name = scenario.name;
+	result.modelPath = scenario.modelPath;
+	result.shading = scenario.shading;
+	result.frames = (int)frameMilliseconds.size();
+	if (frameMilliseconds.empty())
+	{
+		result.skipped = true;
+		return result;
+	}
+
+	std::vector<float> sorted = frameMilliseconds;
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](float fraction) { return sorted[(size_t)(fraction * (sorted.size() - 1) + 0.5f)]; };
+
+	double total = 0.0;
+	for (float milliseconds : frameMilliseconds)
+		total += milliseconds;
+	result.average = (float)(total / frameMilliseconds.size());
+	result.min = sorted.front();
+	result.p50 = percentile(0.5f);
+	result.p95 = percentile(0.95f);
+	result.p99 = percentile(0.99f);
+	result.max = sorted.back();
+	result.drawCalls = drawCalls / frameMilliseconds.size();
+	result.triangles = triangles / frameMilliseconds.size();
+	return result;
+}
+
+void printBenchmarkResult(const BenchmarkResult& result, const HeadlessOptions& options)
+{
+	if (result.skipped)
+	{
+		std::cout << result.name << ": skipped, " << result.modelPath << " or its camera path could not be loaded" << std::endl;
+		return;
+	}
+
+	char line[320];
+	snprintf(line, sizeof(line), "%s: %d frames at %dx%d, %s shading, %.0f draw calls and %.0f triangles per frame",
+		result.name.c_str(), result.frames, options.width, options.height, result.shading.c_str(), result.drawCalls, result.triangles);
+	std::cout << line << std::endl;
+	snprintf(line, sizeof(line), "Frame time: average %.3f ms (%.1f FPS), min %.3f, median %.3f, 95th %.3f, 99th %.3f, max %.3f ms",
+		result.average, 1000.0 / result.average, result.min, result.p50, result.p95, result.p99, result.max);
+	std::cout << line << std::endl;
+	if (result.gpuP50 > 0.0f)
+	{
+		snprintf(line, sizeof(line), "GPU time: median %.3f, 95th %.3f, 99th %.3f ms", result.gpuP50, result.gpuP95, result.gpuP99);
+		std::cout << line << std::endl;
+	}
+	snprintf(line, sizeof(line), "Memory: GPU %.2f MB, CPU geometry %.2f MB",
+		result.gpuBytes / (1024.0 * 1024.0), result.cpuGeometryBytes / (1024.0 * 1024.0));
+	std::cout << line << std::endl;
+}
+
+bool writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results, const HeadlessOptions& options)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Failed to write " << path << std::endl;
+		return false;
+	}
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	out << "{\n\t\"version\": 1,\n\t\"renderer\": " << escapeJson(renderer ? renderer : "") << ",\n";
+	out << "\t\"width\": " << options.width << ",\n\t\"height\": " << options.height << ",\n";
+	out << "\t\"scenarios\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "\t\t{\"name\": " << escapeJson(result.name) << ", \"model\": " << escapeJson(result.modelPath)
+			<< ", \"shading\": " << escapeJson(result.shading) << ", \"skipped\": " << (result.skipped ? "true" : "false");
+		if (!result.skipped)
+		{
+			char metrics[512];
+			snprintf(metrics, sizeof(metrics), ", \"frames\": %d,\n\t\t\t\"cpu_ms\": {\"average\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n"
+				"\t\t\t\"gpu_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f},\n\t\t\t\"draw_calls\": %.1f, \"triangles\": %.1f,\n"
+				"\t\t\t\"gpu_bytes\": %zu, \"cpu_geometry_bytes\": %zu",
+				result.frames, result.average, result.min, result.p50, result.p95, result.p99, result.max,
+				result.gpuP50, result.gpuP95, result.gpuP99, result.drawCalls, result.triangles, result.gpuBytes, result.cpuGeometryBytes);
+			out << metrics;
+		}
+		out << "}";
+	}
+	out << "\n\t]\n}\n";
+	return (bool)out;
+}
+
+int compareWithBaseline(const std::vector<BenchmarkResult>& results, const std::string& baselinePath, float threshold)
+{
+	std::ifstream in(baselinePath, std::ios::binary);
+	std::stringstream contents;
+	contents << in.rdbuf();
+	std::string text = contents.str();
+
+	JsonValue baseline;
+	std::string error;
+	if (!in || !JsonValue::Parse(text.data(), text.size(), baseline, error))
+	{
+		std::cout << "Failed to read baseline " << baselinePath << (error.empty() ? "" : ": " + error) << std::endl;
+		return -1;
+	}
+
+	int regressions = 0;
+	char line[256];
+	snprintf(line, sizeof(line), "Comparing against %s, threshold %.1f%%", baselinePath.c_str(), threshold * 100.0f);
+	std::cout << line << std::endl;
+	for (const BenchmarkResult& result : results)
+	{
+		if (result.skipped)
+			continue;
+
+		const JsonValue* base = nullptr;
+		const JsonValue& scenarios = baseline["scenarios"];
+		for (size_t i = 0; i < scenarios.Size(); i++)
+			if (scenarios[i]["name"].AsString() == result.name && !scenarios[i]["skipped"].AsBool())
+				base = &scenarios[i];
+		if (!base)
+		{
+			std::cout << "  " << result.name << ": not in the baseline" << std::endl;
+			continue;
+		}
+
+		// Different counts mean the scene itself changed, the times are still compared
+		if ((*base)["draw_calls"].AsNumber() != std::floor(result.drawCalls * 10.0 + 0.5) / 10.0
+			|| (*base)["triangles"].AsNumber() != std::floor(result.triangles * 10.0 + 0.5) / 10.0)
+			std::cout << "  " << result.name << ": draw calls or triangles differ from the baseline" << std::endl;
+
+		struct Metric { const char* label; float current; double previous; };
+		Metric metrics[] =
+		{
+			{ "median", result.p50, (*base)["cpu_ms"]["p50"].AsNumber() },
+			{ "95th", result.p95, (*base)["cpu_ms"]["p95"].AsNumber() },
+			{ "GPU 95th", result.gpuP95, (*base)["gpu_ms"]["p95"].AsNumber() }
+		};
+		for (const Metric& metric : metrics)
+		{
+			if (metric.previous <= 0.0 || metric.current <= 0.0f)
+				continue;
+			double change = metric.current / metric.previous - 1.0;
+			bool regressed = change > threshold;
+			regressions += regressed;
+			snprintf(line, sizeof(line), "  %s %s: %.3f -> %.3f ms (%+.1f%%)%s", result.name.c_str(), metric.label,
+				metric.previous, metric.current, change * 100.0, regressed ? " REGRESSION" : "");
+			std::cout << line << std::endl;
+		}
+	}
+	std::cout << regressions << " regression(s)" << std::endl;
+	return regressions;
+}
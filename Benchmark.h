@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "Headless.h"
+
+// Camera poses sampled at a fixed timestep. Paths are recorded from an interactive session
+// and replayed by headless runs, so every run sees the same views whatever its frame rate.
+class CameraPath
+{
+public:
+	float timestep = 1.0f / 60.0f;
+
+	void Clear();
+	// Appends a sample for every timestep that passed since the previous one
+	void Record(const Camera& camera, float time);
+	// Interpolates between the samples around time and holds the last one past the end
+	void Apply(Camera& camera, float time) const;
+	bool Empty() const { return positions.empty(); }
+	float Duration() const;
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+private:
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> orientations;
+};
+
+// Everything a benchmark run needs to render the same frames again
+struct BenchmarkScenario
+{
+	std::string name;
+	std::string modelPath;
+	// default, depth or deferred
+	std::string shading = "default";
+	bool lighting = true;
+	bool clusteredLighting = false;
+	bool shadows = false;
+	int pointLights = 256;
+	int spotLights = 0;
+	// Rendered before measuring, they absorb shader compiles and first uploads
+	int warmupFrames = 60;
+	int frames = 300;
+	// Orbit around the model when no camera path is given
+	float orbitRadius = 3.0f;
+	float orbitHeight = 1.0f;
+	std::string cameraPath;
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string modelPath;
+	std::string shading;
+	// The model or the camera path could not be loaded
+	bool skipped = false;
+	int frames = 0;
+	// Milliseconds of CPU frame time, which includes the GPU since headless frames end with glFinish
+	float average = 0.0f;
+	float min = 0.0f;
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+	// From the profiler's timestamp queries, zero if none resolved
+	float gpuP50 = 0.0f;
+	float gpuP95 = 0.0f;
+	float gpuP99 = 0.0f;
+	// Averages per frame
+	double drawCalls = 0.0;
+	double triangles = 0.0;
+	// Tracked memory at the end of the scenario
+	size_t gpuBytes = 0;
+	size_t cpuGeometryBytes = 0;
+};
+
+// Scenarios over the models bundled in Resources
+const std::vector<BenchmarkScenario>& benchmarkScenarios();
+// The named benchmark scenarios, or a single scenario made of the other options.
+// Returns false and lists the known names if a name is unknown.
+bool selectScenarios(const HeadlessOptions& options, std::vector<BenchmarkScenario>& scenarios);
+
+BenchmarkResult summarizeBenchmark(const BenchmarkScenario& scenario, const std::vector<float>& frameMilliseconds, double drawCalls, double triangles);
+void printBenchmarkResult(const BenchmarkResult& result, const HeadlessOptions& options);
+bool writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results, const HeadlessOptions& options);
+// Prints the scenarios that got slower than the baseline by more than the threshold fraction.
+// Returns the number of regressions, or -1 if the baseline could not be read.
+int compareWithBaseline(const std::vector<BenchmarkResult>& results, const std::string& baselinePath, float threshold);
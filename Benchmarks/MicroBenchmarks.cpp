@@ -0,0 +1,460 @@
+// Micro benchmarks for the CPU side hot paths of the renderer. GL calls go to a null
+// implementation, so only our own code is timed and no context or GPU is needed.
+//
+//   MicroBenchmarks [--filter <text>] [--repetitions <n>] [--warmup <n>] [--resources <dir>]
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "NullGL.h"
+#include "../Animation.h"
+#include "../MeshProcessing.h"
+#include "../Obj.h"
+#include "../Shader.h"
+#include "../Texture.h"
+#include "../TextureArray.h"
+#include "../TextureStreamer.h"
+#include "../WorkerPool.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct BenchmarkSettings
+	{
+		std::string filter;
+		int repetitions = 20;
+		int warmup = 3;
+		std::string resources = "Resources/";
+	};
+
+	BenchmarkSettings settings;
+
+	// Results are folded in here so the compiler can't drop the measured work
+	volatile float sink = 0.0f;
+
+	double RunBatch(const std::function<void()>& body, long long iterations)
+	{
+		auto start = Clock::now();
+		for (long long i = 0; i < iterations; i++)
+			body();
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	// Times body in repetitions of a batch that runs for at least 20 ms. items is the work done
+	// by one call, for example vertices, and turns the time into a throughput.
+	void Run(const std::string& name, double items, const std::function<void()>& body)
+	{
+		if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos)
+			return;
+
+		// Grow the batch until it is long enough for the clock, the growing runs warm the caches
+		long long iterations = 1;
+		while (RunBatch(body, iterations) < 20.0e6 && iterations < (1ll << 40))
+			iterations *= 2;
+		for (int i = 0; i < settings.warmup; i++)
+			RunBatch(body, iterations);
+
+		std::vector<double> samples;
+		for (int i = 0; i < settings.repetitions; i++)
+			samples.push_back(RunBatch(body, iterations) / iterations);
+		std::sort(samples.begin(), samples.end());
+
+		double mean = 0.0;
+		for (double sample : samples)
+			mean += sample;
+		mean /= samples.size();
+		double variance = 0.0;
+		for (double sample : samples)
+			variance += (sample - mean) * (sample - mean);
+		double deviation = samples.size() > 1 ? std::sqrt(variance / (samples.size() - 1)) : 0.0;
+		double median = samples[samples.size() / 2];
+
+		char line[256];
+		snprintf(line, sizeof(line), "%-40s %12.1f ns  %5.1f%%  min %12.1f  max %12.1f  %10.2f M items/s",
+			name.c_str(), median, 100.0 * deviation / mean, samples.front(), samples.back(), items / median * 1000.0);
+		std::cout << line << std::endl;
+	}
+
+	bool FileExists(const std::string& path)
+	{
+		return (bool)std::ifstream(path);
+	}
+
+
+
+	// Grid of quads with normals and one UV channel, laid out like an imported mesh
+	struct SyntheticMesh
+	{
+		aiMesh mesh;
+
+		SyntheticMesh(unsigned int size)
+		{
+			mesh.mNumVertices = size * size;
+			mesh.mVertices = new aiVector3D[mesh.mNumVertices];
+			mesh.mNormals = new aiVector3D[mesh.mNumVertices];
+			mesh.mTextureCoords[0] = new aiVector3D[mesh.mNumVertices];
+			mesh.mNumUVComponents[0] = 2;
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					unsigned int i = y * size + x;
+					mesh.mVertices[i] = aiVector3D((float)x, std::sin(x * 0.1f) * std::cos(y * 0.1f), (float)y);
+					mesh.mNormals[i] = aiVector3D(0.0f, 1.0f, 0.0f);
+					mesh.mTextureCoords[0][i] = aiVector3D(x / (float)size, y / (float)size, 0.0f);
+				}
+			}
+
+			mesh.mNumFaces = (size - 1) * (size - 1) * 2;
+			mesh.mFaces = new aiFace[mesh.mNumFaces];
+			unsigned int face = 0;
+			for (unsigned int y = 0; y + 1 < size; y++)
+			{
+				for (unsigned int x = 0; x + 1 < size; x++)
+				{
+					unsigned int corner = y * size + x;
+					unsigned int quad[2][3] = { { corner, corner + size, corner + 1 }, { corner + 1, corner + size, corner + size + 1 } };
+					for (auto& triangle : quad)
+					{
+						mesh.mFaces[face].mNumIndices = 3;
+						mesh.mFaces[face].mIndices = new unsigned int[3];
+						std::copy(triangle, triangle + 3, mesh.mFaces[face].mIndices);
+						face++;
+					}
+				}
+			}
+		}
+	};
+
+	void MeshConversionBenchmarks()
+	{
+		unsigned int sizes[] = { 32, 256 };
+		for (unsigned int size : sizes)
+		{
+			SyntheticMesh synthetic(size);
+			const aiMesh* mesh = &synthetic.mesh;
+			std::string suffix = "/" + std::to_string(mesh->mNumVertices) + " vertices";
+
+			// Fresh vectors every call, as the vector constructors of Mesh get them
+			Run("ProcessMesh vertices" + suffix, mesh->mNumVertices, [&]()
+			{
+				std::vector<Vertex> vertices;
+				convertMeshVertices(mesh, vertices);
+				sink = sink + vertices.back().position.y;
+			});
+			Run("ProcessMesh indices" + suffix, mesh->mNumFaces * 3.0, [&]()
+			{
+				std::vector<GLuint> indices;
+				convertMeshIndices(mesh, indices);
+				sink = sink + (float)indices.back();
+			});
+
+			// Into storage sized up front, as Model::ProcessMesh writes into the mapped buffers
+			std::vector<Vertex> mappedVertices(mesh->mNumVertices);
+			std::vector<GLuint> mappedIndices(countMeshIndices(mesh));
+			for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++)
+			{
+				useSimdLevel((simdLevel)level);
+				Run(std::string("ProcessMesh mapped vertices ") + simdLevelName((simdLevel)level) + suffix, mesh->mNumVertices, [&]()
+				{
+					writeMeshVertices(mesh, mappedVertices.data());
+					sink = sink + mappedVertices.back().position.y;
+				});
+				Run(std::string("ProcessNode mesh bounds ") + simdLevelName((simdLevel)level) + suffix, mesh->mNumVertices, [&]()
+				{
+					glm::vec3 boundsMin, boundsMax;
+					computeMeshBounds(mesh->mVertices, mesh->mNumVertices, boundsMin, boundsMax);
+					sink = sink + boundsMax.x - boundsMin.x;
+				});
+			}
+			useSimdLevel(supportedSimdLevel());
+			Run("ProcessMesh mapped indices" + suffix, mesh->mNumFaces * 3.0, [&]()
+			{
+				writeMeshIndices(mesh, mappedIndices.data());
+				sink = sink + (float)mappedIndices.back();
+			});
+		}
+	}
+
+	// The synthetic grid written out as OBJ text, the way exporters write it
+	std::string SyntheticObj(unsigned int size)
+	{
+		SyntheticMesh synthetic(size);
+		const aiMesh& mesh = synthetic.mesh;
+		std::string text = "o grid\n";
+		char line[128];
+		for (unsigned int i = 0; i < mesh.mNumVertices; i++)
+		{
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z);
+			text += line;
+		}
+		for (unsigned int i = 0; i < mesh.mNumVertices; i++)
+		{
+			snprintf(line, sizeof(line), "vt %.6f %.6f\n", mesh.mTextureCoords[0][i].x, mesh.mTextureCoords[0][i].y);
+			text += line;
+		}
+		for (unsigned int i = 0; i < mesh.mNumVertices; i++)
+		{
+			snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", mesh.mNormals[i].x, mesh.mNormals[i].y, mesh.mNormals[i].z);
+			text += line;
+		}
+		for (unsigned int i = 0; i < mesh.mNumFaces; i++)
+		{
+			const unsigned int* corners = mesh.mFaces[i].mIndices;
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", corners[0] + 1, corners[0] + 1, corners[0] + 1,
+				corners[1] + 1, corners[1] + 1, corners[1] + 1, corners[2] + 1, corners[2] + 1, corners[2] + 1);
+			text += line;
+		}
+		return text;
+	}
+
+	void ObjBenchmarks()
+	{
+		// Items are bytes, so the throughput reads as MB/s
+		std::string text = SyntheticObj(512);
+		std::string suffix = "/" + std::to_string(text.size() / (1024 * 1024)) + " MB";
+		unsigned int threadCounts[] = { 1, 0 };
+		for (unsigned int threads : threadCounts)
+		{
+			std::string name = threads == 1 ? "OBJ parse 1 thread" : "OBJ parse all threads";
+			Run(name + suffix, (double)text.size(), [&]()
+			{
+				ObjDocument document;
+				document.numThreads = threads;
+				document.Parse(text.data(), text.size(), ".", true);
+				sink = sink + (float)document.meshes[0].vertices.size();
+			});
+		}
+	}
+
+	// Binary tree of joints, each turning and sliding through keys a second apart
+	void SyntheticSkeleton(size_t numJoints, Skeleton& skeleton, AnimationClip& clip)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		clip.name = "Synthetic";
+		clip.duration = 30.0f;
+		for (size_t i = 0; i < numJoints; i++)
+		{
+			JointPose rest;
+			rest.translation = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+			int joint = skeleton.AddJoint("Joint " + std::to_string(i), i == 0 ? -1 : (int)(i - 1) / 2, rest);
+			skeleton.AddPaletteEntry(joint, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -(float)i, 0.0f)));
+
+			AnimationChannel translation, rotation;
+			translation.joint = rotation.joint = joint;
+			translation.path = ANIMATION_TRANSLATION;
+			rotation.path = ANIMATION_ROTATION;
+			for (int key = 0; key <= 30; key++)
+			{
+				glm::vec4 quaternion = glm::normalize(glm::vec4(distribution(random), distribution(random), distribution(random), 2.0f));
+				translation.times.push_back((float)key);
+				translation.values.push_back(glm::vec4(distribution(random), 1.0f, distribution(random), 0.0f));
+				rotation.times.push_back((float)key);
+				rotation.values.push_back(quaternion);
+			}
+			clip.channels.push_back(std::move(translation));
+			clip.channels.push_back(std::move(rotation));
+		}
+	}
+
+	void PoseBenchmarks()
+	{
+		// A crowd of characters, each a few seconds further into the clip
+		const size_t numCharacters = 256;
+		Skeleton skeleton;
+		AnimationClip clip;
+		SyntheticSkeleton(64, skeleton, clip);
+		std::vector<PoseScratch> scratch(numCharacters);
+		std::vector<glm::vec4> palettes(numCharacters * skeleton.PaletteSize() * 3);
+		std::vector<PoseJob> jobs(numCharacters);
+		for (size_t i = 0; i < numCharacters; i++)
+		{
+			jobs[i].skeleton = &skeleton;
+			jobs[i].clip = &clip;
+			jobs[i].time = i * 0.37f;
+			jobs[i].scratch = &scratch[i];
+			jobs[i].palette = &palettes[i * skeleton.PaletteSize() * 3];
+		}
+		double joints = (double)(numCharacters * skeleton.NumJoints());
+		std::string suffix = "/" + std::to_string(numCharacters) + " x " + std::to_string(skeleton.NumJoints()) + " joints";
+
+		for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++)
+		{
+			useSimdLevel((simdLevel)level);
+			Run(std::string("Pose sampling ") + simdLevelName((simdLevel)level) + " 1 thread" + suffix, joints, [&]()
+			{
+				for (PoseJob& job : jobs)
+					job.time += 0.016f;
+				samplePoses(jobs.data(), jobs.size(), 1);
+				sink = sink + palettes.back().w;
+			});
+		}
+		useSimdLevel(supportedSimdLevel());
+		Run(std::string("Pose sampling ") + simdLevelName(supportedSimdLevel()) + " all threads" + suffix, joints, [&]()
+		{
+			for (PoseJob& job : jobs)
+				job.time += 0.016f;
+			samplePoses(jobs.data(), jobs.size(), 0);
+			sink = sink + palettes.back().w;
+		});
+	}
+
+	std::vector<glm::mat4> RandomMatrices(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+		std::vector<glm::mat4> matrices;
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 translation(distribution(random), distribution(random), distribution(random));
+			glm::vec3 axis = glm::normalize(glm::vec3(distribution(random), distribution(random), distribution(random)) + glm::vec3(0.01f));
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), translation);
+			matrix = glm::rotate(matrix, distribution(random), axis);
+			matrix = glm::scale(matrix, glm::vec3(1.0f + std::abs(distribution(random)) * 0.1f));
+			matrices.push_back(matrix);
+		}
+		return matrices;
+	}
+
+	void DrawMatrixBenchmarks()
+	{
+		std::mt19937 random(1);
+		std::vector<glm::mat4> matrices = RandomMatrices(1024, random);
+		glm::mat4 transformation = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+		// The per mesh work of Model::Draw before the mesh draws itself
+		Run("Model::Draw matrices/1024 meshes", (double)matrices.size(), [&]()
+		{
+			glm::mat3 accumulated(0.0f);
+			for (size_t i = 0; i < matrices.size(); i++)
+			{
+				glm::mat4 objectModelMatrix = transformation * matrices[i];
+				objectModelMatrix = glm::scale(objectModelMatrix, glm::vec3(2.0f));
+				accumulated += normalMatrix(objectModelMatrix);
+			}
+			sink = sink + accumulated[0][0];
+		});
+	}
+
+	void BoundsBenchmarks()
+	{
+		std::mt19937 random(2);
+		std::vector<glm::mat4> matrices = RandomMatrices(4096, random);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		std::vector<glm::vec3> meshMin, meshMax;
+		for (size_t i = 0; i < matrices.size(); i++)
+		{
+			glm::vec3 a(distribution(random), distribution(random), distribution(random));
+			glm::vec3 b(distribution(random), distribution(random), distribution(random));
+			meshMin.push_back(glm::min(a, b));
+			meshMax.push_back(glm::max(a, b));
+		}
+
+		Run("ProcessNode bounds/4096 meshes", (double)matrices.size(), [&]()
+		{
+			glm::vec3 boundsMin(0.0f);
+			glm::vec3 boundsMax(0.0f);
+			for (size_t i = 0; i < matrices.size(); i++)
+				accumulateBounds(matrices[i], meshMin[i], meshMax[i], boundsMin, boundsMax);
+			sink = sink + boundsMax.x - boundsMin.x;
+		});
+	}
+
+	void UniformBenchmarks()
+	{
+		Shader::useBinaryCache = false;
+		Shader shader("void main() {}\n", "void main() {}\n", "");
+		shader.Activate();
+
+		// The uniforms one textured mesh sets in Mesh::Draw, its matrices are in the draw data
+		Run("Shader uniform lookups/mesh draw", 1.0, [&]()
+		{
+			shader.SetInt("diffuseLayer", 0);
+			shader.SetInt("specularLayer", 0);
+			shader.SetInt("drawIndex", 0);
+		});
+		shader.Delete();
+	}
+
+	void TextureBenchmarks()
+	{
+		// Times the full decode, not registering a texture for streaming
+		TextureStreamer::enabled = false;
+		const char* files[] =
+		{
+			"container.jpg",
+			"container2.png",
+			"planksSpec.png",
+			"deccer-cubes/T_Atlas.png"
+		};
+		for (const char* file : files)
+		{
+			std::string path = settings.resources + file;
+			if (!FileExists(path))
+			{
+				std::cout << "Skipping texture decode of missing " << path << std::endl;
+				continue;
+			}
+
+			int width, height, channels;
+			stbi_info(path.c_str(), &width, &height, &channels);
+			Run(std::string("Texture decode/") + file, (double)width * height, [&]()
+			{
+				std::vector<Texture> texture(1, Texture(path, DIFFUSE));
+				createTextureArrays(texture);
+			});
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--filter" && hasValue)
+			settings.filter = argv[++i];
+		else if (argument == "--repetitions" && hasValue)
+			settings.repetitions = std::max(1, atoi(argv[++i]));
+		else if (argument == "--warmup" && hasValue)
+			settings.warmup = std::max(0, atoi(argv[++i]));
+		else if (argument == "--resources" && hasValue)
+			settings.resources = std::string(argv[++i]) + "/";
+		else
+		{
+			std::cout << "Usage: MicroBenchmarks [--filter <text>] [--repetitions <n>] [--warmup <n>] [--resources <dir>]" << std::endl;
+			return -1;
+		}
+	}
+
+	if (!loadNullGL())
+	{
+		std::cout << "Failed to load the null GL functions" << std::endl;
+		return -1;
+	}
+
+	std::cout << "Median time per call, relative standard deviation over " << settings.repetitions << " repetitions" << std::endl;
+	MeshConversionBenchmarks();
+	ObjBenchmarks();
+	PoseBenchmarks();
+	DrawMatrixBenchmarks();
+	BoundsBenchmarks();
+	UniformBenchmarks();
+	TextureBenchmarks();
+	WorkerPool::Stop();
+	return 0;
+}
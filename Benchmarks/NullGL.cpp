@@ -0,0 +1,118 @@
+#include "NullGL.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+namespace
+{
+	GLuint nextName = 1;
+
+	void APIENTRY NullFunction()
+	{
+	}
+
+	const GLubyte* APIENTRY NullGetString(GLenum name)
+	{
+		return (const GLubyte*)(name == GL_VERSION ? "3.3.0 NullGL" : "NullGL");
+	}
+
+	const GLubyte* APIENTRY NullGetStringi(GLenum, GLuint)
+	{
+		return (const GLubyte*)"GL_NULL_placeholder";
+	}
+
+	void APIENTRY NullGetIntegerv(GLenum pname, GLint* data)
+	{
+		// glad fails on an empty extension list, so there is a single one nobody checks for.
+		// Otherwise no binary formats, no bound objects.
+		*data = pname == GL_NUM_EXTENSIONS ? 1 : 0;
+	}
+
+	GLenum APIENTRY NullGetError()
+	{
+		return GL_NO_ERROR;
+	}
+
+	GLuint APIENTRY NullCreate(GLenum)
+	{
+		return nextName++;
+	}
+
+	GLuint APIENTRY NullCreateProgram()
+	{
+		return nextName++;
+	}
+
+	void APIENTRY NullGenNames(GLsizei count, GLuint* names)
+	{
+		for (GLsizei i = 0; i < count; i++)
+			names[i] = nextName++;
+	}
+
+	void APIENTRY NullGetObjectiv(GLuint, GLenum pname, GLint* params)
+	{
+		// Every status query succeeds and there is never an info log
+		*params = pname == GL_INFO_LOG_LENGTH ? 0 : GL_TRUE;
+	}
+
+	void APIENTRY NullGetInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+	{
+		if (length)
+			*length = 0;
+		if (bufSize > 0)
+			infoLog[0] = '\0';
+	}
+
+	GLint APIENTRY NullGetUniformLocation(GLuint, const GLchar* name)
+	{
+		// Depends on the name so the lookup can't be skipped, a driver would hash it as well
+		return (GLint)strlen(name);
+	}
+
+	GLenum APIENTRY NullCheckFramebufferStatus(GLenum)
+	{
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	struct NullEntry
+	{
+		const char* name;
+		void* function;
+	};
+
+	const NullEntry entries[] =
+	{
+		{ "glGetString", (void*)NullGetString },
+		{ "glGetStringi", (void*)NullGetStringi },
+		{ "glGetIntegerv", (void*)NullGetIntegerv },
+		{ "glGetError", (void*)NullGetError },
+		{ "glCreateShader", (void*)NullCreate },
+		{ "glCreateProgram", (void*)NullCreateProgram },
+		{ "glGenBuffers", (void*)NullGenNames },
+		{ "glGenVertexArrays", (void*)NullGenNames },
+		{ "glGenTextures", (void*)NullGenNames },
+		{ "glGenFramebuffers", (void*)NullGenNames },
+		{ "glGenRenderbuffers", (void*)NullGenNames },
+		{ "glGenQueries", (void*)NullGenNames },
+		{ "glGetShaderiv", (void*)NullGetObjectiv },
+		{ "glGetProgramiv", (void*)NullGetObjectiv },
+		{ "glGetShaderInfoLog", (void*)NullGetInfoLog },
+		{ "glGetProgramInfoLog", (void*)NullGetInfoLog },
+		{ "glGetUniformLocation", (void*)NullGetUniformLocation },
+		{ "glCheckFramebufferStatus", (void*)NullCheckFramebufferStatus }
+	};
+
+	void* NullGetProcAddress(const char* name)
+	{
+		for (const NullEntry& entry : entries)
+			if (strcmp(entry.name, name) == 0)
+				return entry.function;
+		return (void*)NullFunction;
+	}
+}
+
+bool loadNullGL()
+{
+	return gladLoadGLLoader((GLADloadproc)NullGetProcAddress) != 0;
+}
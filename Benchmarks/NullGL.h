@@ -0,0 +1,8 @@
+#pragma once
+
+// Loads glad with functions that do nothing, so code which issues GL calls can run without a
+// context or a driver. Queries return plausible values: objects get fresh names, shaders and
+// programs compile and link, framebuffers are complete and the version is OpenGL 3.3.
+// Everything else is a shared no-op, which relies on the caller cleaning up the stack as
+// every 64-bit calling convention does.
+bool loadNullGL();
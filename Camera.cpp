@@ -1,5 +1,7 @@
 #include "Camera.h"
 
+#include <algorithm>
+
 Camera::Camera(int width, int height, glm::vec3 position)
 {
 	Camera::width = width;
@@ -19,6 +21,12 @@ void Camera::UpdateMatrix(float FOVdeg, float nearPlane, float farPlane)
 	projection = glm::perspective(glm::radians(FOVdeg), (float)width / (float)height, nearPlane, farPlane);
 
 	cameraMatrix = projection * view;
+	viewMatrix = view;
+	projectionMatrix = projection;
+
+	Camera::FOVdeg = FOVdeg;
+	Camera::nearPlane = nearPlane;
+	Camera::farPlane = farPlane;
 }
 
 void Camera::UpdateAspectRatio(int width, int height)
@@ -81,7 +89,8 @@ void Camera::ProcessInputs(GLFWwindow* window)
 
 	// using the time gap between frames to determine the speed, so that the speed stays the same across different hardware
 	float currentTime = glfwGetTime();
-	deltaTime = currentTime - lastTime;
+	// Capped so a long pause between frames, e.g. while rendering on demand, is no jump
+	deltaTime = std::min(currentTime - lastTime, 0.1f);
 	lastTime = currentTime;
 	float speed = 2.5f * deltaTime * speedScaler;
 
@@ -0,0 +1,172 @@
+#include "CascadedShadowMap.h"
+
+#include "DrawData.h"
+#include "Profiler.h"
+
+CascadedShadowMap::CascadedShadowMap(int resolution) :
+	depthShaders("shadowDepth.vert", "shadowDepth.frag")
+{
+	CascadedShadowMap::resolution = resolution;
+	depthShaders.onCompile = [](Shader& shader)
+	{
+		DrawData::SetTextureUnits(shader);
+		Animator::SetTextureUnits(shader);
+	};
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, NUM_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Hardware depth comparison gives bilinear PCF for free
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &ID);
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::FRAMEBUFFER::SHADOW_MAP_NOT_COMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	Invalidate();
+}
+
+void CascadedShadowMap::Render(Model& model, Camera& camera, const glm::vec3& lightDirection)
+{
+	PROFILE_GPU_SCOPE("Shadow maps");
+	depthShaders.Poll();
+	renderedCascades = 0;
+	drawnCasters = 0;
+	// Posed meshes cast different shadows every frame
+	if (model.Animated())
+		Invalidate();
+
+	glm::vec3 direction = glm::normalize(lightDirection);
+	if (direction != cachedLightDirection)
+	{
+		Invalidate();
+		cachedLightDirection = direction;
+
+		// Fixed light orientation, only the ortho box moves with the camera
+		glm::vec3 up = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+	}
+
+	float nearPlane = camera.nearPlane;
+	float farPlane = glm::min(camera.farPlane, shadowDistance);
+	float tanY = glm::tan(glm::radians(camera.FOVdeg) * 0.5f);
+	float tanX = tanY * (float)camera.width / (float)camera.height;
+	glm::mat4 inverseView = glm::inverse(camera.viewMatrix);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+	glViewport(0, 0, resolution, resolution);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	float sliceNear = nearPlane;
+	for (int cascade = 0; cascade < NUM_CASCADES; cascade++)
+	{
+		// Practical split scheme between uniform and logarithmic distribution
+		float fraction = (float)(cascade + 1) / NUM_CASCADES;
+		float logSplit = nearPlane * glm::pow(farPlane / nearPlane, fraction);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+		float sliceFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+		splitDepths[cascade] = sliceFar;
+
+		// Bounding sphere of the frustum slice, independent of the camera rotation
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 8; i++)
+		{
+			float depth = (i & 4) ? sliceFar : sliceNear;
+			glm::vec3 viewCorner((i & 1 ? 1.0f : -1.0f) * tanX * depth, (i & 2 ? 1.0f : -1.0f) * tanY * depth, -depth);
+			corners[i] = glm::vec3(inverseView * glm::vec4(viewCorner, 1.0f));
+			center += corners[i] / 8.0f;
+		}
+		float radius = 0.0f;
+		for (int i = 0; i < 8; i++)
+			radius = glm::max(radius, glm::length(corners[i] - center));
+		radius = glm::ceil(radius * 16.0f) / 16.0f;
+		sliceNear = sliceFar;
+
+		bool cached = cacheEnabled && cascade >= firstCachedCascade;
+		if (cached)
+		{
+			// Reuse the last render while the slice still fits inside its enlarged sphere
+			if (valid[cascade] && glm::length(center - cachedCenter[cascade]) + radius <= cachedRadius[cascade])
+				continue;
+			radius *= cacheMargin;
+		}
+
+		RenderCascade(cascade, model, center, radius);
+		renderedCascades++;
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+	glViewport(0, 0, camera.width, camera.height);
+}
+
+void CascadedShadowMap::Invalidate()
+{
+	for (int i = 0; i < NUM_CASCADES; i++)
+		valid[i] = false;
+}
+
+void CascadedShadowMap::SetTextureUnits(Shader& shader)
+{
+	shader.Activate();
+	shader.SetInt("shadowMap", SHADOW_MAP_UNIT);
+}
+
+void CascadedShadowMap::Apply(Shader& shader, Camera& camera)
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+
+	shader.Activate();
+	shader.SetMat4("view", camera.viewMatrix);
+	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "lightSpaceMatrices"), NUM_CASCADES, GL_FALSE, &lightMatrices[0][0][0]);
+	glUniform1fv(glGetUniformLocation(shader.ID, "cascadeSplits"), NUM_CASCADES, splitDepths);
+}
+
+void CascadedShadowMap::Delete()
+{
+	depthShaders.Delete();
+	glDeleteTextures(1, &depthTexture);
+	glDeleteFramebuffers(1, &ID);
+}
+
+void CascadedShadowMap::RenderCascade(int cascade, Model& model, const glm::vec3& center, float radius)
+{
+	PROFILE_GPU_SCOPE("Shadow cascade");
+	// Snap the box center to whole texels in light space
+	float texelSize = 2.0f * radius / resolution;
+	glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+	lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+
+	// Extend the box towards the light so casters outside the slice still land in the map
+	float casterDistance = glm::max(radius, shadowDistance);
+	glm::vec3 boundsMin(lightCenter.x - radius, lightCenter.y - radius, lightCenter.z - radius);
+	glm::vec3 boundsMax(lightCenter.x + radius, lightCenter.y + radius, lightCenter.z + radius + casterDistance);
+
+	// The light looks down -z, so near and far are the negated z bounds
+	glm::mat4 projection = glm::ortho(boundsMin.x, boundsMax.x, boundsMin.y, boundsMax.y, -boundsMax.z, -boundsMin.z);
+	lightMatrices[cascade] = projection * lightView;
+
+	valid[cascade] = true;
+	cachedCenter[cascade] = center;
+	cachedRadius[cascade] = radius;
+
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	drawnCasters += model.DrawShadowCasters(depthShaders, lightMatrices[cascade], lightView, boundsMin, boundsMax);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Model.h"
+
+// Cascaded shadow maps for the directional light. Each cascade covers a slice of the camera
+// frustum with a bounding sphere, snapped to whole texels so the map does not shimmer while
+// the camera moves. Distant cascades are rendered with extra margin and kept until the camera
+// leaves that margin, the light turns, the model animates or the scene is invalidated.
+class CascadedShadowMap
+{
+public:
+	static const int NUM_CASCADES = 4;
+	static const GLuint SHADOW_MAP_UNIT = 12;
+
+	int resolution;
+	float shadowDistance = 20.0f;
+	// Blend between uniform (0) and logarithmic (1) split distances
+	float splitLambda = 0.75f;
+	// Cascades from this index on are cached
+	int firstCachedCascade = 2;
+	float cacheMargin = 1.5f;
+	bool cacheEnabled = true;
+	// Framebuffer bound again after the cascades are rendered, 0 for the window
+	GLuint targetFramebuffer = 0;
+
+	// Plain and FEATURE_SKINNING variants
+	ShaderPermutations depthShaders;
+
+	CascadedShadowMap(int resolution = 2048);
+
+	void Render(Model& model, Camera& camera, const glm::vec3& lightDirection);
+	void Invalidate();
+	void SetTextureUnits(Shader& shader);
+	void Apply(Shader& shader, Camera& camera);
+	void Delete();
+
+	int RenderedCascades() const { return renderedCascades; }
+	int DrawnCasters() const { return (int)drawnCasters; }
+
+private:
+	GLuint ID = 0;
+	GLuint depthTexture = 0;
+
+	glm::mat4 lightView = glm::mat4(1.0f);
+	glm::mat4 lightMatrices[NUM_CASCADES];
+	float splitDepths[NUM_CASCADES];
+
+	// What each cascade was last rendered with
+	bool valid[NUM_CASCADES];
+	glm::vec3 cachedCenter[NUM_CASCADES];
+	float cachedRadius[NUM_CASCADES];
+	glm::vec3 cachedLightDirection = glm::vec3(0.0f);
+
+	int renderedCascades = 0;
+	size_t drawnCasters = 0;
+
+	void RenderCascade(int cascade, Model& model, const glm::vec3& center, float radius);
+};
@@ -0,0 +1,273 @@
+#include "ClusteredLights.h"
+
+#include <cfloat>
+#include <chrono>
+
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTER_SIMD 1
+#include <emmintrin.h>
+#endif
+
+ClusteredLights::ClusteredLights()
+{
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+
+	glGenBuffers(1, &clusterGridBuffer);
+	glGenBuffers(1, &lightIndexBuffer);
+
+	glGenTextures(1, &clusterGridTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, NUM_CLUSTERS * 2 * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, clusterGridBuffer);
+
+	glGenTextures(1, &lightIndexTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+	glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint), NULL, GL_STREAM_DRAW);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, lightIndexBuffer);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	clusterGrid.resize(NUM_CLUSTERS * 2);
+	sliceIndices.resize(GRID_Z);
+	sliceCounts.resize(GRID_Z);
+}
+
+void ClusteredLights::Update(Camera& camera, const LightManager& lights)
+{
+	PROFILE_SCOPE("Cluster binning");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	BuildClusterBounds(camera);
+
+	const std::vector<glm::vec3>& positions = lights.Positions();
+	const std::vector<float>& radii = lights.Radii();
+	numLights = lights.Size();
+	size_t paddedLights = (numLights + 3) & ~size_t(3);
+	sphereX.assign(paddedLights, 0.0f);
+	sphereY.assign(paddedLights, 0.0f);
+	sphereZ.assign(paddedLights, 0.0f);
+	// Padding lanes get a negative radius so they never pass the overlap test
+	sphereRadius.assign(paddedLights, -1.0f);
+
+	// Transform the bounding spheres into view space
+	for (size_t i = 0; i < numLights; i++)
+	{
+		glm::vec3 viewPosition = glm::vec3(camera.viewMatrix * glm::vec4(positions[i], 1.0f));
+		sphereX[i] = viewPosition.x;
+		sphereY[i] = viewPosition.y;
+		sphereZ[i] = viewPosition.z;
+		sphereRadius[i] = radii[i];
+	}
+
+	// Bin every depth slice on its own worker, slices are independent of each other
+	parallelFor(GRID_Z, 0, [&](size_t slice) { BinSlice((int)slice); });
+
+	// Merge the slices into one index list with global offsets
+	lightIndices.clear();
+	size_t maxIndices = (size_t)maxTextureBufferSize;
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		const std::vector<GLuint>& counts = sliceCounts[z];
+		const std::vector<GLuint>& indices = sliceIndices[z];
+		size_t sliceOffset = 0;
+		for (int tile = 0; tile < GRID_X * GRID_Y; tile++)
+		{
+			size_t cluster = (size_t)z * GRID_X * GRID_Y + tile;
+			GLuint count = counts[tile];
+			if (lightIndices.size() + count > maxIndices)
+				count = (GLuint)(maxIndices - lightIndices.size());
+
+			clusterGrid[cluster * 2] = (GLuint)lightIndices.size();
+			clusterGrid[cluster * 2 + 1] = count;
+			lightIndices.insert(lightIndices.end(), indices.begin() + sliceOffset, indices.begin() + sliceOffset + count);
+			sliceOffset += counts[tile];
+		}
+	}
+
+	// Orphan and refill the cluster buffers every frame
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, clusterGrid.size() * sizeof(GLuint), clusterGrid.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, glm::max(lightIndices.size(), size_t(1)) * sizeof(GLuint), lightIndices.empty() ? NULL : lightIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	binningMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void ClusteredLights::SetTextureUnits(Shader& shader)
+{
+	// Sampler uniforms default to unit 0, which would clash with textureDiffuse even when unused
+	shader.Activate();
+	shader.SetInt("lightData", LIGHT_DATA_UNIT);
+	shader.SetInt("clusterGrid", CLUSTER_GRID_UNIT);
+	shader.SetInt("lightIndices", LIGHT_INDEX_UNIT);
+}
+
+void ClusteredLights::Apply(Shader& shader, Camera& camera, LightManager& lights)
+{
+	lights.Bind(LIGHT_DATA_UNIT);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+	glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+
+	shader.Activate();
+	shader.SetMat4("view", camera.viewMatrix);
+	shader.SetVec2("screenSize", (float)camera.width, (float)camera.height);
+	shader.SetFloat("clusterNear", camera.nearPlane);
+	shader.SetFloat("clusterFar", camera.farPlane);
+}
+
+void ClusteredLights::Delete()
+{
+	glDeleteTextures(1, &clusterGridTexture);
+	glDeleteTextures(1, &lightIndexTexture);
+	glDeleteBuffers(1, &clusterGridBuffer);
+	glDeleteBuffers(1, &lightIndexBuffer);
+}
+
+void ClusteredLights::BuildClusterBounds(Camera& camera)
+{
+	float aspect = (float)camera.width / (float)camera.height;
+	if (camera.FOVdeg == cachedFOV && aspect == cachedAspect && camera.nearPlane == cachedNear && camera.farPlane == cachedFar)
+		return;
+
+	cachedFOV = camera.FOVdeg;
+	cachedAspect = aspect;
+	cachedNear = camera.nearPlane;
+	cachedFar = camera.farPlane;
+
+	clusterMin.resize(NUM_CLUSTERS);
+	clusterMax.resize(NUM_CLUSTERS);
+
+	// Half extents of the view frustum at a distance of 1
+	float tanY = glm::tan(glm::radians(camera.FOVdeg) * 0.5f);
+	float tanX = tanY * aspect;
+
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		float nearDepth = SliceDepth(z);
+		float farDepth = SliceDepth(z + 1);
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			float ndcY0 = -1.0f + 2.0f * y / GRID_Y;
+			float ndcY1 = -1.0f + 2.0f * (y + 1) / GRID_Y;
+			for (int x = 0; x < GRID_X; x++)
+			{
+				float ndcX0 = -1.0f + 2.0f * x / GRID_X;
+				float ndcX1 = -1.0f + 2.0f * (x + 1) / GRID_X;
+
+				// The tile's side planes go through the eye, so the extremes lie on the near and far slice planes
+				glm::vec3 minPoint(FLT_MAX);
+				glm::vec3 maxPoint(-FLT_MAX);
+				float depths[] = { nearDepth, farDepth };
+				for (int d = 0; d < 2; d++)
+				{
+					glm::vec3 a(ndcX0 * tanX * depths[d], ndcY0 * tanY * depths[d], -depths[d]);
+					glm::vec3 b(ndcX1 * tanX * depths[d], ndcY1 * tanY * depths[d], -depths[d]);
+					minPoint = glm::min(minPoint, glm::min(a, b));
+					maxPoint = glm::max(maxPoint, glm::max(a, b));
+				}
+
+				size_t cluster = ((size_t)z * GRID_Y + y) * GRID_X + x;
+				clusterMin[cluster] = minPoint;
+				clusterMax[cluster] = maxPoint;
+			}
+		}
+	}
+}
+
+void ClusteredLights::BinSlice(int slice)
+{
+	std::vector<GLuint>& indices = sliceIndices[slice];
+	std::vector<GLuint>& counts = sliceCounts[slice];
+	indices.clear();
+	counts.assign(GRID_X * GRID_Y, 0);
+
+	// Depth test against the slice first so the per-cluster tests only see nearby lights
+	float sliceNear = SliceDepth(slice);
+	float sliceFar = SliceDepth(slice + 1);
+	std::vector<GLuint> candidates;
+	for (size_t i = 0; i < numLights; i++)
+	{
+		float depth = -sphereZ[i];
+		if (depth + sphereRadius[i] >= sliceNear && depth - sphereRadius[i] <= sliceFar)
+			candidates.push_back((GLuint)i);
+	}
+	if (candidates.empty())
+		return;
+
+	size_t paddedCandidates = (candidates.size() + 3) & ~size_t(3);
+	std::vector<float> x(paddedCandidates, 0.0f), y(paddedCandidates, 0.0f), z(paddedCandidates, 0.0f), r(paddedCandidates, -1.0f);
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		x[i] = sphereX[candidates[i]];
+		y[i] = sphereY[candidates[i]];
+		z[i] = sphereZ[candidates[i]];
+		r[i] = sphereRadius[candidates[i]];
+	}
+
+	for (int tile = 0; tile < GRID_X * GRID_Y; tile++)
+	{
+		size_t cluster = (size_t)slice * GRID_X * GRID_Y + tile;
+		const glm::vec3& minPoint = clusterMin[cluster];
+		const glm::vec3& maxPoint = clusterMax[cluster];
+		GLuint count = 0;
+
+#ifdef CLUSTER_SIMD
+		// Sphere against AABB for four lights at a time
+		__m128 zero = _mm_setzero_ps();
+		__m128 minX = _mm_set1_ps(minPoint.x), minY = _mm_set1_ps(minPoint.y), minZ = _mm_set1_ps(minPoint.z);
+		__m128 maxX = _mm_set1_ps(maxPoint.x), maxY = _mm_set1_ps(maxPoint.y), maxZ = _mm_set1_ps(maxPoint.z);
+		for (size_t i = 0; i < paddedCandidates; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(&x[i]);
+			__m128 py = _mm_loadu_ps(&y[i]);
+			__m128 pz = _mm_loadu_ps(&z[i]);
+			__m128 pr = _mm_loadu_ps(&r[i]);
+
+			__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minX, px), _mm_sub_ps(px, maxX)));
+			__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minY, py), _mm_sub_ps(py, maxY)));
+			__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minZ, pz), _mm_sub_ps(pz, maxZ)));
+			__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 inside = _mm_and_ps(_mm_cmple_ps(distance2, _mm_mul_ps(pr, pr)), _mm_cmpge_ps(pr, zero));
+
+			int mask = _mm_movemask_ps(inside);
+			while (mask)
+			{
+				int lane = 0;
+				while (!(mask & (1 << lane)))
+					lane++;
+				mask &= ~(1 << lane);
+				indices.push_back(candidates[i + lane]);
+				count++;
+			}
+		}
+#else
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			glm::vec3 center(x[i], y[i], z[i]);
+			glm::vec3 delta = glm::max(glm::vec3(0.0f), glm::max(minPoint - center, center - maxPoint));
+			if (glm::dot(delta, delta) <= r[i] * r[i])
+			{
+				indices.push_back(candidates[i]);
+				count++;
+			}
+		}
+#endif
+		counts[tile] = count;
+	}
+}
+
+float ClusteredLights::SliceDepth(int slice) const
+{
+	// Exponential slicing keeps clusters roughly cubic in view space
+	return cachedNear * glm::pow(cachedFar / cachedNear, (float)slice / GRID_Z);
+}
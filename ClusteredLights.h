@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Camera.h"
+#include "LightManager.h"
+
+// Clustered forward shading: the view frustum is split into a froxel grid and every
+// point/spot light is binned on the CPU into the clusters its bounding sphere touches.
+// Per-cluster ranges and the light index list are uploaded as texture buffers, the light
+// data itself comes from the LightManager's shared buffer.
+class ClusteredLights
+{
+public:
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+
+	// Texture units reserved above the ones Mesh::Draw hands out for material textures
+	static const GLuint LIGHT_DATA_UNIT = 13;
+	static const GLuint CLUSTER_GRID_UNIT = 14;
+	static const GLuint LIGHT_INDEX_UNIT = 15;
+
+	ClusteredLights();
+
+	void Update(Camera& camera, const LightManager& lights);
+	void SetTextureUnits(Shader& shader);
+	void Apply(Shader& shader, Camera& camera, LightManager& lights);
+	void Delete();
+
+	size_t NumLights() const { return numLights; }
+	size_t NumLightIndices() const { return lightIndices.size(); }
+	float BinningTime() const { return binningMilliseconds; }
+
+private:
+	GLuint clusterGridBuffer = 0;
+	GLuint clusterGridTexture = 0;
+	GLuint lightIndexBuffer = 0;
+	GLuint lightIndexTexture = 0;
+	GLint maxTextureBufferSize = 65536;
+
+	size_t numLights = 0;
+	float binningMilliseconds = 0.0f;
+
+	// (offset, count) into lightIndices per cluster
+	std::vector<GLuint> clusterGrid;
+	std::vector<GLuint> lightIndices;
+
+	// View space bounds of every cluster, rebuilt when the projection changes
+	std::vector<glm::vec3> clusterMin;
+	std::vector<glm::vec3> clusterMax;
+	float cachedFOV = 0.0f;
+	float cachedAspect = 0.0f;
+	float cachedNear = 0.0f;
+	float cachedFar = 0.0f;
+
+	// View space bounding spheres in structure-of-arrays form, padded to a multiple of 4
+	std::vector<float> sphereX;
+	std::vector<float> sphereY;
+	std::vector<float> sphereZ;
+	std::vector<float> sphereRadius;
+
+	// Per-slice binning results, merged after all worker threads finish
+	std::vector<std::vector<GLuint>> sliceIndices;
+	std::vector<std::vector<GLuint>> sliceCounts;
+
+	void BuildClusterBounds(Camera& camera);
+	void BinSlice(int slice);
+	float SliceDepth(int slice) const;
+};
@@ -0,0 +1,137 @@
+#include "DeferredRenderer.h"
+
+#include "DrawData.h"
+#include "Profiler.h"
+
+// Unit cube wound counter-clockwise from the outside, scaled to each light's radius
+static Mesh CreateLightVolume()
+{
+	std::vector<Vertex> vertices =
+	{
+		Vertex{glm::vec3(-1.0f, -1.0f,  1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(1.0f, -1.0f,  1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(-1.0f,  1.0f,  1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(-1.0f,  1.0f, -1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(1.0f,  1.0f, -1.0f), glm::vec3(0.0f), glm::vec2(0.0f)},
+		Vertex{glm::vec3(1.0f,  1.0f,  1.0f), glm::vec3(0.0f), glm::vec2(0.0f)}
+	};
+	std::vector<GLuint> indices =
+	{
+		0, 1, 2,
+		0, 2, 3,
+		0, 7, 4,
+		0, 3, 7,
+		3, 6, 7,
+		3, 2, 6,
+		2, 5, 6,
+		2, 1, 5,
+		1, 4, 5,
+		1, 0, 4,
+		4, 6, 5,
+		4, 7, 6
+	};
+	return Mesh(vertices, indices);
+}
+
+DeferredRenderer::DeferredRenderer(int width, int height) :
+	gBuffer(width, height),
+	geometryShaders("default.vert", "gBuffer.frag"),
+	dirLightShader("screenQuad.vert", "deferredDirLight.frag"),
+	pointLightShader("deferredPointLight.vert", "deferredPointLight.frag"),
+	lightVolume(CreateLightVolume())
+{
+	// The programs are only compiled once the deferred path is actually used
+	geometryShaders.onCompile = [](Shader& shader)
+	{
+		Texture::SetTextureUnits(shader);
+		DrawData::SetTextureUnits(shader);
+		Animator::SetTextureUnits(shader);
+	};
+	dirLightShader.onCompile = [](Shader& shader)
+	{
+		shader.SetInt("gAlbedoSpecular", 0);
+		shader.SetInt("gNormal", 1);
+		shader.SetInt("gDepth", 2);
+	};
+
+	pointLightShader.onCompile = [](Shader& shader)
+	{
+		shader.SetInt("gAlbedoSpecular", 0);
+		shader.SetInt("gNormal", 1);
+		shader.SetInt("gDepth", 2);
+		shader.SetInt("lightData", 3);
+	};
+}
+
+void DeferredRenderer::Render(Model& model, Camera& camera, LightManager& lights)
+{
+	geometryShaders.Poll();
+	dirLightShader.Poll();
+	pointLightShader.Poll();
+	gBuffer.Resize(camera.width, camera.height);
+
+	// Geometry pass
+	{
+		PROFILE_GPU_SCOPE("Geometry pass");
+		gBuffer.Bind();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		model.Draw(geometryShaders, camera);
+		gBuffer.BlitDepth(targetFramebuffer);
+	}
+
+	glm::mat4 inverseCamera = glm::inverse(camera.cameraMatrix);
+	gBuffer.BindTextures(0);
+
+	// Directional light over every covered pixel
+	{
+		PROFILE_GPU_SCOPE("Directional light");
+		glDisable(GL_DEPTH_TEST);
+		dirLightShader.Activate();
+		dirLightShader.SetMat4("inverseCamera", inverseCamera);
+		dirLightShader.SetVec3("cameraPosition", camera.Position);
+		dirLightShader.SetFloat("shininess", shininess);
+		screenVAO.Bind();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		Profiler::CountDraw(1);
+		screenVAO.Unbind();
+	}
+
+	// Point lights are accumulated only where a light volume's back faces lie behind the scene depth,
+	// so the cost follows the lit pixels instead of meshes times lights
+	PROFILE_GPU_SCOPE("Light volumes");
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_GEQUAL);
+	glDepthMask(GL_FALSE);
+	glCullFace(GL_FRONT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	lights.Bind(3);
+	pointLightShader.Activate();
+	pointLightShader.SetMat4("inverseCamera", inverseCamera);
+	pointLightShader.SetVec2("screenSize", (float)gBuffer.width, (float)gBuffer.height);
+	pointLightShader.SetFloat("shininess", shininess);
+	pointLightShader.SetVec3("cameraPosition", camera.Position);
+	camera.SetShaderMatrix(pointLightShader, "camera");
+	lightVolume.VAO.Bind();
+	glDrawElementsInstanced(GL_TRIANGLES, lightVolume.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)lights.Size());
+	Profiler::CountDraw(lightVolume.indexCount / 3, lights.Size());
+	lightVolume.VAO.Unbind();
+
+	glDisable(GL_BLEND);
+	glCullFace(GL_BACK);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+void DeferredRenderer::Delete()
+{
+	gBuffer.Delete();
+	geometryShaders.Delete();
+	dirLightShader.Delete();
+	pointLightShader.Delete();
+	screenVAO.Delete();
+	lightVolume.Delete();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "GBuffer.h"
+#include "Model.h"
+#include "LightManager.h"
+
+class DeferredRenderer
+{
+public:
+	GBuffer gBuffer;
+
+	// Geometry pass, writes the G-buffer with the same vertex stage as the forward shader. Plain
+	// and FEATURE_SKINNING variants.
+	ShaderPermutations geometryShaders;
+	// Fullscreen pass for the directional light and ambient term
+	Shader dirLightShader;
+	// Light volume pass, one instanced bounding cube per point or spot light
+	Shader pointLightShader;
+
+	float shininess = 4.0f;
+	// Framebuffer the lit scene ends up in, 0 for the window
+	GLuint targetFramebuffer = 0;
+
+	DeferredRenderer(int width, int height);
+
+	void Render(Model& model, Camera& camera, LightManager& lights);
+	void Delete();
+
+private:
+	VertexArray screenVAO;
+	Mesh lightVolume;
+};
@@ -0,0 +1,95 @@
+#include "DeletionQueue.h"
+
+#include <deque>
+#include <vector>
+
+namespace
+{
+	struct PendingObject
+	{
+		glObjectType type;
+		GLuint ID;
+	};
+
+	struct Batch
+	{
+		std::vector<PendingObject> objects;
+		GLsync fence = nullptr;
+	};
+
+	// Oldest first, the last batch collects the current frame
+	std::deque<Batch> batches;
+	bool framesStarted = false;
+	bool shutDown = false;
+
+	void deleteObject(const PendingObject& object)
+	{
+		switch (object.type)
+		{
+		case GL_OBJECT_BUFFER:
+			glDeleteBuffers(1, &object.ID);
+			break;
+		case GL_OBJECT_VERTEX_ARRAY:
+			glDeleteVertexArrays(1, &object.ID);
+			break;
+		case GL_OBJECT_TEXTURE:
+			glDeleteTextures(1, &object.ID);
+			break;
+		}
+	}
+
+	void deleteBatch(Batch& batch)
+	{
+		for (const PendingObject& object : batch.objects)
+			deleteObject(object);
+		if (batch.fence)
+			glDeleteSync(batch.fence);
+	}
+}
+
+void DeletionQueue::Delete(glObjectType type, GLuint ID)
+{
+	if (ID == 0 || shutDown)
+		return;
+	if (!framesStarted)
+	{
+		deleteObject(PendingObject{ type, ID });
+		return;
+	}
+	if (batches.empty() || batches.back().fence)
+		batches.emplace_back();
+	batches.back().objects.push_back(PendingObject{ type, ID });
+}
+
+void DeletionQueue::EndFrame()
+{
+	framesStarted = true;
+	if (!batches.empty() && !batches.back().fence)
+		batches.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// Fences pass in order, so the first one still pending ends the sweep
+	while (!batches.empty())
+	{
+		GLenum status = glClientWaitSync(batches.front().fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		deleteBatch(batches.front());
+		batches.pop_front();
+	}
+}
+
+void DeletionQueue::Shutdown()
+{
+	for (Batch& batch : batches)
+		deleteBatch(batch);
+	batches.clear();
+	shutDown = true;
+}
+
+size_t DeletionQueue::NumPending()
+{
+	size_t pending = 0;
+	for (const Batch& batch : batches)
+		pending += batch.objects.size();
+	return pending;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+enum glObjectType
+{
+	GL_OBJECT_BUFFER,
+	GL_OBJECT_VERTEX_ARRAY,
+	GL_OBJECT_TEXTURE
+};
+
+// Holds GL objects released by their owners until the frames that may still use them are done
+// on the GPU. Objects released during a frame join that frame's batch, EndFrame puts a fence
+// behind it and deletes the batches whose fence passed. Until the first EndFrame no frame is
+// in flight and objects are deleted right away.
+class DeletionQueue
+{
+public:
+	static void Delete(glObjectType type, GLuint ID);
+	static void EndFrame();
+	// Deletes everything at once and drops objects released later, before the context goes away
+	static void Shutdown();
+
+	static size_t NumPending();
+};
@@ -0,0 +1,84 @@
+#include "DrawData.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// Room for 4096 draws per frame to begin with
+	const size_t INITIAL_REGION_BYTES = 4096 * DrawData::TEXELS_PER_DRAW * sizeof(glm::vec4);
+
+	StreamBuffer buffer;
+	unsigned int epoch = 1;
+}
+
+void DrawData::BeginFrame()
+{
+	if (!buffer.textureID)
+		buffer.Create(INITIAL_REGION_BYTES);
+	buffer.BeginFrame();
+	epoch++;
+}
+
+void DrawData::EndFrame()
+{
+	if (buffer.textureID)
+		buffer.EndFrame();
+}
+
+glm::vec4* DrawData::Allocate(size_t draws, int& firstDraw)
+{
+	if (!buffer.textureID)
+		buffer.Create(INITIAL_REGION_BYTES);
+
+	size_t bytes = draws * TEXELS_PER_DRAW * sizeof(glm::vec4);
+	if (!buffer.Fits(bytes))
+	{
+		// Draws written before in this frame point into the old buffer, the new epoch makes
+		// their models write them again
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		size_t regionBytes = std::max(buffer.RegionBytes() * 2, bytes * 2);
+		if (maxTexels > 0 && regionBytes * StreamBuffer::NUM_REGIONS > (size_t)maxTexels * sizeof(glm::vec4))
+			std::cout << "ERROR::DRAW_DATA::" << regionBytes * StreamBuffer::NUM_REGIONS / sizeof(glm::vec4)
+				<< " texels exceed GL_MAX_TEXTURE_BUFFER_SIZE of " << maxTexels << std::endl;
+		buffer.Grow(regionBytes);
+		epoch++;
+	}
+
+	size_t offset;
+	glm::vec4* texels = (glm::vec4*)buffer.Map(bytes, offset);
+	firstDraw = (int)(offset / (TEXELS_PER_DRAW * sizeof(glm::vec4)));
+	return texels;
+}
+
+void DrawData::Commit()
+{
+	buffer.Unmap();
+}
+
+unsigned int DrawData::Epoch()
+{
+	return epoch;
+}
+
+void DrawData::Bind()
+{
+	buffer.Bind(DRAW_DATA_UNIT);
+}
+
+void DrawData::SetTextureUnits(Shader& shader)
+{
+	shader.SetInt("drawData", DRAW_DATA_UNIT);
+}
+
+void DrawData::Delete()
+{
+	if (buffer.textureID)
+		buffer.Delete();
+}
+
+const StreamBuffer& DrawData::Buffer()
+{
+	return buffer;
+}
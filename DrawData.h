@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+// Model and normal matrix of every draw in the frame, written into a StreamBuffer once per
+// model and frame. Shaders fetch them from the drawData texture buffer at drawIndex, so a
+// draw sets one integer instead of its matrices.
+//
+// Layout, TEXELS_PER_DRAW RGBA32F texels per draw:
+//   0-3: model matrix columns
+//   4-6: normal matrix columns in xyz
+class DrawData
+{
+public:
+	static const GLuint DRAW_DATA_UNIT = 11;
+	static const int TEXELS_PER_DRAW = 7;
+
+	static void BeginFrame();
+	static void EndFrame();
+
+	// Space for the given number of draws, the first one has index firstDraw. Commit after
+	// writing and before drawing.
+	static glm::vec4* Allocate(size_t draws, int& firstDraw);
+	static void Commit();
+	// Changes every frame and when the buffer had to grow, indices from an older epoch are stale
+	static unsigned int Epoch();
+
+	static void Bind();
+	static void SetTextureUnits(Shader& shader);
+	static void Delete();
+
+	static const StreamBuffer& Buffer();
+};
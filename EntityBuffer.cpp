@@ -1,11 +1,40 @@
 #include "EntityBuffer.h"
 
-EntityBuffer::EntityBuffer(std::vector<GLuint>& indices)
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "MemoryTracker.h"
+
+EntityBuffer::EntityBuffer(const std::vector<GLuint>& indices)
 {
-	ID = 0;
 	glGenBuffers(1, &ID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	MemoryTracker::Allocate(MEMORY_INDEX_BUFFER, ID, indices.size() * sizeof(GLuint));
+}
+
+EntityBuffer::EntityBuffer(size_t numIndices, const void* data)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLuint), data, GL_STATIC_DRAW);
+	MemoryTracker::Allocate(MEMORY_INDEX_BUFFER, ID, numIndices * sizeof(GLuint));
+}
+
+EntityBuffer::EntityBuffer(EntityBuffer&& other) noexcept : ID(other.ID)
+{
+	other.ID = 0;
+}
+
+EntityBuffer& EntityBuffer::operator=(EntityBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
 }
 
 void EntityBuffer::Bind()
@@ -18,7 +47,26 @@ void EntityBuffer::Unbind()
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+GLuint* EntityBuffer::Map(size_t numIndices)
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	GLuint* indices = (GLuint*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, numIndices * sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!indices)
+		std::cout << "ERROR::ENTITY_BUFFER::MAPPING_FAILED" << std::endl;
+	return indices;
+}
+
+void EntityBuffer::Unmap()
+{
+	if (!glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER))
+		std::cout << "ERROR::ENTITY_BUFFER::CONTENTS_LOST" << std::endl;
+}
+
 void EntityBuffer::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	if (ID == 0)
+		return;
+	MemoryTracker::Free(MEMORY_INDEX_BUFFER, ID);
+	DeletionQueue::Delete(GL_OBJECT_BUFFER, ID);
+	ID = 0;
 }
\ No newline at end of file
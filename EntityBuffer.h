@@ -2,15 +2,29 @@
 
 #include <glad/glad.h>
 
+#include <cstddef>
 #include <vector>
 
+// Owns its buffer, moving hands it over and destruction releases it to the DeletionQueue
 class EntityBuffer
 {
 public:
-	GLuint ID;
-	EntityBuffer(std::vector<GLuint>& indices);
+	GLuint ID = 0;
+	EntityBuffer() {}
+	EntityBuffer(const std::vector<GLuint>& indices);
+	// Storage for numIndices indices, copied from data or filled through Map if it is null
+	explicit EntityBuffer(size_t numIndices, const void* data = NULL);
+	EntityBuffer(EntityBuffer&& other) noexcept;
+	EntityBuffer& operator=(EntityBuffer&& other) noexcept;
+	EntityBuffer(const EntityBuffer&) = delete;
+	EntityBuffer& operator=(const EntityBuffer&) = delete;
+	~EntityBuffer() { Delete(); }
 
 	void Bind();
 	void Unbind();
+	// Binds the buffer and maps all of it for writing, the previous contents are discarded
+	GLuint* Map(size_t numIndices);
+	void Unmap();
+	// Releases the buffer early, the destructor does it otherwise
 	void Delete();
 };
\ No newline at end of file
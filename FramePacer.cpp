@@ -0,0 +1,226 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+const int FramePacer::HISTORY_SIZE;
+const int FramePacer::REDRAW_FRAMES;
+int FramePacer::targetFps = 0;
+int FramePacer::swapInterval = 1;
+bool FramePacer::lowLatency = false;
+bool FramePacer::renderOnDemand = false;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Clock::time_point deadline;
+	bool hasDeadline = false;
+	int deadlineFps = 0;
+
+	// Running mean and variance of how long a 1 ms sleep really takes
+	double sleepMean = 0.002;
+	double sleepM2 = 0.0;
+	long long sleepCount = 1;
+
+	Clock::time_point lastInput;
+	Clock::time_point frameInput;
+	Clock::time_point lastPresent;
+	bool hasInput = false;
+	bool hasFrameInput = false;
+	bool hasPresent = false;
+
+	float frameHistory[FramePacer::HISTORY_SIZE] = {};
+	float latencyHistory[FramePacer::HISTORY_SIZE] = {};
+	int numFrames = 0;
+	int numLatencies = 0;
+	float waitMilliseconds = 0.0f;
+	bool adaptiveSync = false;
+
+	// Longest sleep without events, background work is checked this often while idle
+	const double IDLE_TIMEOUT = 0.25;
+	int redrawFrames = FramePacer::REDRAW_FRAMES;
+
+	void onCursorPos(GLFWwindow*, double, double) { FramePacer::RequestRedraw(); }
+	void onCursorEnter(GLFWwindow*, int) { FramePacer::RequestRedraw(); }
+	void onMouseButton(GLFWwindow*, int, int, int) { FramePacer::RequestRedraw(); }
+	void onScroll(GLFWwindow*, double, double) { FramePacer::RequestRedraw(); }
+	void onKey(GLFWwindow*, int, int, int, int) { FramePacer::RequestRedraw(); }
+	void onChar(GLFWwindow*, unsigned int) { FramePacer::RequestRedraw(); }
+	void onWindowFocus(GLFWwindow*, int) { FramePacer::RequestRedraw(); }
+	void onWindowRefresh(GLFWwindow*) { FramePacer::RequestRedraw(); }
+
+	float milliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<float, std::milli>(duration).count();
+	}
+
+	// Sleeps while the deadline is further away than a pessimistic sleep, then spins
+	void waitUntil(Clock::time_point until)
+	{
+		while (true)
+		{
+			double remaining = std::chrono::duration<double>(until - Clock::now()).count();
+			double estimate = sleepMean + std::sqrt(sleepM2 / sleepCount);
+			if (remaining <= estimate)
+				break;
+
+			Clock::time_point start = Clock::now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			double observed = std::chrono::duration<double>(Clock::now() - start).count();
+
+			// Welford's update, capped so the estimate keeps following the system timer
+			sleepCount = std::min(sleepCount + 1, 1000LL);
+			double delta = observed - sleepMean;
+			sleepMean += delta / sleepCount;
+			sleepM2 += delta * (observed - sleepMean);
+		}
+		while (Clock::now() < until)
+			std::this_thread::yield();
+	}
+
+	float average(const float* history, int count)
+	{
+		int n = std::min(count, FramePacer::HISTORY_SIZE);
+		if (n == 0)
+			return 0.0f;
+		float sum = 0.0f;
+		for (int i = 0; i < n; i++)
+			sum += history[i];
+		return sum / n;
+	}
+}
+
+void FramePacer::Apply()
+{
+	adaptiveSync = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+	if (swapInterval < 0 && !adaptiveSync)
+		swapInterval = 1;
+	glfwSwapInterval(swapInterval);
+}
+
+void FramePacer::WaitForNextFrame()
+{
+#ifdef _WIN32
+	// The default timer resolution of 15.6 ms would leave most of a frame to spinning, the
+	// process keeps the raised resolution until it exits
+	static bool timerResolutionRaised = false;
+	if (!timerResolutionRaised)
+	{
+		timeBeginPeriod(1);
+		timerResolutionRaised = true;
+	}
+#endif
+
+	waitMilliseconds = 0.0f;
+	if (targetFps <= 0)
+	{
+		hasDeadline = false;
+		return;
+	}
+
+	Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+	Clock::time_point now = Clock::now();
+	if (!hasDeadline || deadlineFps != targetFps || now > deadline + period)
+	{
+		// First frame, a new rate or a missed deadline, pace from now on
+		deadline = now + period;
+		hasDeadline = true;
+		deadlineFps = targetFps;
+		return;
+	}
+
+	waitUntil(deadline);
+	waitMilliseconds = milliseconds(Clock::now() - now);
+	deadline += period;
+}
+
+void FramePacer::InputSampled()
+{
+	lastInput = Clock::now();
+	hasInput = true;
+}
+
+void FramePacer::BeginFrame()
+{
+	frameInput = lastInput;
+	hasFrameInput = hasInput;
+}
+
+void FramePacer::Presented()
+{
+	Clock::time_point now = Clock::now();
+	if (hasPresent)
+		frameHistory[numFrames++ % HISTORY_SIZE] = milliseconds(now - lastPresent);
+	lastPresent = now;
+	hasPresent = true;
+
+	if (hasFrameInput)
+		latencyHistory[numLatencies++ % HISTORY_SIZE] = milliseconds(now - frameInput);
+}
+
+void FramePacer::TrackEvents(GLFWwindow* window)
+{
+	glfwSetCursorPosCallback(window, onCursorPos);
+	glfwSetCursorEnterCallback(window, onCursorEnter);
+	glfwSetMouseButtonCallback(window, onMouseButton);
+	glfwSetScrollCallback(window, onScroll);
+	glfwSetKeyCallback(window, onKey);
+	glfwSetCharCallback(window, onChar);
+	glfwSetWindowFocusCallback(window, onWindowFocus);
+	glfwSetWindowRefreshCallback(window, onWindowRefresh);
+}
+
+void FramePacer::RequestRedraw()
+{
+	redrawFrames = REDRAW_FRAMES;
+}
+
+bool FramePacer::WaitForRedraw()
+{
+	if (redrawFrames == 0)
+	{
+		glfwWaitEventsTimeout(IDLE_TIMEOUT);
+		// Time spent idle is no frame interval and no missed frame cap deadline
+		hasPresent = false;
+		hasDeadline = false;
+		if (redrawFrames == 0)
+			return false;
+	}
+	redrawFrames--;
+	return true;
+}
+
+float FramePacer::FrameMilliseconds()
+{
+	return average(frameHistory, numFrames);
+}
+
+float FramePacer::LatencyMilliseconds()
+{
+	return average(latencyHistory, numLatencies);
+}
+
+float FramePacer::MaxLatencyMilliseconds()
+{
+	int n = std::min(numLatencies, HISTORY_SIZE);
+	return n > 0 ? *std::max_element(latencyHistory, latencyHistory + n) : 0.0f;
+}
+
+float FramePacer::WaitMilliseconds()
+{
+	return waitMilliseconds;
+}
+
+bool FramePacer::AdaptiveSyncSupported()
+{
+	return adaptiveSync;
+}
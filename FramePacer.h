@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+// Paces the interactive render loop and measures how old the input is when a frame is
+// presented. A frame cap sleeps in short steps while the remaining time is longer than the
+// observed oversleep, then spins for the rest, so the deadline is met without burning a core.
+// Deadlines advance by one period per frame and restart after a missed one instead of
+// rendering a burst to catch up.
+//
+// The loop calls WaitForNextFrame before it samples input for a frame, InputSampled whenever
+// it reads input, BeginFrame once the frame uses its input and Presented after the swap.
+// Latency is measured in software, from the input sample a frame used until SwapBuffers (or,
+// in low latency mode, the GPU) is done with it.
+//
+// When rendering on demand the loop sleeps in glfwWaitEventsTimeout until window events, a
+// moving camera or a scene change call RequestRedraw. Every request renders REDRAW_FRAMES
+// more frames, so ImGui can finish reacting to the last input.
+class FramePacer
+{
+public:
+	static const int HISTORY_SIZE = 120;
+	static const int REDRAW_FRAMES = 4;
+
+	// Frames per second to cap at, 0 renders as fast as the swap interval allows
+	static int targetFps;
+	// 1 waits for vertical sync, 0 presents immediately, -1 tears only frames that missed it
+	static int swapInterval;
+	// Samples input right before the frame is built and waits for the GPU after each swap, so
+	// the CPU never queues frames ahead of the GPU
+	static bool lowLatency;
+	static bool renderOnDemand;
+
+	// Applies the swap interval to the current context, falls back to 1 if tearing late frames
+	// is not supported
+	static void Apply();
+	static void WaitForNextFrame();
+	static void InputSampled();
+	static void BeginFrame();
+	static void Presented();
+
+	// Asks for a redraw on every input and window event, call before ImGui installs its
+	// callbacks so they are chained
+	static void TrackEvents(GLFWwindow* window);
+	static void RequestRedraw();
+	// Returns true if a frame should be rendered, otherwise waits for events and returns false
+	// after they were handled or a timeout passed, so the caller can check background work
+	static bool WaitForRedraw();
+
+	// Averages over the last HISTORY_SIZE presented frames
+	static float FrameMilliseconds();
+	static float LatencyMilliseconds();
+	static float MaxLatencyMilliseconds();
+	// Time spent waiting for the frame cap in the last frame
+	static float WaitMilliseconds();
+	static bool AdaptiveSyncSupported();
+};
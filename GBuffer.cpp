@@ -0,0 +1,99 @@
+#include "GBuffer.h"
+
+GBuffer::GBuffer(int width, int height)
+{
+	GBuffer::width = width;
+	GBuffer::height = height;
+
+	glGenFramebuffers(1, &ID);
+	CreateAttachments();
+}
+
+void GBuffer::Resize(int width, int height)
+{
+	if (width == GBuffer::width && height == GBuffer::height)
+		return;
+
+	GBuffer::width = width;
+	GBuffer::height = height;
+
+	DeleteAttachments();
+	CreateAttachments();
+}
+
+void GBuffer::BindTextures(GLuint firstSlot)
+{
+	glActiveTexture(GL_TEXTURE0 + firstSlot);
+	glBindTexture(GL_TEXTURE_2D, albedoSpecular);
+	glActiveTexture(GL_TEXTURE0 + firstSlot + 1);
+	glBindTexture(GL_TEXTURE_2D, normal);
+	glActiveTexture(GL_TEXTURE0 + firstSlot + 2);
+	glBindTexture(GL_TEXTURE_2D, depth);
+}
+
+void GBuffer::BlitDepth(GLuint targetFramebuffer)
+{
+	// Copy the scene depth so forward passes and light volumes can depth test against it
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, ID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+}
+
+void GBuffer::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+}
+
+void GBuffer::Unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::Delete()
+{
+	DeleteAttachments();
+	glDeleteFramebuffers(1, &ID);
+}
+
+void GBuffer::CreateAttachments()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+
+	glGenTextures(1, &albedoSpecular);
+	glBindTexture(GL_TEXTURE_2D, albedoSpecular);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+
+	glGenTextures(1, &normal);
+	glBindTexture(GL_TEXTURE_2D, normal);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+
+	glGenTextures(1, &depth);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+
+	GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::FRAMEBUFFER::GBUFFER_NOT_COMPLETE" << std::endl;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::DeleteAttachments()
+{
+	glDeleteTextures(1, &albedoSpecular);
+	glDeleteTextures(1, &normal);
+	glDeleteTextures(1, &depth);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+class GBuffer
+{
+public:
+	GLuint ID = 0;
+	// rgb: albedo, a: specular intensity
+	GLuint albedoSpecular = 0;
+	// rgb: world space normal
+	GLuint normal = 0;
+	// depth and stencil, used to reconstruct the world position
+	GLuint depth = 0;
+
+	int width;
+	int height;
+
+	GBuffer(int width, int height);
+
+	void Resize(int width, int height);
+	void BindTextures(GLuint firstSlot);
+	void BlitDepth(GLuint targetFramebuffer);
+	void Bind();
+	void Unbind();
+	void Delete();
+
+private:
+	void CreateAttachments();
+	void DeleteAttachments();
+};
@@ -0,0 +1,670 @@
+#include "Gltf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "MappedFile.h"
+
+namespace
+{
+	const uint32_t GLB_MAGIC = 0x46546C67;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	// Tells the embedded images of documents loaded from the same path apart
+	std::atomic<unsigned int> documentSerial(0);
+
+	uint32_t readUint32(const unsigned char* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	size_t componentSize(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE: return 1;
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT: return 2;
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT: return 4;
+		default: return 0;
+		}
+	}
+
+	int componentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4" || type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		return 0;
+	}
+
+	bool decodeBase64(const char* text, size_t length, std::vector<unsigned char>& bytes)
+	{
+		bytes.clear();
+		bytes.reserve(length / 4 * 3);
+		uint32_t bits = 0;
+		int numBits = 0;
+		for (size_t i = 0; i < length && text[i] != '='; i++)
+		{
+			char c = text[i];
+			int value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 : c >= '0' && c <= '9' ? c - '0' + 52 :
+				c == '+' ? 62 : c == '/' ? 63 : -1;
+			if (value < 0)
+				return false;
+			bits = (bits << 6) | (uint32_t)value;
+			numBits += 6;
+			if (numBits >= 8)
+			{
+				numBits -= 8;
+				bytes.push_back((unsigned char)(bits >> numBits));
+			}
+		}
+		return true;
+	}
+
+	// Decodes "data:<type>;base64,<payload>" URIs, other URIs return false
+	bool decodeDataUri(const std::string& uri, std::vector<unsigned char>& bytes)
+	{
+		if (uri.compare(0, 5, "data:") != 0)
+			return false;
+		size_t comma = uri.find(";base64,");
+		if (comma == std::string::npos)
+			return false;
+		comma += 8;
+		return decodeBase64(uri.data() + comma, uri.size() - comma, bytes);
+	}
+
+	// Relative URIs may escape spaces and other characters as %XX
+	std::string decodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size())
+			{
+				decoded += (char)std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return decoded;
+	}
+}
+
+float GltfAccessor::Float(size_t element, int component) const
+{
+	const unsigned char* value = data + element * stride + component * componentSize(componentType);
+	switch (componentType)
+	{
+	case GL_FLOAT:
+	{
+		float f;
+		std::memcpy(&f, value, sizeof(f));
+		return f;
+	}
+	case GL_UNSIGNED_BYTE:
+		return normalized ? *value / 255.0f : (float)*value;
+	case GL_BYTE:
+		return normalized ? std::max(*(const int8_t*)value / 127.0f, -1.0f) : (float)*(const int8_t*)value;
+	case GL_UNSIGNED_SHORT:
+	{
+		uint16_t u;
+		std::memcpy(&u, value, sizeof(u));
+		return normalized ? u / 65535.0f : (float)u;
+	}
+	case GL_SHORT:
+	{
+		int16_t s;
+		std::memcpy(&s, value, sizeof(s));
+		return normalized ? std::max(s / 32767.0f, -1.0f) : (float)s;
+	}
+	case GL_UNSIGNED_INT:
+	{
+		uint32_t u;
+		std::memcpy(&u, value, sizeof(u));
+		return (float)u;
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+glm::vec3 GltfAccessor::Vec3(size_t element) const
+{
+	glm::vec3 value;
+	if (componentType == GL_FLOAT)
+		std::memcpy(&value, data + element * stride, sizeof(value));
+	else
+		value = glm::vec3(Float(element, 0), Float(element, 1), Float(element, 2));
+	return value;
+}
+
+glm::vec2 GltfAccessor::Vec2(size_t element) const
+{
+	glm::vec2 value;
+	if (componentType == GL_FLOAT)
+		std::memcpy(&value, data + element * stride, sizeof(value));
+	else
+		value = glm::vec2(Float(element, 0), Float(element, 1));
+	return value;
+}
+
+GLuint GltfAccessor::Index(size_t element) const
+{
+	const unsigned char* value = data + element * stride;
+	if (componentType == GL_UNSIGNED_BYTE)
+		return *value;
+	if (componentType == GL_UNSIGNED_SHORT)
+	{
+		uint16_t index;
+		std::memcpy(&index, value, sizeof(index));
+		return index;
+	}
+	uint32_t index;
+	std::memcpy(&index, value, sizeof(index));
+	return index;
+}
+
+bool GltfAccessor::Packed(GLenum type, int numComponents) const
+{
+	return componentType == type && components == numComponents && stride == componentSize(type) * numComponents;
+}
+
+bool GltfDocument::Load(const std::string& path)
+{
+	GltfDocument::path = path;
+	size_t slash = path.find_last_of('/');
+	directory = slash == std::string::npos ? "." : path.substr(0, slash);
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(path))
+	{
+		std::cout << "ERROR::GLTF::FILE_NOT_READ: " << path << std::endl;
+		return false;
+	}
+
+	// A .glb is a header and chunks, the JSON first and optionally a binary buffer after it
+	const char* text = (const char*)file->Data();
+	size_t textLength = file->Size();
+	Buffer binaryChunk;
+	if (file->Size() >= 12 && readUint32(file->Data()) == GLB_MAGIC)
+	{
+		const unsigned char* data = file->Data();
+		size_t length = std::min((size_t)readUint32(data + 8), file->Size());
+		size_t offset = 12;
+		bool hasJson = false;
+		while (offset + 8 <= length)
+		{
+			size_t chunkLength = readUint32(data + offset);
+			uint32_t chunkType = readUint32(data + offset + 4);
+			offset += 8;
+			if (chunkLength > length - offset)
+				break;
+			if (chunkType == GLB_CHUNK_JSON && !hasJson)
+			{
+				text = (const char*)data + offset;
+				textLength = chunkLength;
+				hasJson = true;
+			}
+			else if (chunkType == GLB_CHUNK_BIN && !binaryChunk.data)
+			{
+				binaryChunk = Buffer{ file, data + offset, chunkLength };
+			}
+			offset += chunkLength;
+		}
+		if (readUint32(data + 4) != 2 || !hasJson)
+		{
+			std::cout << "ERROR::GLTF::INVALID_GLB: " << path << std::endl;
+			return false;
+		}
+	}
+
+	std::string error;
+	if (!JsonValue::Parse(text, textLength, json, error))
+	{
+		std::cout << "ERROR::GLTF::JSON: " << path << ": " << error << std::endl;
+		return false;
+	}
+	if (json["asset"]["version"].AsString().compare(0, 2, "2.") != 0)
+	{
+		std::cout << "glTF loader only reads glTF 2.0, " << path << " is version " << json["asset"]["version"].AsString() << std::endl;
+		return false;
+	}
+	const JsonValue& required = json["extensionsRequired"];
+	if (required.Size() > 0)
+	{
+		std::cout << "glTF loader has no " << required[(size_t)0].AsString() << " extension required by " << path << std::endl;
+		return false;
+	}
+
+	const JsonValue& bufferList = json["buffers"];
+	buffers.resize(bufferList.Size());
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		if (!LoadBuffer(bufferList[i], binaryChunk, buffers[i]))
+		{
+			std::cout << "ERROR::GLTF::BUFFER_NOT_READ: " << i << " of " << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool GltfDocument::LoadBuffer(const JsonValue& buffer, const Buffer& binaryChunk, Buffer& loaded) const
+{
+	size_t byteLength = (size_t)buffer["byteLength"].AsNumber();
+	if (!buffer.Has("uri"))
+	{
+		// Only the first buffer of a .glb may leave out the URI and live in the binary chunk
+		loaded = binaryChunk;
+	}
+	else
+	{
+		const std::string& uri = buffer["uri"].AsString();
+		std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>();
+		if (decodeDataUri(uri, *bytes))
+		{
+			loaded = Buffer{ bytes, bytes->data(), bytes->size() };
+		}
+		else
+		{
+			std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+			if (!file->Open(directory + "/" + decodeUri(uri)))
+				return false;
+			loaded = Buffer{ file, file->Data(), file->Size() };
+		}
+	}
+	return loaded.data && loaded.size >= byteLength;
+}
+
+bool GltfDocument::BufferView(int index, const unsigned char*& data, size_t& size, size_t& stride) const
+{
+	const JsonValue& view = json["bufferViews"][(size_t)index];
+	int buffer = view["buffer"].AsInt(-1);
+	if (view.IsNull() || buffer < 0 || (size_t)buffer >= buffers.size())
+		return false;
+	size_t offset = (size_t)view["byteOffset"].AsNumber();
+	size = (size_t)view["byteLength"].AsNumber();
+	stride = (size_t)view["byteStride"].AsNumber();
+	if (offset > buffers[buffer].size || size > buffers[buffer].size - offset)
+		return false;
+	data = buffers[buffer].data + offset;
+	return true;
+}
+
+bool GltfDocument::Accessor(int index, GltfAccessor& accessor) const
+{
+	const JsonValue& description = json["accessors"][(size_t)index];
+	// Accessors without a buffer view are all zeros and sparse ones patch their view, neither
+	// can point into a buffer
+	if (index < 0 || description.IsNull() || !description.Has("bufferView") || description.Has("sparse"))
+		return false;
+
+	const unsigned char* viewData;
+	size_t viewSize, viewStride;
+	if (!BufferView(description["bufferView"].AsInt(), viewData, viewSize, viewStride))
+		return false;
+
+	accessor.componentType = (GLenum)description["componentType"].AsInt();
+	accessor.components = componentCount(description["type"].AsString());
+	accessor.normalized = description["normalized"].AsBool();
+	accessor.count = (size_t)description["count"].AsNumber();
+	size_t elementSize = componentSize(accessor.componentType) * accessor.components;
+	accessor.stride = viewStride ? viewStride : elementSize;
+	size_t offset = (size_t)description["byteOffset"].AsNumber();
+	if (elementSize == 0 || offset > viewSize)
+		return false;
+	if (accessor.count > 0 && (viewSize - offset < elementSize || (viewSize - offset - elementSize) / accessor.stride < accessor.count - 1))
+		return false;
+	accessor.data = viewData + offset;
+
+	const JsonValue& min = description["min"];
+	const JsonValue& max = description["max"];
+	accessor.hasBounds = min.Size() >= 3 && max.Size() >= 3;
+	if (accessor.hasBounds)
+	{
+		accessor.min = glm::vec3(min[(size_t)0].AsNumber(), min[(size_t)1].AsNumber(), min[(size_t)2].AsNumber());
+		accessor.max = glm::vec3(max[(size_t)0].AsNumber(), max[(size_t)1].AsNumber(), max[(size_t)2].AsNumber());
+	}
+	return true;
+}
+
+std::vector<std::string> GltfDocument::ImagePaths(std::vector<EmbeddedImage>& embedded) const
+{
+	std::string prefix = path + "#" + std::to_string(documentSerial++) + "/image";
+	const JsonValue& images = json["images"];
+	std::vector<std::string> paths(images.Size());
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		const JsonValue& image = images[i];
+		const std::string& uri = image["uri"].AsString();
+		if (image.Has("bufferView"))
+		{
+			// Decoded straight from the buffer, the registration keeps it alive
+			const unsigned char* data;
+			size_t size, stride;
+			if (!BufferView(image["bufferView"].AsInt(), data, size, stride))
+				continue;
+			int buffer = json["bufferViews"][(size_t)image["bufferView"].AsInt()]["buffer"].AsInt();
+			paths[i] = prefix + std::to_string(i);
+			embedded.emplace_back(paths[i], buffers[buffer].owner, data, size);
+		}
+		else if (uri.compare(0, 5, "data:") == 0)
+		{
+			std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>();
+			if (!decodeDataUri(uri, *bytes))
+				continue;
+			paths[i] = prefix + std::to_string(i);
+			embedded.emplace_back(paths[i], bytes, bytes->data(), bytes->size());
+		}
+		else if (!uri.empty())
+		{
+			paths[i] = directory + "/" + decodeUri(uri);
+		}
+	}
+	return paths;
+}
+
+glm::mat4 GltfDocument::NodeMatrix(const JsonValue& node)
+{
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.Size() == 16)
+	{
+		// Column major like glm
+		glm::mat4 result;
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				result[column][row] = (float)matrix[(size_t)(column * 4 + row)].AsNumber();
+		return result;
+	}
+
+	const JsonValue& t = node["translation"];
+	const JsonValue& r = node["rotation"];
+	const JsonValue& s = node["scale"];
+	glm::vec3 translation(t[(size_t)0].AsNumber(), t[(size_t)1].AsNumber(), t[(size_t)2].AsNumber());
+	// Stored as x, y, z, w
+	glm::quat rotation((float)r[(size_t)3].AsNumber(1.0), (float)r[(size_t)0].AsNumber(), (float)r[(size_t)1].AsNumber(), (float)r[(size_t)2].AsNumber());
+	glm::vec3 scale(s[(size_t)0].AsNumber(1.0), s[(size_t)1].AsNumber(1.0), s[(size_t)2].AsNumber(1.0));
+	glm::mat4 result = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation);
+	return glm::scale(result, scale);
+}
+
+bool GltfDocument::LoadSkeleton(Skeleton& skeleton, std::vector<int>& skinPalettes, std::vector<int>& nodeJoints) const
+{
+	const JsonValue& nodes = json["nodes"];
+	const JsonValue& skins = json["skins"];
+	std::vector<int> parents(nodes.Size(), -1);
+	for (size_t i = 0; i < nodes.Size(); i++)
+	{
+		const JsonValue& children = nodes[i]["children"];
+		for (size_t j = 0; j < children.Size(); j++)
+		{
+			int child = children[j].AsInt(-1);
+			if (child >= 0 && (size_t)child < parents.size() && parents[child] < 0 && (size_t)child != i)
+				parents[child] = (int)i;
+		}
+	}
+
+	// Joints and everything above them, the hierarchy between them is animated too
+	std::vector<bool> needed(nodes.Size(), false);
+	for (size_t i = 0; i < skins.Size(); i++)
+	{
+		const JsonValue& joints = skins[i]["joints"];
+		for (size_t j = 0; j < joints.Size(); j++)
+		{
+			// Walking up stops at nodes already marked, which also ends loops
+			for (int node = joints[j].AsInt(-1); node >= 0 && (size_t)node < needed.size() && !needed[node]; node = parents[node])
+				needed[node] = true;
+		}
+	}
+
+	// Parents first by adding every chain from its root down, roots can't be part of a loop
+	nodeJoints.assign(nodes.Size(), -1);
+	std::vector<int> stack;
+	for (size_t root = 0; root < nodes.Size(); root++)
+	{
+		if (!needed[root] || parents[root] >= 0)
+			continue;
+		stack.push_back((int)root);
+		while (!stack.empty())
+		{
+			int node = stack.back();
+			stack.pop_back();
+			const JsonValue& description = nodes[(size_t)node];
+			int parent = parents[node] >= 0 ? nodeJoints[parents[node]] : -1;
+			nodeJoints[node] = skeleton.AddJoint(description["name"].AsString(), parent, decomposePose(NodeMatrix(description)));
+			const JsonValue& children = description["children"];
+			for (size_t j = 0; j < children.Size(); j++)
+			{
+				int child = children[j].AsInt(-1);
+				if (child >= 0 && (size_t)child < needed.size() && needed[child] && parents[child] == node && nodeJoints[child] < 0)
+					stack.push_back(child);
+			}
+		}
+	}
+
+	skinPalettes.assign(skins.Size(), 0);
+	for (size_t i = 0; i < skins.Size(); i++)
+	{
+		const JsonValue& joints = skins[i]["joints"];
+		GltfAccessor inverseBinds;
+		bool hasInverseBinds = skins[i].Has("inverseBindMatrices");
+		if (hasInverseBinds && (!Accessor(skins[i]["inverseBindMatrices"].AsInt(), inverseBinds) || inverseBinds.components != 16
+			|| inverseBinds.componentType != GL_FLOAT || inverseBinds.count < joints.Size()))
+		{
+			std::cout << "glTF loader can't read the inverse bind matrices of skin " << i << std::endl;
+			return false;
+		}
+		skinPalettes[i] = (int)skeleton.PaletteSize();
+		for (size_t j = 0; j < joints.Size(); j++)
+		{
+			int node = joints[j].AsInt(-1);
+			if (node < 0 || (size_t)node >= nodeJoints.size() || nodeJoints[node] < 0)
+			{
+				std::cout << "glTF loader found joint " << j << " of skin " << i << " in a loop of nodes" << std::endl;
+				return false;
+			}
+			glm::mat4 inverseBind(1.0f);
+			if (hasInverseBinds)
+				std::memcpy(&inverseBind[0][0], inverseBinds.data + j * inverseBinds.stride, sizeof(inverseBind));
+			skeleton.AddPaletteEntry(nodeJoints[node], inverseBind);
+		}
+	}
+	return true;
+}
+
+void GltfDocument::LoadAnimations(const std::vector<int>& nodeJoints, std::vector<AnimationClip>& clips) const
+{
+	const JsonValue& animations = json["animations"];
+	for (size_t i = 0; i < animations.Size(); i++)
+	{
+		const JsonValue& animation = animations[i];
+		AnimationClip clip;
+		clip.name = animation["name"].AsString().empty() ? "Animation " + std::to_string(i) : animation["name"].AsString();
+		const JsonValue& channels = animation["channels"];
+		for (size_t j = 0; j < channels.Size(); j++)
+		{
+			const JsonValue& target = channels[j]["target"];
+			const JsonValue& sampler = animation["samplers"][(size_t)channels[j]["sampler"].AsInt(-1)];
+			int node = target["node"].AsInt(-1);
+			const std::string& path = target["path"].AsString();
+			if (node < 0 || (size_t)node >= nodeJoints.size() || nodeJoints[node] < 0 || sampler.IsNull())
+				continue;
+
+			AnimationChannel channel;
+			channel.joint = nodeJoints[node];
+			int components = 3;
+			if (path == "translation")
+				channel.path = ANIMATION_TRANSLATION;
+			else if (path == "scale")
+				channel.path = ANIMATION_SCALE;
+			else if (path == "rotation")
+			{
+				channel.path = ANIMATION_ROTATION;
+				components = 4;
+			}
+			else
+			{
+				continue;
+			}
+			const std::string& interpolation = sampler["interpolation"].AsString();
+			channel.step = interpolation == "STEP";
+			// In-tangent, value and out-tangent per key
+			size_t valuesPerKey = interpolation == "CUBICSPLINE" ? 3 : 1;
+
+			GltfAccessor input, output;
+			if (!Accessor(sampler["input"].AsInt(-1), input) || input.components != 1 || input.componentType != GL_FLOAT
+				|| !Accessor(sampler["output"].AsInt(-1), output) || output.components != components || output.count < input.count * valuesPerKey)
+			{
+				std::cout << "glTF loader can't read channel " << j << " of animation " << i << std::endl;
+				continue;
+			}
+			channel.times.resize(input.count);
+			channel.values.resize(input.count, channel.path == ANIMATION_SCALE ? glm::vec4(1.0f, 1.0f, 1.0f, 0.0f) : glm::vec4(0.0f));
+			for (size_t k = 0; k < input.count; k++)
+			{
+				channel.times[k] = input.Float(k, 0);
+				size_t element = k * valuesPerKey + valuesPerKey / 2;
+				for (int c = 0; c < components; c++)
+					channel.values[k][c] = output.Float(element, c);
+			}
+			// Keys have to ascend for the binary search
+			if (!std::is_sorted(channel.times.begin(), channel.times.end()))
+				continue;
+			if (!channel.times.empty())
+				clip.duration = std::max(clip.duration, channel.times.back());
+			clip.channels.push_back(std::move(channel));
+		}
+		if (!clip.channels.empty())
+			clips.push_back(std::move(clip));
+	}
+}
+
+size_t GltfPrimitive::NumVertices() const
+{
+	return positions.count;
+}
+
+size_t GltfPrimitive::NumIndices() const
+{
+	return hasIndices ? indices.count : positions.count;
+}
+
+void GltfPrimitive::WriteVertices(Vertex* out) const
+{
+	for (size_t i = 0; i < positions.count; i++)
+	{
+		Vertex vertex;
+		vertex.position = positions.Vec3(i);
+		vertex.normal = normals.Vec3(i);
+		vertex.texureUV = glm::vec2(0.0f);
+		if (uvs.count > 0)
+		{
+			vertex.texureUV = uvs.Vec2(i);
+			if (flipV)
+				vertex.texureUV.y = 1.0f - vertex.texureUV.y;
+		}
+		out[i] = vertex;
+	}
+}
+
+void GltfPrimitive::WritePositions(glm::vec3* out) const
+{
+	for (size_t i = 0; i < positions.count; i++)
+		out[i] = positions.Vec3(i);
+}
+
+void GltfPrimitive::WriteIndices(GLuint* out) const
+{
+	if (!hasIndices)
+	{
+		for (size_t i = 0; i < positions.count; i++)
+			out[i] = (GLuint)i;
+	}
+	else if (indices.Packed(GL_UNSIGNED_SHORT, 1))
+	{
+		const unsigned char* data = indices.data;
+		for (size_t i = 0; i < indices.count; i++)
+		{
+			uint16_t index;
+			std::memcpy(&index, data + i * 2, sizeof(index));
+			out[i] = index;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < indices.count; i++)
+			out[i] = indices.Index(i);
+	}
+}
+
+float GltfPrimitive::TextureCoordinateDensity() const
+{
+	if (uvs.count == 0)
+		return 0.0f;
+
+	// Flipping v mirrors the UV triangles, which leaves their areas alone
+	TriangleAreas areas;
+	size_t numIndices = NumIndices();
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		size_t a = hasIndices ? indices.Index(i) : i;
+		size_t b = hasIndices ? indices.Index(i + 1) : i + 1;
+		size_t c = hasIndices ? indices.Index(i + 2) : i + 2;
+		if (a >= positions.count || b >= positions.count || c >= positions.count)
+			continue;
+		areas.Add(positions.Vec3(a), positions.Vec3(b), positions.Vec3(c), uvs.Vec2(a), uvs.Vec2(b), uvs.Vec2(c));
+	}
+	return areas.Density();
+}
+
+const void* GltfPrimitive::PackedVertices() const
+{
+	// Interleaved exactly like Vertex, as some exporters write it
+	bool interleaved = positions.componentType == GL_FLOAT && normals.componentType == GL_FLOAT && uvs.componentType == GL_FLOAT
+		&& positions.stride == sizeof(Vertex) && normals.stride == sizeof(Vertex) && uvs.stride == sizeof(Vertex)
+		&& normals.data == positions.data + offsetof(Vertex, normal) && uvs.data == positions.data + offsetof(Vertex, texureUV)
+		&& uvs.components == 2 && !flipV;
+	return interleaved ? positions.data : nullptr;
+}
+
+const void* GltfPrimitive::PackedIndices() const
+{
+	return hasIndices && indices.Packed(GL_UNSIGNED_INT, 1) ? indices.data : nullptr;
+}
+
+void GltfPrimitive::WriteSkins(VertexSkin* out) const
+{
+	for (size_t i = 0; i < positions.count; i++)
+	{
+		JointInfluences influences;
+		if (i < joints.count && i < weights.count)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				int joint = (int)joints.Float(i, j);
+				if (joint < paletteSize)
+					influences.Add(paletteOffset + joint, weights.Float(i, j));
+			}
+		}
+		out[i] = influences.Pack();
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "ImageSource.h"
+#include "Json.h"
+#include "MeshProcessing.h"
+
+// Elements of a glTF accessor, pointing into a loaded buffer
+struct GltfAccessor
+{
+	const unsigned char* data = nullptr;
+	size_t count = 0;
+	// Bytes from one element to the next
+	size_t stride = 0;
+	// GL_FLOAT, GL_UNSIGNED_SHORT, ... as in the file
+	GLenum componentType = 0;
+	int components = 0;
+	bool normalized = false;
+	// From the accessor's min and max, which glTF requires for positions
+	bool hasBounds = false;
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	// Component of an element, normalized integers are scaled to 0..1 or -1..1
+	float Float(size_t element, int component) const;
+	glm::vec3 Vec3(size_t element) const;
+	glm::vec2 Vec2(size_t element) const;
+	GLuint Index(size_t element) const;
+	// True if the elements are tightly packed arrays of the given type
+	bool Packed(GLenum type, int numComponents) const;
+};
+
+// A glTF 2.0 asset read without Assimp, a .gltf with its buffers or a .glb. Files are memory
+// mapped and accessors point straight into them, only data URIs are decoded into memory.
+class GltfDocument
+{
+public:
+	JsonValue json;
+
+	// Prints why and returns false for files that can't be read or use features this loader
+	// doesn't have, like compressed geometry, so the caller can fall back to Assimp
+	bool Load(const std::string& path);
+	bool Accessor(int index, GltfAccessor& accessor) const;
+	// Path of every image for the texture loaders. Images inside buffers or data URIs are
+	// registered as embedded images, which must live as long as the textures.
+	std::vector<std::string> ImagePaths(std::vector<EmbeddedImage>& embedded) const;
+	// Local transformation of a node from its matrix or translation, rotation and scale
+	static glm::mat4 NodeMatrix(const JsonValue& node);
+	// The joints of all skins and their ancestors in the node tree. skinPalettes receives the
+	// first palette entry of every skin, nodeJoints the joint of every node or -1.
+	bool LoadSkeleton(Skeleton& skeleton, std::vector<int>& skinPalettes, std::vector<int>& nodeJoints) const;
+	// Channels moving nodes of the skeleton, the others and morph weights are left out.
+	// Cubic spline keys are played linearly between their values.
+	void LoadAnimations(const std::vector<int>& nodeJoints, std::vector<AnimationClip>& clips) const;
+
+private:
+	struct Buffer
+	{
+		std::shared_ptr<const void> owner;
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	std::string path;
+	std::string directory;
+	std::vector<Buffer> buffers;
+
+	bool LoadBuffer(const JsonValue& buffer, const Buffer& binaryChunk, Buffer& loaded) const;
+	bool BufferView(int index, const unsigned char*& data, size_t& size, size_t& stride) const;
+};
+
+// Triangles of a glTF mesh primitive with positions and normals, as a MeshSource
+class GltfPrimitive : public MeshSource
+{
+public:
+	GltfAccessor positions;
+	GltfAccessor normals;
+	// Empty if the primitive has no texture coordinates or no indices
+	GltfAccessor uvs;
+	GltfAccessor indices;
+	bool hasIndices = false;
+	// Stores 1 - v, glTF puts the UV origin at the top left
+	bool flipV = false;
+	// The first set of joints and weights, empty for meshes without a skin
+	GltfAccessor joints;
+	GltfAccessor weights;
+	// Palette entries of the skin of the node drawing the primitive, none while paletteSize is 0
+	int paletteOffset = 0;
+	int paletteSize = 0;
+
+	size_t NumVertices() const override;
+	size_t NumIndices() const override;
+	void WriteVertices(Vertex* out) const override;
+	void WritePositions(glm::vec3* out) const override;
+	void WriteIndices(GLuint* out) const override;
+	float TextureCoordinateDensity() const override;
+	const void* PackedVertices() const override;
+	const void* PackedIndices() const override;
+	bool HasSkins() const override { return paletteSize > 0 && joints.count > 0; }
+	void WriteSkins(VertexSkin* out) const override;
+};
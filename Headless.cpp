@@ -0,0 +1,304 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <glm/gtc/constants.hpp>
+
+#include "Mesh.h"
+
+#if defined(__linux__)
+#define HEADLESS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+static void PrintUsage()
+{
+	std::cout << "Usage: LearnOpenGL [--headless] [options]\n"
+		<< "  --headless          render offscreen without a window and exit after the run\n"
+		<< "  --model <path>      model to load\n"
+		<< "  --frames <n>        number of frames to measure (300, or the suite's with --benchmark)\n"
+		<< "  --warmup <n>        frames to render before measuring (0, or the suite's with --benchmark)\n"
+		<< "  --width <n>         framebuffer width (1600)\n"
+		<< "  --height <n>        framebuffer height (900)\n"
+		<< "  --shading <mode>    default, depth or deferred\n"
+		<< "  --no-lighting       disable lighting in the default shading\n"
+		<< "  --clustered         clustered forward lighting\n"
+		<< "  --shadows           cascaded shadow maps\n"
+		<< "  --lights <n>        number of point lights (256)\n"
+		<< "  --imgui             build and draw the Options window as well\n"
+		<< "  --output <path>     write the last frame as a PPM image\n"
+		<< "  --trace <path>      write the profiled frames as a Chrome trace\n"
+		<< "  --camera-path <f>   replay a recorded camera path instead of orbiting\n"
+		<< "  --record-camera <f> record the camera of an interactive session on exit\n"
+		<< "  --benchmark <names> run benchmark scenarios, comma separated, all or list\n"
+		<< "  --json <path>       write the results of every scenario as JSON\n"
+		<< "  --baseline <path>   compare against an earlier --json file\n"
+		<< "  --threshold <pct>   allowed slowdown against the baseline in percent (10)\n"
+		<< "  --memory-budget <MB> warn when GPU memory exceeds this budget (off)\n"
+		<< "  --texture-budget <MB> memory streamed texture levels may use (unlimited)\n"
+		<< "  --no-texture-streaming load every texture level before the first frame\n"
+		<< "  --no-persistent-mapping map the per-draw data for every write as on GL 3.3\n"
+		<< "  --geometry <policy> CPU copies of model geometry: keep, compact, discard or on-demand\n"
+		<< "  --geometry-report   print the CPU geometry of the bundled models per policy\n"
+		<< "  --no-native-loaders load .gltf, .glb, .pmx and .obj files with Assimp\n"
+		<< "  --load-report       print load time and peak heap of the bundled models per loader\n"
+		<< "  --fps <n>           cap interactive sessions at this frame rate (off)\n"
+		<< "  --swap-interval <n> 1 vsync, 0 off, -1 adaptive vsync (1)\n"
+		<< "  --low-latency       sample input right before rendering and wait for the GPU\n"
+		<< "  --render-on-demand  only render after input or scene changes" << std::endl;
+}
+
+bool HeadlessOptions::Parse(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		try
+		{
+			if (argument == "--headless")
+				enabled = true;
+			else if (argument == "--model" && hasValue)
+				modelPath = argv[++i];
+			else if (argument == "--frames" && hasValue)
+				frames = std::max(1, std::stoi(argv[++i]));
+			else if (argument == "--warmup" && hasValue)
+				warmupFrames = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--width" && hasValue)
+				width = std::max(1, std::stoi(argv[++i]));
+			else if (argument == "--height" && hasValue)
+				height = std::max(1, std::stoi(argv[++i]));
+			else if (argument == "--shading" && hasValue)
+				shading = argv[++i];
+			else if (argument == "--no-lighting")
+				lighting = false;
+			else if (argument == "--clustered")
+				clusteredLighting = true;
+			else if (argument == "--shadows")
+				shadows = true;
+			else if (argument == "--lights" && hasValue)
+				pointLights = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--imgui")
+				imgui = true;
+			else if (argument == "--output" && hasValue)
+				outputPath = argv[++i];
+			else if (argument == "--trace" && hasValue)
+				tracePath = argv[++i];
+			else if (argument == "--camera-path" && hasValue)
+				cameraPath = argv[++i];
+			else if (argument == "--record-camera" && hasValue)
+				recordCameraPath = argv[++i];
+			else if (argument == "--benchmark" && hasValue)
+			{
+				benchmark = argv[++i];
+				enabled = true;
+			}
+			else if (argument == "--json" && hasValue)
+				jsonPath = argv[++i];
+			else if (argument == "--baseline" && hasValue)
+				baselinePath = argv[++i];
+			else if (argument == "--threshold" && hasValue)
+				regressionThreshold = std::max(0.0f, std::stof(argv[++i]) / 100.0f);
+			else if (argument == "--memory-budget" && hasValue)
+				memoryBudget = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--texture-budget" && hasValue)
+				textureBudget = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--no-texture-streaming")
+				textureStreaming = false;
+			else if (argument == "--no-persistent-mapping")
+				persistentMapping = false;
+			else if (argument == "--geometry" && hasValue)
+				geometry = argv[++i];
+			else if (argument == "--geometry-report")
+			{
+				geometryReport = true;
+				enabled = true;
+			}
+			else if (argument == "--no-native-loaders")
+				nativeLoaders = false;
+			else if (argument == "--load-report")
+			{
+				loadReport = true;
+				enabled = true;
+			}
+			else if (argument == "--fps" && hasValue)
+				targetFps = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--swap-interval" && hasValue)
+				swapInterval = std::max(-1, std::min(std::stoi(argv[++i]), 1));
+			else if (argument == "--low-latency")
+				lowLatency = true;
+			else if (argument == "--render-on-demand")
+				renderOnDemand = true;
+			else
+			{
+				std::cout << "Unknown argument: " << argument << std::endl;
+				PrintUsage();
+				return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cout << "Invalid value for " << argument << std::endl;
+			PrintUsage();
+			return false;
+		}
+	}
+
+	if (shading != "default" && shading != "depth" && shading != "deferred")
+	{
+		std::cout << "Unknown shading mode: " << shading << std::endl;
+		PrintUsage();
+		return false;
+	}
+	geometryResidency residency;
+	if (!parseGeometryResidency(geometry, residency))
+	{
+		std::cout << "Unknown geometry policy: " << geometry << std::endl;
+		PrintUsage();
+		return false;
+	}
+	return true;
+}
+
+
+
+bool HeadlessContext::Create()
+{
+#ifdef HEADLESS_EGL
+	// The surfaceless platform needs neither a window system nor a GPU device node
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cout << "Failed to initialize EGL" << std::endl;
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL has no desktop OpenGL support" << std::endl;
+		eglTerminate(eglDisplay);
+		return false;
+	}
+
+	const EGLint contextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	// Rendering only goes to framebuffer objects, so no config or surface is needed
+	EGLContext eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "Failed to create a surfaceless OpenGL 3.3 core context" << std::endl;
+		eglTerminate(eglDisplay);
+		return false;
+	}
+
+	display = eglDisplay;
+	context = eglContext;
+	return true;
+#else
+	std::cout << "Headless mode needs EGL, which is not available on this platform" << std::endl;
+	return false;
+#endif
+}
+
+void HeadlessContext::Destroy()
+{
+#ifdef HEADLESS_EGL
+	if (!display)
+		return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	display = nullptr;
+	context = nullptr;
+#endif
+}
+
+void* HeadlessContext::GetProcAddress(const char* name)
+{
+#ifdef HEADLESS_EGL
+	return (void*)eglGetProcAddress(name);
+#else
+	return nullptr;
+#endif
+}
+
+
+
+void OffscreenTarget::Create(int width, int height)
+{
+	OffscreenTarget::width = width;
+	OffscreenTarget::height = height;
+
+	glGenFramebuffers(1, &ID);
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+	glGenRenderbuffers(1, &depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::FRAMEBUFFER:: Offscreen target is not complete!" << std::endl;
+}
+
+void OffscreenTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, ID);
+	glViewport(0, 0, width, height);
+}
+
+bool OffscreenTarget::SavePPM(const std::string& path)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, ID);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	std::ofstream outFile(path, std::ios::binary);
+	if (!outFile)
+		return false;
+	outFile << "P6\n" << width << " " << height << "\n255\n";
+	// OpenGL rows start at the bottom, PPM rows at the top
+	for (int row = height - 1; row >= 0; row--)
+		outFile.write((const char*)&pixels[(size_t)row * width * 3], (std::streamsize)width * 3);
+	return (bool)outFile;
+}
+
+void OffscreenTarget::Delete()
+{
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depthStencil);
+	glDeleteFramebuffers(1, &ID);
+	ID = 0;
+}
+
+
+
+void scriptedCameraPath(Camera& camera, float progress, float radius, float height)
+{
+	// One full orbit slightly above the model, always looking at its center
+	float angle = glm::two_pi<float>() * progress;
+	camera.Position = glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+	camera.Orientation = glm::normalize(-camera.Position);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+
+// Command line options of a headless run, for example
+//   LearnOpenGL --headless --model Resources/sponza.glb --frames 600 --width 1920 --height 1080
+//   LearnOpenGL --benchmark all --json results.json --baseline baseline.json --threshold 5
+struct HeadlessOptions
+{
+	bool enabled = false;
+	std::string modelPath;
+	// Measured frames, -1 unless given: 300 for a plain headless run, the suite's own for benchmarks
+	int frames = -1;
+	// Rendered before the measured frames and left out of the timings, -1 unless given: none for
+	// a plain headless run, the suite's own for benchmarks
+	int warmupFrames = -1;
+	int width = 1600;
+	int height = 900;
+	// default, depth or deferred
+	std::string shading = "default";
+	bool lighting = true;
+	bool clusteredLighting = false;
+	bool shadows = false;
+	int pointLights = 256;
+	// Builds and draws the Options window as well, so its cost is part of the timings
+	bool imgui = false;
+	// Writes the last frame as a binary PPM image
+	std::string outputPath;
+	// Writes the profiled frames as Chrome trace events
+	std::string tracePath;
+
+	// Comma separated benchmark scenario names or all, implies a headless run
+	std::string benchmark;
+	// Replays a recorded camera path instead of orbiting the model
+	std::string cameraPath;
+	// Records the camera of an interactive session into this file on exit
+	std::string recordCameraPath;
+	// Results of every scenario as JSON, optionally checked against an earlier results file
+	std::string jsonPath;
+	std::string baselinePath;
+	// Allowed slowdown against the baseline as a fraction
+	float regressionThreshold = 0.1f;
+	// Warns when GPU memory goes over this many megabytes, 0 disables the budget
+	int memoryBudget = 0;
+	// Loads texture levels on demand within a budget in megabytes, 0 for no budget
+	bool textureStreaming = true;
+	int textureBudget = 0;
+	// Streams per-draw data through a persistently mapped buffer when the driver supports it
+	bool persistentMapping = true;
+	// What loaded models keep of their geometry in RAM: keep, compact, discard or on-demand
+	std::string geometry = "discard";
+	// Prints the CPU geometry of the bundled models under every policy and exits
+	bool geometryReport = false;
+	// Loads .gltf, .glb, .pmx and .obj files with Assimp only
+	bool nativeLoaders = true;
+	// Prints how long the bundled glTF, PMX and OBJ models take to load with each loader and
+	// how much heap it needs at most, then exits
+	bool loadReport = false;
+	// Pacing of interactive sessions, see FramePacer
+	int targetFps = 0;
+	int swapInterval = 1;
+	bool lowLatency = false;
+	bool renderOnDemand = false;
+
+	// Returns false and prints the usage on unknown or malformed arguments
+	bool Parse(int argc, char* argv[]);
+};
+
+// OpenGL 3.3 core context without any window or display. It is created on EGL's surfaceless
+// platform, so Mesa's llvmpipe can render on machines without a GPU or an X server.
+class HeadlessContext
+{
+public:
+	bool Create();
+	void Destroy();
+	static void* GetProcAddress(const char* name);
+
+private:
+	void* display = nullptr;
+	void* context = nullptr;
+};
+
+// Color and depth-stencil renderbuffers standing in for the window's default framebuffer
+class OffscreenTarget
+{
+public:
+	GLuint ID = 0;
+	int width = 0;
+	int height = 0;
+
+	void Create(int width, int height);
+	void Bind();
+	bool SavePPM(const std::string& path);
+	void Delete();
+
+private:
+	GLuint color = 0;
+	GLuint depthStencil = 0;
+};
+
+// Places the camera on a fixed orbit around the origin, progress runs from 0 to 1 over the run
+void scriptedCameraPath(Camera& camera, float progress, float radius = 3.0f, float height = 1.0f);
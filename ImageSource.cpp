@@ -0,0 +1,77 @@
+#include "ImageSource.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <stb/stb_image.h>
+
+namespace
+{
+	struct Bytes
+	{
+		std::shared_ptr<const void> owner;
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Bytes> images;
+
+	// Copies the entry, so the bytes stay alive while decoding outside the lock
+	bool findImage(const std::string& path, Bytes& bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = images.find(path);
+		if (found == images.end())
+			return false;
+		bytes = found->second;
+		return true;
+	}
+}
+
+EmbeddedImage::EmbeddedImage(const std::string& path, std::shared_ptr<const void> owner, const unsigned char* data, size_t size) :
+	path(path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	images[path] = Bytes{ std::move(owner), data, size };
+}
+
+EmbeddedImage::EmbeddedImage(EmbeddedImage&& other) noexcept : path(std::move(other.path))
+{
+	other.path.clear();
+}
+
+EmbeddedImage& EmbeddedImage::operator=(EmbeddedImage&& other) noexcept
+{
+	if (this != &other)
+	{
+		Unregister();
+		path = std::move(other.path);
+		other.path.clear();
+	}
+	return *this;
+}
+
+void EmbeddedImage::Unregister()
+{
+	if (path.empty())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	images.erase(path);
+	path.clear();
+}
+
+bool imageInfo(const std::string& path, int* width, int* height, int* channels)
+{
+	Bytes bytes;
+	if (findImage(path, bytes))
+		return stbi_info_from_memory(bytes.data, (int)bytes.size, width, height, channels) != 0;
+	return stbi_info(path.c_str(), width, height, channels) != 0;
+}
+
+unsigned char* loadImage(const std::string& path, int* width, int* height, int* channels, int desiredChannels)
+{
+	Bytes bytes;
+	if (findImage(path, bytes))
+		return stbi_load_from_memory(bytes.data, (int)bytes.size, width, height, channels, desiredChannels);
+	return stbi_load(path.c_str(), width, height, channels, desiredChannels);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// An encoded image that lives in memory instead of a file of its own, like the images inside a
+// .glb. While it exists its path names the bytes it was given, the texture loaders read all
+// images through imageInfo and loadImage, which look up registered paths before going to the
+// file system. Owns the registration, it can be moved but not copied.
+class EmbeddedImage
+{
+public:
+	// owner keeps the bytes alive, also for loads on streaming threads that are still running
+	// when the image is unregistered
+	EmbeddedImage(const std::string& path, std::shared_ptr<const void> owner, const unsigned char* data, size_t size);
+	EmbeddedImage(EmbeddedImage&& other) noexcept;
+	EmbeddedImage& operator=(EmbeddedImage&& other) noexcept;
+	EmbeddedImage(const EmbeddedImage&) = delete;
+	EmbeddedImage& operator=(const EmbeddedImage&) = delete;
+	~EmbeddedImage() { Unregister(); }
+
+	const std::string& Path() const { return path; }
+
+private:
+	std::string path;
+
+	void Unregister();
+};
+
+// stbi_info and stbi_load for files and embedded images, safe to call from any thread. Free
+// the pixels with stbi_image_free.
+bool imageInfo(const std::string& path, int* width, int* height, int* channels);
+unsigned char* loadImage(const std::string& path, int* width, int* height, int* channels, int desiredChannels);
@@ -0,0 +1,350 @@
+#include "Json.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	// Deeper documents are rejected instead of overflowing the stack
+	const int MAX_DEPTH = 256;
+
+	const JsonValue nullValue;
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t length) : current(text), end(text + length), begin(text) {}
+
+		bool ParseDocument(JsonValue& value, std::string& error)
+		{
+			if (ParseValue(value, 0))
+			{
+				SkipWhitespace();
+				if (current == end)
+					return true;
+				Fail("unexpected trailing characters");
+			}
+			error = message;
+			return false;
+		}
+
+	private:
+		const char* current;
+		const char* end;
+		const char* begin;
+		std::string message;
+
+		bool Fail(const char* what)
+		{
+			if (message.empty())
+				message = std::string(what) + " at offset " + std::to_string(current - begin);
+			return false;
+		}
+
+		void SkipWhitespace()
+		{
+			while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+				current++;
+		}
+
+		bool Consume(const char* literal)
+		{
+			const char* position = current;
+			for (const char* c = literal; *c; c++, position++)
+				if (position == end || *position != *c)
+					return false;
+			current = position;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth)
+		{
+			if (depth > MAX_DEPTH)
+				return Fail("nesting too deep");
+
+			SkipWhitespace();
+			if (current == end)
+				return Fail("unexpected end of input");
+
+			switch (*current)
+			{
+			case '{':
+				return ParseObject(value, depth);
+			case '[':
+				return ParseArray(value, depth);
+			case '"':
+				value.type = JSON_STRING;
+				return ParseString(value.string);
+			case 't':
+			case 'f':
+				value.type = JSON_BOOL;
+				value.boolean = *current == 't';
+				return Consume(value.boolean ? "true" : "false") || Fail("invalid literal");
+			case 'n':
+				value.type = JSON_NULL;
+				return Consume("null") || Fail("invalid literal");
+			default:
+				return ParseNumber(value);
+			}
+		}
+
+		bool ParseObject(JsonValue& value, int depth)
+		{
+			value.type = JSON_OBJECT;
+			current++;
+			SkipWhitespace();
+			if (current < end && *current == '}')
+			{
+				current++;
+				return true;
+			}
+
+			while (true)
+			{
+				SkipWhitespace();
+				if (current == end || *current != '"')
+					return Fail("expected a member name");
+				value.members.emplace_back();
+				if (!ParseString(value.members.back().first))
+					return false;
+
+				SkipWhitespace();
+				if (current == end || *current != ':')
+					return Fail("expected ':'");
+				current++;
+				if (!ParseValue(value.members.back().second, depth + 1))
+					return false;
+
+				SkipWhitespace();
+				if (current < end && *current == ',')
+				{
+					current++;
+					continue;
+				}
+				if (current < end && *current == '}')
+				{
+					current++;
+					return true;
+				}
+				return Fail("expected ',' or '}'");
+			}
+		}
+
+		bool ParseArray(JsonValue& value, int depth)
+		{
+			value.type = JSON_ARRAY;
+			current++;
+			SkipWhitespace();
+			if (current < end && *current == ']')
+			{
+				current++;
+				return true;
+			}
+
+			while (true)
+			{
+				value.array.emplace_back();
+				if (!ParseValue(value.array.back(), depth + 1))
+					return false;
+
+				SkipWhitespace();
+				if (current < end && *current == ',')
+				{
+					current++;
+					continue;
+				}
+				if (current < end && *current == ']')
+				{
+					current++;
+					return true;
+				}
+				return Fail("expected ',' or ']'");
+			}
+		}
+
+		bool ParseHex4(unsigned int& codePoint)
+		{
+			if (end - current < 4)
+				return Fail("truncated unicode escape");
+			codePoint = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				char c = *current++;
+				codePoint <<= 4;
+				if (c >= '0' && c <= '9')
+					codePoint |= c - '0';
+				else if (c >= 'a' && c <= 'f')
+					codePoint |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F')
+					codePoint |= c - 'A' + 10;
+				else
+					return Fail("invalid unicode escape");
+			}
+			return true;
+		}
+
+		static void AppendUtf8(std::string& out, unsigned int codePoint)
+		{
+			if (codePoint < 0x80)
+				out += (char)codePoint;
+			else if (codePoint < 0x800)
+			{
+				out += (char)(0xC0 | (codePoint >> 6));
+				out += (char)(0x80 | (codePoint & 0x3F));
+			}
+			else if (codePoint < 0x10000)
+			{
+				out += (char)(0xE0 | (codePoint >> 12));
+				out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+				out += (char)(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				out += (char)(0xF0 | (codePoint >> 18));
+				out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+				out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+				out += (char)(0x80 | (codePoint & 0x3F));
+			}
+		}
+
+		bool ParseString(std::string& out)
+		{
+			current++;
+			while (current < end && *current != '"')
+			{
+				char c = *current++;
+				if ((unsigned char)c < 0x20)
+					return Fail("control character in string");
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+
+				if (current == end)
+					break;
+				char escape = *current++;
+				switch (escape)
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					unsigned int codePoint;
+					if (!ParseHex4(codePoint))
+						return false;
+					// Characters outside the basic plane come as a surrogate pair
+					if (codePoint >= 0xD800 && codePoint < 0xDC00)
+					{
+						unsigned int low;
+						if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+							return Fail("invalid surrogate pair");
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(out, codePoint);
+					break;
+				}
+				default:
+					return Fail("invalid escape sequence");
+				}
+			}
+			if (current == end)
+				return Fail("unterminated string");
+			current++;
+			return true;
+		}
+
+		bool ParseNumber(JsonValue& value)
+		{
+			const char* start = current;
+			if (current < end && *current == '-')
+				current++;
+			while (current < end && ((*current >= '0' && *current <= '9') || *current == '.'
+				|| *current == 'e' || *current == 'E' || *current == '+' || *current == '-'))
+				current++;
+			if (current == start)
+				return Fail("unexpected character");
+
+			// strtod needs a terminated string and the input is only a range
+			std::string token(start, current);
+			char* tokenEnd;
+			value.type = JSON_NUMBER;
+			value.number = strtod(token.c_str(), &tokenEnd);
+			if (tokenEnd != token.c_str() + token.size())
+			{
+				current = start;
+				return Fail("invalid number");
+			}
+			return true;
+		}
+	};
+}
+
+bool JsonValue::Parse(const char* text, size_t length, JsonValue& value, std::string& error)
+{
+	value = JsonValue();
+	JsonParser parser(text, length);
+	return parser.ParseDocument(value, error);
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (type == JSON_OBJECT)
+	{
+		for (const auto& member : members)
+			if (member.first == key)
+				return member.second;
+	}
+	return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (type == JSON_ARRAY && index < array.size())
+		return array[index];
+	return nullValue;
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return type == JSON_OBJECT && &(*this)[key] != &nullValue;
+}
+
+size_t JsonValue::Size() const
+{
+	if (type == JSON_ARRAY)
+		return array.size();
+	if (type == JSON_OBJECT)
+		return members.size();
+	return 0;
+}
+
+std::string escapeJson(const std::string& text)
+{
+	std::string out = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (c == '\n')
+			out += "\\n";
+		else if ((unsigned char)c < 0x20)
+		{
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			out += escape;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
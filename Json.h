@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+enum jsonType
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+// Parsed JSON document. Members keep the order of the file, lookups on missing keys or
+// indices return a null value, so optional fields can be read without checks.
+class JsonValue
+{
+public:
+	jsonType type = JSON_NULL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	// Returns false and describes the first syntax error in error
+	static bool Parse(const char* text, size_t length, JsonValue& value, std::string& error);
+
+	const JsonValue& operator[](const char* key) const;
+	const JsonValue& operator[](size_t index) const;
+	bool Has(const char* key) const;
+	// Number of array elements or object members
+	size_t Size() const;
+
+	bool IsNull() const { return type == JSON_NULL; }
+	double AsNumber(double fallback = 0.0) const { return type == JSON_NUMBER ? number : fallback; }
+	int AsInt(int fallback = 0) const { return type == JSON_NUMBER ? (int)number : fallback; }
+	bool AsBool(bool fallback = false) const { return type == JSON_BOOL ? boolean : fallback; }
+	const std::string& AsString() const { return string; }
+};
+
+// Quotes and escapes a string for writing it into a JSON file
+std::string escapeJson(const std::string& text);
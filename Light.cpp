@@ -0,0 +1,10 @@
+#include "Light.h"
+
+float attenuationRadius(const glm::vec3& color, float intensity, float constant, float linear, float quadratic)
+{
+	float brightest = glm::max(glm::max(color.r, color.g), color.b) * intensity;
+	float c = constant - brightest * (256.0f / 5.0f);
+	if (quadratic <= 0.0f)
+		return linear > 0.0f ? -c / linear : 0.0f;
+	return (-linear + glm::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+}
@@ -6,10 +6,9 @@
 #include "Shader.h"
 
 
-std::string getIndexedUniformName(std::string name, int index, std::string attribute)
-{
-	return (name + '[' + char('0' + index) + "]." + attribute);
-}
+// Distance at which a light of the color times the intensity falls below 5/256 of its brightest
+// channel under the attenuation 1 / (constant + linear * d + quadratic * d^2)
+float attenuationRadius(const glm::vec3& color, float intensity, float constant, float linear, float quadratic);
 
 
 
@@ -22,19 +21,36 @@ public:
 		float diffuse,
 		float specular,
 		const glm::vec3& direction
+	) : DirLight(ambient, diffuse, specular, direction)
+	{
+		Apply(shader);
+	}
+
+	DirLight(
+		float ambient,
+		float diffuse,
+		float specular,
+		const glm::vec3& direction
 	)
 	{
 		DirLight::ambient = ambient;
 		DirLight::diffuse = diffuse;
 		DirLight::specular = specular;
 		DirLight::direction = direction;
+	}
 
+	void Apply(Shader& shader) const
+	{
 		shader.Activate();
 		shader.SetVec3("dirLight.ambient", glm::vec3(ambient));
 		shader.SetVec3("dirLight.diffuse", glm::vec3(diffuse));
 		shader.SetVec3("dirLight.specular", glm::vec3(specular));
 		shader.SetVec3("dirLight.direction", direction);
 	}
+
+	const glm::vec3& GetDirection() const { return direction; }
+	void SetDirection(const glm::vec3& direction) { DirLight::direction = direction; }
+
 private:
 	float ambient;
 	float diffuse;
@@ -54,6 +70,21 @@ public:
 		float constant = 1.0f,
 		float linear = 0.09f,
 		float quadratic = 0.032f
+	) : PointLight(ambient, diffuse, specular, position, glm::vec3(1.0f), constant, linear, quadratic)
+	{
+		Apply(shader, "pointLight");
+	}
+
+	// Lights that are not bound to a single shader, e.g. the deferred renderer's light list
+	PointLight(
+		float ambient,
+		float diffuse,
+		float specular,
+		const glm::vec3& position,
+		const glm::vec3& color = glm::vec3(1.0f),
+		float constant = 1.0f,
+		float linear = 0.09f,
+		float quadratic = 0.032f
 	)
 	{
 		PointLight::ambient = ambient;
@@ -63,17 +94,28 @@ public:
 		PointLight::linear = linear;
 		PointLight::quadratic = quadratic;
 		PointLight::position = position;
+		PointLight::color = color;
+	}
 
+	void Apply(Shader& shader, const std::string& name) const
+	{
 		shader.Activate();
-		shader.SetVec3("pointLight.ambient", glm::vec3(ambient));
-		shader.SetVec3("pointLight.diffuse", glm::vec3(diffuse));
-		shader.SetVec3("pointLight.specular", glm::vec3(specular));
-		shader.SetFloat("pointLight.constant", constant);
-		shader.SetFloat("pointLight.linear", linear);
-		shader.SetFloat("pointLight.quadratic", quadratic);
-		shader.SetVec3("pointLight.position", position);
+		shader.SetVec3(name + ".ambient", ambient * color);
+		shader.SetVec3(name + ".diffuse", diffuse * color);
+		shader.SetVec3(name + ".specular", specular * color);
+		shader.SetFloat(name + ".constant", constant);
+		shader.SetFloat(name + ".linear", linear);
+		shader.SetFloat(name + ".quadratic", quadratic);
+		shader.SetVec3(name + ".position", position);
+		shader.SetFloat(name + ".radius", Radius());
 	}
-private:
+
+	// Distance at which the attenuated light falls below 5/256 of its brightest channel
+	float Radius() const
+	{
+		return attenuationRadius(color, glm::max(glm::max(ambient, diffuse), specular), constant, linear, quadratic);
+	}
+
 	float ambient;
 	float diffuse;
 	float specular;
@@ -81,18 +123,20 @@ private:
 	float linear;
 	float quadratic;
 	glm::vec3 position;
+	glm::vec3 color;
 };
 
 class SpotLight
 {
 public:
+	// Lights that are not bound to a single shader, e.g. the clustered light list
 	SpotLight(
-		Shader& shader,
 		float ambient,
 		float diffuse,
 		float specular,
 		const glm::vec3& position,
 		const glm::vec3& direction,
+		const glm::vec3& color = glm::vec3(1.0f),
 		float constant = 1.0f,
 		float linear = 0.09f,
 		float quadratic = 0.032f,
@@ -110,28 +154,14 @@ public:
 		SpotLight::outerCutOff = outerCutOff;
 		SpotLight::position = position;
 		SpotLight::direction = direction;
+		SpotLight::color = color;
+	}
 
-		SpotLight::index = count;
-		count += 1;
-
-		shader.Activate();
-		shader.SetVec3(getIndexedUniformName("spotLights", index, "ambient"), glm::vec3(ambient));
-		shader.SetVec3(getIndexedUniformName("spotLights", index, "diffuse"), glm::vec3(diffuse));
-		shader.SetVec3(getIndexedUniformName("spotLights", index, "specular"), glm::vec3(specular));
-		shader.SetFloat(getIndexedUniformName("spotLights", index, "constant"), constant);
-		shader.SetFloat(getIndexedUniformName("spotLights", index, "linear"), linear);
-		shader.SetFloat(getIndexedUniformName("spotLights", index, "quadratic"), quadratic);
-		shader.SetFloat(getIndexedUniformName("spotLights", index, "cutOff"), cutOff);
-		shader.SetFloat(getIndexedUniformName("spotLights", index, "outerCutOff"), outerCutOff);
-
-		shader.SetVec3(getIndexedUniformName("spotLights", index, "position"), position);
-		shader.SetVec3(getIndexedUniformName("spotLights", index, "direction"), direction);
-
-		shader.SetInt("numSpotLights", count);
+	// Same cut-off distance as PointLight::Radius, the cone is bounded by this sphere
+	float Radius() const
+	{
+		return attenuationRadius(color, glm::max(glm::max(ambient, diffuse), specular), constant, linear, quadratic);
 	}
-	static int count;
-private:
-	int index;
 
 	float ambient;
 	float diffuse;
@@ -143,6 +173,5 @@ private:
 	float outerCutOff;
 	glm::vec3 position;
 	glm::vec3 direction;
-};
-
-int SpotLight::count = 0;
\ No newline at end of file
+	glm::vec3 color;
+};
\ No newline at end of file
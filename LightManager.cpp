@@ -0,0 +1,250 @@
+#include "LightManager.h"
+
+#include <algorithm>
+
+LightManager::LightManager()
+{
+	glGenBuffers(1, &bufferID);
+	glGenTextures(1, &textureID);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, bufferID);
+	glBufferData(GL_TEXTURE_BUFFER, TEXELS_PER_LIGHT * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bufferID);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	capacity = 1;
+}
+
+unsigned int LightManager::Add(const PointLight& light)
+{
+	unsigned int handle = Allocate();
+	size_t index = slots[handle];
+
+	positions[index] = light.position;
+	directions[index] = glm::vec3(0.0f);
+	diffuse[index] = light.diffuse * light.color;
+	specular[index] = light.specular * light.color;
+	constant[index] = light.constant;
+	linear[index] = light.linear;
+	quadratic[index] = light.quadratic;
+	cutOff[index] = -1.0f;
+	outerCutOff[index] = -2.0f;
+	radii[index] = Radius(index);
+	isSpot[index] = 0;
+
+	return handle;
+}
+
+unsigned int LightManager::Add(const SpotLight& light)
+{
+	unsigned int handle = Allocate();
+	size_t index = slots[handle];
+
+	positions[index] = light.position;
+	directions[index] = glm::normalize(light.direction);
+	diffuse[index] = light.diffuse * light.color;
+	specular[index] = light.specular * light.color;
+	constant[index] = light.constant;
+	linear[index] = light.linear;
+	quadratic[index] = light.quadratic;
+	cutOff[index] = light.cutOff;
+	outerCutOff[index] = light.outerCutOff;
+	radii[index] = Radius(index);
+	isSpot[index] = 1;
+
+	return handle;
+}
+
+void LightManager::Remove(unsigned int handle)
+{
+	if (handle >= slots.size() || slots[handle] == INVALID_LIGHT)
+		return;
+
+	// Keep the arrays dense by moving the last light into the freed slot
+	size_t index = slots[handle];
+	size_t last = positions.size() - 1;
+	if (index != last)
+	{
+		positions[index] = positions[last];
+		directions[index] = directions[last];
+		diffuse[index] = diffuse[last];
+		specular[index] = specular[last];
+		constant[index] = constant[last];
+		linear[index] = linear[last];
+		quadratic[index] = quadratic[last];
+		cutOff[index] = cutOff[last];
+		outerCutOff[index] = outerCutOff[last];
+		radii[index] = radii[last];
+		isSpot[index] = isSpot[last];
+		handles[index] = handles[last];
+		slots[handles[index]] = (unsigned int)index;
+		MarkDirty(index);
+	}
+
+	positions.pop_back();
+	directions.pop_back();
+	diffuse.pop_back();
+	specular.pop_back();
+	constant.pop_back();
+	linear.pop_back();
+	quadratic.pop_back();
+	cutOff.pop_back();
+	outerCutOff.pop_back();
+	radii.pop_back();
+	isSpot.pop_back();
+	dirty.pop_back();
+	handles.pop_back();
+
+	slots[handle] = INVALID_LIGHT;
+	freeHandles.push_back(handle);
+}
+
+void LightManager::Clear()
+{
+	positions.clear();
+	directions.clear();
+	diffuse.clear();
+	specular.clear();
+	constant.clear();
+	linear.clear();
+	quadratic.clear();
+	cutOff.clear();
+	outerCutOff.clear();
+	radii.clear();
+	isSpot.clear();
+	dirty.clear();
+	handles.clear();
+	slots.clear();
+	freeHandles.clear();
+}
+
+void LightManager::SetPosition(unsigned int handle, const glm::vec3& position)
+{
+	size_t index = slots[handle];
+	positions[index] = position;
+	MarkDirty(index);
+}
+
+void LightManager::SetDirection(unsigned int handle, const glm::vec3& direction)
+{
+	size_t index = slots[handle];
+	directions[index] = glm::normalize(direction);
+	MarkDirty(index);
+}
+
+void LightManager::SetColor(unsigned int handle, const glm::vec3& diffuse, const glm::vec3& specular)
+{
+	size_t index = slots[handle];
+	LightManager::diffuse[index] = diffuse;
+	LightManager::specular[index] = specular;
+	radii[index] = Radius(index);
+	MarkDirty(index);
+}
+
+float LightManager::Radius(size_t index) const
+{
+	// Ambient light isn't in the buffer, so diffuse and specular alone decide how far it reaches
+	return attenuationRadius(glm::max(diffuse[index], specular[index]), 1.0f, constant[index], linear[index], quadratic[index]);
+}
+
+void LightManager::Upload()
+{
+	uploadedBytes = 0;
+	uploadedRanges = 0;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, bufferID);
+
+	// Grow geometrically, a reallocation has to resend every light
+	if (positions.size() > capacity)
+	{
+		while (capacity < positions.size())
+			capacity *= 2;
+		glBufferData(GL_TEXTURE_BUFFER, capacity * TEXELS_PER_LIGHT * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+		std::fill(dirty.begin(), dirty.end(), 1);
+	}
+
+	staging.resize(positions.size() * TEXELS_PER_LIGHT);
+
+	// Coalesce consecutive dirty lights into one glBufferSubData per range
+	size_t i = 0;
+	while (i < dirty.size())
+	{
+		if (!dirty[i])
+		{
+			i++;
+			continue;
+		}
+
+		size_t begin = i;
+		for (; i < dirty.size() && dirty[i]; i++)
+		{
+			Pack(i, &staging[i * TEXELS_PER_LIGHT]);
+			dirty[i] = 0;
+		}
+
+		GLintptr offset = begin * TEXELS_PER_LIGHT * sizeof(glm::vec4);
+		GLsizeiptr size = (i - begin) * TEXELS_PER_LIGHT * sizeof(glm::vec4);
+		glBufferSubData(GL_TEXTURE_BUFFER, offset, size, &staging[begin * TEXELS_PER_LIGHT]);
+		uploadedBytes += size;
+		uploadedRanges++;
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightManager::Bind(GLuint unit)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+}
+
+void LightManager::Delete()
+{
+	glDeleteTextures(1, &textureID);
+	glDeleteBuffers(1, &bufferID);
+}
+
+unsigned int LightManager::Allocate()
+{
+	unsigned int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (unsigned int)slots.size();
+		slots.push_back((unsigned int)INVALID_LIGHT);
+	}
+
+	size_t index = positions.size();
+	slots[handle] = (unsigned int)index;
+
+	positions.emplace_back();
+	directions.emplace_back();
+	diffuse.emplace_back();
+	specular.emplace_back();
+	constant.emplace_back();
+	linear.emplace_back();
+	quadratic.emplace_back();
+	cutOff.emplace_back();
+	outerCutOff.emplace_back();
+	radii.emplace_back();
+	isSpot.emplace_back();
+	dirty.push_back(1);
+	handles.push_back(handle);
+
+	return handle;
+}
+
+void LightManager::Pack(size_t index, glm::vec4* texels) const
+{
+	texels[0] = glm::vec4(positions[index], radii[index]);
+	texels[1] = glm::vec4(diffuse[index], constant[index]);
+	texels[2] = glm::vec4(specular[index], linear[index]);
+	texels[3] = glm::vec4(directions[index], quadratic[index]);
+	texels[4] = glm::vec4(cutOff[index], outerCutOff[index], isSpot[index] ? 1.0f : 0.0f, 0.0f);
+}
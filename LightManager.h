@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Light.h"
+
+// Owns every point and spot light in structure-of-arrays form and mirrors them into one
+// shared texture buffer. Lights are addressed by stable handles, stay densely packed on
+// removal and only the lights changed since the last Upload() are sent to the GPU.
+//
+// Texture buffer layout, 5 RGBA32F texels per light:
+//   0: position.xyz, radius
+//   1: diffuse.rgb, constant
+//   2: specular.rgb, linear
+//   3: direction.xyz, quadratic
+//   4: cutOff, outerCutOff, isSpot, 0
+class LightManager
+{
+public:
+	static const unsigned int INVALID_LIGHT = 0xFFFFFFFF;
+	static const int TEXELS_PER_LIGHT = 5;
+
+	LightManager();
+
+	unsigned int Add(const PointLight& light);
+	unsigned int Add(const SpotLight& light);
+	void Remove(unsigned int handle);
+	void Clear();
+
+	void SetPosition(unsigned int handle, const glm::vec3& position);
+	void SetDirection(unsigned int handle, const glm::vec3& direction);
+	void SetColor(unsigned int handle, const glm::vec3& diffuse, const glm::vec3& specular);
+	const glm::vec3& GetPosition(unsigned int handle) const { return positions[slots[handle]]; }
+	const glm::vec3& GetDirection(unsigned int handle) const { return directions[slots[handle]]; }
+
+	// Sends the dirty ranges of the light buffer to the GPU
+	void Upload();
+	void Bind(GLuint unit);
+	void Delete();
+
+	size_t Size() const { return positions.size(); }
+	size_t UploadedBytes() const { return uploadedBytes; }
+	size_t UploadedRanges() const { return uploadedRanges; }
+
+	// Dense arrays, index i is the i-th light in the buffer
+	const std::vector<glm::vec3>& Positions() const { return positions; }
+	const std::vector<float>& Radii() const { return radii; }
+	const std::vector<unsigned char>& SpotFlags() const { return isSpot; }
+
+private:
+	GLuint bufferID = 0;
+	GLuint textureID = 0;
+	size_t capacity = 0;
+
+	size_t uploadedBytes = 0;
+	size_t uploadedRanges = 0;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> directions;
+	std::vector<glm::vec3> diffuse;
+	std::vector<glm::vec3> specular;
+	std::vector<float> constant;
+	std::vector<float> linear;
+	std::vector<float> quadratic;
+	std::vector<float> cutOff;
+	std::vector<float> outerCutOff;
+	std::vector<float> radii;
+	std::vector<unsigned char> isSpot;
+	std::vector<unsigned char> dirty;
+
+	// handle -> dense index and dense index -> handle
+	std::vector<unsigned int> slots;
+	std::vector<unsigned int> handles;
+	std::vector<unsigned int> freeHandles;
+
+	std::vector<glm::vec4> staging;
+
+	unsigned int Allocate();
+	void MarkDirty(size_t index) { dirty[index] = 1; }
+	// Cut-off distance of the light's current colors and attenuation
+	float Radius(size_t index) const;
+	void Pack(size_t index, glm::vec4* texels) const;
+};
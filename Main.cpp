@@ -11,15 +11,34 @@
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 #include <stb/stb_image.h>
 #include <nfd/nfd.h>
 
 #include "Shader.h"
+#include "ShaderWatcher.h"
 #include "Texture.h"
+#include "TextureArray.h"
 #include "Camera.h"
 #include "Light.h"
 #include "Mesh.h"
 #include "Model.h"
+#include "DeferredRenderer.h"
+#include "DeletionQueue.h"
+#include "DrawData.h"
+#include "FramePacer.h"
+#include "ClusteredLights.h"
+#include "LightManager.h"
+#include "CascadedShadowMap.h"
+#include "AllocationCounter.h"
+#include "Animator.h"
+#include "Headless.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "TextureStreamer.h"
+#include "WorkerPool.h"
 
 // GLFW call back functions
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -35,6 +54,14 @@ float cameraFarPlane = 100.0f;
 // Set up the camera
 Camera camera(SCR_WIDTH, SCR_HEIGHT, glm::vec3(0.0f, 0.0f, 2.0f));
 
+// Render paths selectable from the Shader menu
+enum shadingMode
+{
+	SHADING_DEFAULT,
+	SHADING_DEPTH,
+	SHADING_DEFERRED
+};
+
 // OpenGL debug output context
 void APIENTRY glDebugOutput(GLenum source,
 	GLenum type,
@@ -137,40 +164,88 @@ glm::vec3 lightPositions[] = {
 
 
 // GUI rendering functions
-void showMainMenuBar(Model& model, std::string& currentModelPath);
-
-int main()
+// Returns true when a new model was opened
+bool showMainMenuBar(Model& model, std::string& currentModelPath);
+shadingMode getShadingMode(const std::string& name);
+// Loads every bundled model once and prints its CPU geometry under each residency policy
+void printGeometryResidencyReport();
+// Loads every bundled glTF, PMX and OBJ model with both loaders and prints the median load times
+// and the peak heap use
+void printLoaderReport();
+
+// Scatter point lights with short ranges around the normalized model for the deferred path
+void generatePointLights(LightManager& lights, std::vector<unsigned int>& handles, int count);
+void animatePointLights(LightManager& lights, const std::vector<unsigned int>& handles, float time);
+void generateSpotLights(LightManager& lights, std::vector<unsigned int>& handles, int count);
+void animateSpotLights(LightManager& lights, const std::vector<unsigned int>& handles, float time);
+
+int main(int argc, char* argv[])
 {
-	// GLFW initialization
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef DEBUG_OUTPUT_ENABLED
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
-#endif
+	auto startupTime = std::chrono::high_resolution_clock::now();
 
-	// Create GLFW window
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL)
-	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
+	// The command line presets the scene, --headless renders it offscreen and exits afterwards
+	HeadlessOptions headless;
+	if (!headless.Parse(argc, argv))
 		return -1;
-	}
-	glfwMakeContextCurrent(window);
-	glfwSwapInterval(0);
-	// Setup GLFW callback functions
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	// Headless runs go through a list of scenarios, a plain --headless run is a single one made of the options
+	std::vector<BenchmarkScenario> scenarios;
+	if (headless.enabled && !selectScenarios(headless, scenarios))
+		return -1;
+	SCR_WIDTH = headless.width;
+	SCR_HEIGHT = headless.height;
+	camera.UpdateAspectRatio(SCR_WIDTH, SCR_HEIGHT);
 
-	// Tell GLFW to capture our mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	GLFWwindow* window = NULL;
+	HeadlessContext headlessContext;
+	if (headless.enabled)
+	{
+		if (!headlessContext.Create())
+			return -1;
 
-	// Load all OpenGL function pointers with glad
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::GetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+		}
+	}
+	else
 	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		// GLFW initialization
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef DEBUG_OUTPUT_ENABLED
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+#endif
+
+		// Create GLFW window
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		FramePacer::targetFps = headless.targetFps;
+		FramePacer::swapInterval = headless.swapInterval;
+		FramePacer::lowLatency = headless.lowLatency;
+		FramePacer::renderOnDemand = headless.renderOnDemand;
+		FramePacer::Apply();
+		// Setup GLFW callback functions
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		FramePacer::TrackEvents(window);
+
+		// Tell GLFW to capture our mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// Load all OpenGL function pointers with glad
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+		}
 	}
 
 	// Configurations for debug output context
@@ -184,14 +259,39 @@ int main()
 		std::cout << "OpenGL debug output is enabled!" << std::endl;
 	}
 
+	// Let the driver compile shaders on as many threads as it likes
+	if (GLAD_GL_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	Model::nativeLoaders = headless.nativeLoaders;
+	if (headless.geometryReport || headless.loadReport)
+	{
+		if (headless.geometryReport)
+			printGeometryResidencyReport();
+		if (headless.loadReport)
+			printLoaderReport();
+		TextureStreamer::Stop();
+		DeletionQueue::Shutdown();
+		headlessContext.Destroy();
+		return 0;
+	}
 
 
-	// Setup Dear ImGui context
+	// Setup Dear ImGui context, headless runs only build the UI when asked to
+	bool useImGui = !headless.enabled || headless.imgui;
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
-	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;         // Enable Docking
-	io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;       // Enable Multi-Viewport / Platform Windows
+	if (window)
+	{
+		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;         // Enable Docking
+		io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;       // Enable Multi-Viewport / Platform Windows
+	}
+	else
+	{
+		io.IniFilename = NULL;
+		io.DisplaySize = ImVec2((float)SCR_WIDTH, (float)SCR_HEIGHT);
+	}
 
 	// Setup Dear ImGui style
 	ImGui::StyleColorsDark();
@@ -207,65 +307,133 @@ int main()
 	}
 
 	// Setup Platform/Renderer backends
-	ImGui_ImplGlfw_InitForOpenGL(window, true);
-	ImGui_ImplOpenGL3_Init("#version 330");
+	if (window)
+		ImGui_ImplGlfw_InitForOpenGL(window, true);
+	if (useImGui)
+		ImGui_ImplOpenGL3_Init("#version 330");
+
 
 
+	MemoryTracker::budgetBytes = (size_t)headless.memoryBudget * 1024 * 1024;
+	TextureStreamer::enabled = headless.textureStreaming;
+	StreamBuffer::allowPersistentMapping = headless.persistentMapping;
+	TextureStreamer::budgetBytes = (size_t)headless.textureBudget * 1024 * 1024;
 
 	// Load textures for object
+	MemoryTracker::PushOwner("Floor and light");
 	std::string texturePath = "Resources/";
-	Texture textures[] =
+	std::vector<Texture> floorTextures =
 	{
-		Texture((texturePath + "planks.png").c_str(), DIFFUSE, 0),
-		Texture((texturePath + "planksSpec.png").c_str(), SPECULAR, 1)
+		Texture(texturePath + "planks.png", DIFFUSE),
+		Texture(texturePath + "planksSpec.png", SPECULAR)
 	};
+	std::vector<TextureArray> floorTextureArrays = createTextureArrays(floorTextures);
 
 	// Load a model
 	bool flipTexture = true;
+	geometryResidency modelGeometry = GEOMETRY_DISCARD;
+	parseGeometryResidency(headless.geometry, modelGeometry);
 	std::string currentModelPath = "Resources/deccer-cubes/SM_Deccer_Cubes_Textured.glb";
-	Model currentModel(currentModelPath.c_str(), flipTexture);
+	if (!headless.modelPath.empty())
+		currentModelPath = headless.modelPath;
+	if (!scenarios.empty() && !scenarios[0].modelPath.empty())
+		currentModelPath = scenarios[0].modelPath;
+	Model currentModel(currentModelPath.c_str(), flipTexture, modelGeometry);
 	currentModel.Scale(glm::vec3(2.0f));
 
 
 
-	// Setting up default shader and its objects to render
-	Shader shaderProgram("default.vert", "default.frag");
+	// Setting up default shader variants and its objects to render
+	ShaderPermutations defaultShaders("default.vert", "default.frag");
 	std::vector <Vertex> objVertices(vertices, vertices + sizeof(vertices) / sizeof(Vertex));
 	std::vector <GLuint> objIndices(indices, indices + sizeof(indices) / sizeof(GLuint));
-	std::vector <Texture> objTextures(textures, textures + sizeof(textures) / sizeof(Texture));
-	Mesh floor(objVertices, objIndices, objTextures);
+	Mesh floor(std::move(objVertices), std::move(objIndices), floorTextures);
 
 	// Setting up the light shader and its object to render
 	Shader lightShader("light.vert", "light.frag");
 	std::vector <Vertex> lightVert(lightVertices, lightVertices + sizeof(lightVertices) / sizeof(Vertex));
 	std::vector <GLuint> lightIdx(lightIndices, lightIndices + sizeof(lightIndices) / sizeof(GLuint));
-	Mesh light(lightVert, lightIdx);
+	Mesh light(std::move(lightVert), std::move(lightIdx));
+	MemoryTracker::PopOwner();
 
-	// Setting up depth shader for depth visualization
-	Shader depthShader("default.vert", "depth.frag");
+	// Setting up depth shaders for depth visualization, skinned meshes get their own variant
+	ShaderPermutations depthShaders("default.vert", "depth.frag");
+	depthShaders.onCompile = [](Shader& shader)
+	{
+		DrawData::SetTextureUnits(shader);
+		Animator::SetTextureUnits(shader);
+	};
 
 	// Setting up stencil outline shader
 	Shader stencilOutlineShader("stencilOutline.vert", "stencilOutline.frag");
-	stencilOutlineShader.Activate();
-	stencilOutlineShader.SetFloat("outlining", 0.08f);
+	stencilOutlineShader.onCompile = [](Shader& shader) { shader.SetFloat("outlining", 0.08f); };
 
+	// Setting up the deferred renderer and its dynamic point lights
+	DeferredRenderer deferredRenderer(SCR_WIDTH, SCR_HEIGHT);
+	LightManager lights;
+	int numPointLights = headless.pointLights;
+	std::vector<unsigned int> pointLights;
+	std::vector<unsigned int> spotLights;
+	generatePointLights(lights, pointLights, numPointLights);
+
+	// Setting up clustered forward lighting, sharing the point lights above
+	ClusteredLights clusteredLights;
+
+	// Setting up cascaded shadow maps for the directional light
+	CascadedShadowMap shadowMap;
 
 
-	// Initialize values of uniform variables in each shader
-	glm::vec3 objectPosition = glm::vec3(0.0f, 0.0f, 0.0f);
-	glm::mat4 objectModel = glm::mat4(1.0f);
-	objectModel = glm::translate(objectModel, objectPosition);
 
+	// Initialize values of uniform variables in each shader
 	glm::vec3 lightPosition(0.5f, 0.5f, 0.5f);
-	DirLight dirLight(shaderProgram, 0.6f, 1.0f, 0.8f, glm::vec3(0.0f, 0.0f, 1.0f));
+	DirLight dirLight(0.6f, 1.0f, 0.8f, glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 dirLightDirection = dirLight.GetDirection();
 
 
 
-	// Assign values to the uniform variables
-	shaderProgram.Activate();
-	shaderProgram.SetMat4("model", objectModel);
-	shaderProgram.SetMat3("normalMatrix", glm::mat3(glm::transpose(glm::inverse(objectModel))));
-	shaderProgram.SetFloat("shininess", 4.0f);
+	// Assign the static uniform values whenever a new default shader variant gets compiled
+	defaultShaders.onCompile = [&](Shader& shader)
+	{
+		shader.Activate();
+		shader.SetFloat("shininess", 4.0f);
+		dirLight.Apply(shader);
+		Texture::SetTextureUnits(shader);
+		DrawData::SetTextureUnits(shader);
+		clusteredLights.SetTextureUnits(shader);
+		shadowMap.SetTextureUnits(shader);
+		Animator::SetTextureUnits(shader);
+	};
+
+	// Submit every program a render path can reach, the driver compiles them while the first
+	// frames render and toggling a feature later doesn't have to wait for the compiler
+	for (unsigned int features : { 0u, (unsigned int)FEATURE_SKINNING })
+	{
+		depthShaders.Submit(features);
+		deferredRenderer.geometryShaders.Submit(features);
+		shadowMap.depthShaders.Submit(features);
+	}
+	deferredRenderer.dirLightShader.Submit();
+	deferredRenderer.pointLightShader.Submit();
+	unsigned int reachableFeatures[] =
+	{
+		0,
+		FEATURE_LIGHTING,
+		FEATURE_LIGHTING | FEATURE_CLUSTERED_LIGHTING,
+		FEATURE_LIGHTING | FEATURE_SHADOWS,
+		FEATURE_LIGHTING | FEATURE_CLUSTERED_LIGHTING | FEATURE_SHADOWS
+	};
+	for (unsigned int features : reachableFeatures)
+	{
+		defaultShaders.Submit(features);
+		defaultShaders.Submit(features | FEATURE_TEXTURED);
+		defaultShaders.Submit(features | FEATURE_SKINNING);
+		defaultShaders.Submit(features | FEATURE_TEXTURED | FEATURE_SKINNING);
+	}
+
+	// Pick up shader edits on disk, headless runs keep the sources they started with
+	bool hotReload = !headless.enabled;
+	if (hotReload)
+		ShaderWatcher::Start();
 
 
 
@@ -283,14 +451,154 @@ int main()
 
 
 	// GUI variables
-	Shader* currentShader = &shaderProgram;
+	shadingMode currentShading = getShadingMode(headless.shading);
+	bool clusteredLighting = headless.clusteredLighting;
+	bool shadows = headless.shadows;
 	glm::vec4 clearColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
 	bool showDemoWindow = false;
-	bool lighting = true;
+	bool showProfiler = false;
+	bool showMemory = false;
+	bool lighting = headless.lighting;
+	bool firstFrame = true;
+
+	// Headless runs draw into an offscreen framebuffer in place of the window
+	OffscreenTarget offscreenTarget;
+	if (headless.enabled)
+	{
+		offscreenTarget.Create(SCR_WIDTH, SCR_HEIGHT);
+		offscreenTarget.Bind();
+		deferredRenderer.targetFramebuffer = offscreenTarget.ID;
+		shadowMap.targetFramebuffer = offscreenTarget.ID;
+	}
+	size_t scenarioIndex = 0;
+	int frame = 0;
+	std::vector<float> frameMilliseconds;
+	double drawCalls = 0.0;
+	double triangles = 0.0;
+	std::vector<BenchmarkResult> results;
+	// Replayed by headless runs, recorded by interactive sessions with --record-camera
+	CameraPath cameraPath;
+	float recordStartTime = window ? (float)glfwGetTime() : 0.0f;
+	unsigned int shaderGeneration = ShaderWatcher::Generation();
+	auto processCameraInput = [&]()
+	{
+		// Handel camera input
+		glm::vec3 previousPosition = camera.Position;
+		glm::vec3 previousOrientation = camera.Orientation;
+		if (!io.WantCaptureMouse && !io.WantCaptureKeyboard)
+			camera.ProcessInputs(window);
+		FramePacer::InputSampled();
+		if (camera.Position != previousPosition || camera.Orientation != previousOrientation)
+			FramePacer::RequestRedraw();
+		// Setting up matrices for 3D perspective
+		camera.UpdateMatrix(cameraFOV, 0.1f, 100.0f);
+		if (!headless.recordCameraPath.empty())
+			cameraPath.Record(camera, (float)glfwGetTime() - recordStartTime);
+	};
 
 	// Render loop
-	while (!glfwWindowShouldClose(window))
+	while (headless.enabled ? scenarioIndex < scenarios.size() : !glfwWindowShouldClose(window))
 	{
+		float time = 0.0f;
+		if (headless.enabled)
+		{
+			const BenchmarkScenario& scenario = scenarios[scenarioIndex];
+			if (frame == 0)
+			{
+				// Switch the scene over to the next scenario
+				if (!scenario.modelPath.empty() && scenario.modelPath != currentModelPath)
+				{
+					currentModelPath = scenario.modelPath;
+					currentModel = Model(currentModelPath.c_str(), flipTexture, modelGeometry);
+					currentModel.Scale(glm::vec3(2.0f));
+					shadowMap.Invalidate();
+				}
+				cameraPath.Clear();
+				if (currentModel.Empty() || (!scenario.cameraPath.empty() && !cameraPath.Load(scenario.cameraPath)))
+				{
+					results.push_back(summarizeBenchmark(scenario, std::vector<float>(), 0.0, 0.0));
+					printBenchmarkResult(results.back(), headless);
+					scenarioIndex++;
+					continue;
+				}
+
+				currentShading = getShadingMode(scenario.shading);
+				lighting = scenario.lighting;
+				clusteredLighting = scenario.clusteredLighting;
+				shadows = scenario.shadows;
+				if (numPointLights != scenario.pointLights || pointLights.empty())
+				{
+					numPointLights = scenario.pointLights;
+					generatePointLights(lights, pointLights, numPointLights);
+				}
+				generateSpotLights(lights, spotLights, scenario.spotLights);
+			}
+			// Headless runs advance a fixed 60 Hz clock so every run animates the same way
+			int measuredFrame = std::max(frame - scenario.warmupFrames, 0);
+			time = measuredFrame / 60.0f;
+			if (cameraPath.Empty())
+				scriptedCameraPath(camera, (float)measuredFrame / scenario.frames, scenario.orbitRadius, scenario.orbitHeight);
+			else
+				cameraPath.Apply(camera, time);
+			camera.UpdateMatrix(cameraFOV, 0.1f, 100.0f);
+
+			if (frame == scenario.warmupFrames)
+			{
+				// Measured frames shouldn't depend on how fast the driver compiles or the disk
+				// reads, so every variant links and the levels this view needs load first
+				currentModel.RequestTextureLevels(camera);
+				while (defaultShaders.NumCompiled() < defaultShaders.NumVariants() || depthShaders.NumCompiled() < depthShaders.NumVariants()
+					|| deferredRenderer.geometryShaders.NumCompiled() < deferredRenderer.geometryShaders.NumVariants()
+					|| deferredRenderer.dirLightShader.IsPending() || deferredRenderer.pointLightShader.IsPending()
+					|| shadowMap.depthShaders.NumCompiled() < shadowMap.depthShaders.NumVariants() || TextureStreamer::NumLoading() > 0)
+				{
+					defaultShaders.Poll();
+					depthShaders.Poll();
+					deferredRenderer.geometryShaders.Poll();
+					deferredRenderer.dirLightShader.Poll();
+					deferredRenderer.pointLightShader.Poll();
+					shadowMap.depthShaders.Poll();
+					TextureStreamer::Update();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				// GPU times should only cover the measured frames
+				Profiler::Reset();
+			}
+		}
+		else
+		{
+			if (FramePacer::renderOnDemand)
+			{
+				// Work that finishes in the background needs frames without any input
+				bool lightsAnimated = (currentShading == SHADING_DEFERRED || (currentShading == SHADING_DEFAULT && lighting && clusteredLighting))
+					&& (!pointLights.empty() || !spotLights.empty());
+				if (lightsAnimated || Animator::NumPlaying() > 0 || TextureStreamer::NumLoading() > 0 || defaultShaders.NumCompiled() < defaultShaders.NumVariants()
+					|| ShaderWatcher::Generation() != shaderGeneration)
+					FramePacer::RequestRedraw();
+				shaderGeneration = ShaderWatcher::Generation();
+				if (!FramePacer::WaitForRedraw())
+					continue;
+			}
+			FramePacer::WaitForNextFrame();
+			if (FramePacer::lowLatency)
+			{
+				// Read the input right before it is used instead of after the previous frame
+				glfwPollEvents();
+				processCameraInput();
+			}
+			FramePacer::BeginFrame();
+			time = (float)glfwGetTime();
+		}
+
+		auto frameStart = std::chrono::high_resolution_clock::now();
+		Profiler::BeginFrame();
+		DrawData::BeginFrame();
+		Animator::BeginFrame(time);
+
+		// Levels asked for with the camera of the previous frame, loads finish frames later anyway
+		currentModel.RequestTextureLevels(camera);
+		TextureStreamer::Update();
+
 		// Clear viewport to a color
 		glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
 		// Clear buffers to update the frame
@@ -302,110 +610,405 @@ int main()
 		// * IMGUI SECTION											*
 		// **********************************************************
 		
-		// Start the Dear ImGui frame
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		if (useImGui)
+		{
+			PROFILE_SCOPE("ImGui");
+			// Start the Dear ImGui frame
+			ImGui_ImplOpenGL3_NewFrame();
+			if (window)
+				ImGui_ImplGlfw_NewFrame();
+			else
+				io.DeltaTime = 1.0f / 60.0f;
+			ImGui::NewFrame();
 		
-		ImGui::Begin("Options", 0, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_MenuBar);
+			ImGui::Begin("Options", 0, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_MenuBar);
 
-		if (ImGui::BeginMenuBar())
-		{
-			if (ImGui::BeginMenu("Shader"))
+			if (ImGui::BeginMenuBar())
 			{
-				if (ImGui::MenuItem("Default"))
+				if (ImGui::BeginMenu("Shader"))
+				{
+					if (ImGui::MenuItem("Default"))
+					{
+						currentShading = SHADING_DEFAULT;
+					}
+					if (ImGui::MenuItem("Depth"))
+					{
+						currentShading = SHADING_DEPTH;
+					}
+					if (ImGui::MenuItem("Deferred"))
+					{
+						currentShading = SHADING_DEFERRED;
+					}
+					ImGui::EndMenu();
+				}
+
+				if (ImGui::BeginMenu("Scene"))
 				{
-					currentShader = &shaderProgram;
+					if (ImGui::MenuItem("Light Stress Test"))
+					{
+						// 4096 moving lights binned into clusters every frame
+						numPointLights = 3584;
+						generatePointLights(lights, pointLights, numPointLights);
+						generateSpotLights(lights, spotLights, 512);
+
+						currentShading = SHADING_DEFAULT;
+						clusteredLighting = true;
+					}
+					ImGui::EndMenu();
 				}
-				if (ImGui::MenuItem("Depth"))
+
+				if (ImGui::BeginMenu("Other"))
 				{
-					currentShader = &depthShader;
+					ImGui::Checkbox("Demo Menu", &showDemoWindow);
+					ImGui::Checkbox("Profiler", &showProfiler);
+					ImGui::Checkbox("Memory", &showMemory);
+					ImGui::EndMenu();
 				}
-				ImGui::EndMenu();
+
+				ImGui::EndMenuBar();
 			}
 
-			if (ImGui::BeginMenu("Other"))
+			ImGui::SeparatorText("Model");
+			if (ImGui::Button("Flip Texture"))
 			{
-				ImGui::Checkbox("Demo Menu", &showDemoWindow);
-				ImGui::EndMenu();
+				flipTexture = !flipTexture;
+				currentModel = Model(currentModelPath.c_str(), flipTexture, modelGeometry);
+				shadowMap.Invalidate();
+				FramePacer::RequestRedraw();
+			}
+			const char* residencyNames[] = { "Keep", "Compact (positions and indices)", "Discard", "On demand" };
+			int residency = (int)modelGeometry;
+			if (ImGui::Combo("CPU geometry", &residency, residencyNames, GEOMETRY_RESIDENCY_COUNT))
+			{
+				modelGeometry = (geometryResidency)residency;
+				currentModel.SetGeometryResidency(modelGeometry);
+			}
+			if (currentModel.NumClips() > 0)
+			{
+				int clip = currentModel.CurrentClip();
+				const char* preview = clip < 0 ? "Bind pose" : currentModel.ClipName(clip).c_str();
+				if (ImGui::BeginCombo("Animation", preview))
+				{
+					if (ImGui::Selectable("Bind pose", clip < 0))
+						currentModel.PlayClip(-1);
+					for (size_t i = 0; i < currentModel.NumClips(); i++)
+					{
+						ImGui::PushID((int)i);
+						if (ImGui::Selectable(currentModel.ClipName(i).c_str(), clip == (int)i))
+							currentModel.PlayClip((int)i);
+						ImGui::PopID();
+					}
+					ImGui::EndCombo();
+				}
 			}
 
-			ImGui::EndMenuBar();
-		}
-
-		ImGui::SeparatorText("Model");
-		if (ImGui::Button("Flip Texture"))
-		{
-			flipTexture = !flipTexture;
-			currentModel = Model(currentModelPath.c_str(), flipTexture);
-		}
-
-		ImGui::SeparatorText("Environment");
-		ImGui::ColorEdit3("Background color", glm::value_ptr(clearColor));
-		if (ImGui::Checkbox("Lighting", &lighting))
-		{
-			shaderProgram.Activate();
-			shaderProgram.SetBool("lighting", lighting);
-		}
+			ImGui::SeparatorText("Environment");
+			ImGui::ColorEdit3("Background color", glm::value_ptr(clearColor));
+			ImGui::Checkbox("Lighting", &lighting);
+			if (ImGui::SliderFloat3("Light direction", glm::value_ptr(dirLightDirection), -1.0f, 1.0f)
+				&& glm::length(dirLightDirection) > 0.0f)
+			{
+				dirLight.SetDirection(dirLightDirection);
+				defaultShaders.ForEach([&](Shader& shader) { dirLight.Apply(shader); });
+			}
+			ImGui::Checkbox("Shadows", &shadows);
+			ImGui::Checkbox("Clustered lights", &clusteredLighting);
+			if ((currentShading == SHADING_DEFERRED || clusteredLighting) && ImGui::SliderInt("Point lights", &numPointLights, 0, 4096))
+			{
+				generatePointLights(lights, pointLights, numPointLights);
+			}
 
-		ImGui::SeparatorText("Performance");
-		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+			ImGui::SeparatorText("Performance");
+			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+			if (window)
+			{
+				ImGui::Text("Presented every %.2f ms, input to present %.2f ms (max %.2f), waited %.2f ms", FramePacer::FrameMilliseconds(),
+					FramePacer::LatencyMilliseconds(), FramePacer::MaxLatencyMilliseconds(), FramePacer::WaitMilliseconds());
+				const char* syncModes[] = { "VSync off", "VSync", "Adaptive VSync" };
+				int syncMode = FramePacer::swapInterval < 0 ? 2 : FramePacer::swapInterval;
+				int numSyncModes = FramePacer::AdaptiveSyncSupported() ? 3 : 2;
+				if (ImGui::Combo("Sync", &syncMode, syncModes, numSyncModes))
+				{
+					FramePacer::swapInterval = syncMode == 2 ? -1 : syncMode;
+					FramePacer::Apply();
+				}
+				if (ImGui::InputInt("Frame cap FPS (0 = off)", &FramePacer::targetFps, 10, 30))
+					FramePacer::targetFps = std::max(FramePacer::targetFps, 0);
+				ImGui::Checkbox("Low latency input", &FramePacer::lowLatency);
+				ImGui::Checkbox("Render on demand", &FramePacer::renderOnDemand);
+			}
+			ImGui::Text("GPU memory %.1f MB, CPU geometry %.1f MB, %d objects awaiting deletion", MemoryTracker::GPUBytes() / (1024.0f * 1024.0f),
+				MemoryTracker::TotalBytes(MEMORY_CPU_GEOMETRY) / (1024.0f * 1024.0f), (int)DeletionQueue::NumPending());
+			ImGui::Text("Streamed textures %d (%d loading), %.1f MB resident", TextureStreamer::NumTextures(), TextureStreamer::NumLoading(),
+				TextureStreamer::ResidentBytes() / (1024.0f * 1024.0f));
+			int textureBudget = (int)(TextureStreamer::budgetBytes / (1024 * 1024));
+			if (ImGui::InputInt("Texture budget MB (0 = off)", &textureBudget, 16, 128))
+				TextureStreamer::budgetBytes = (size_t)std::max(textureBudget, 0) * 1024 * 1024;
+			ImGui::Checkbox("Stream textures of loaded models", &TextureStreamer::enabled);
+			const StreamBuffer& drawData = DrawData::Buffer();
+			ImGui::Text("Draw data %s, %.1f KB/frame, %d stalls", drawData.IsPersistent() ? "persistently mapped" : "mapped per write",
+				drawData.FrameBytes() / 1024.0f, drawData.Stalls());
+			if (Animator::NumInstances() > 0)
+			{
+				ImGui::Text("Animated %d skeletons, %d palette entries, posing %.3f ms",
+					(int)Animator::NumInstances(), (int)Animator::NumPaletteEntries(), Animator::PoseMilliseconds());
+			}
+			ImGui::Text("Default shader variants compiled: %d/%d", (int)defaultShaders.NumCompiled(), (int)defaultShaders.NumVariants());
+			const ShaderCacheStats& shaderStats = Shader::CacheStats();
+			ImGui::Text("Programs from cache %d (%.1f ms), from source %d (%.1f ms)",
+				shaderStats.cacheHits, shaderStats.loadMilliseconds, shaderStats.cacheMisses, shaderStats.compileMilliseconds);
+			ImGui::Checkbox("Program binary cache", &Shader::useBinaryCache);
+			if (ImGui::Checkbox("Hot reload shaders", &hotReload))
+			{
+				if (hotReload)
+					ShaderWatcher::Start();
+				else
+					ShaderWatcher::Stop();
+			}
+			if (clusteredLighting && currentShading == SHADING_DEFAULT)
+			{
+				ImGui::Text("Clustered %d lights, %d indices, binning %.3f ms",
+					(int)clusteredLights.NumLights(), (int)clusteredLights.NumLightIndices(), clusteredLights.BinningTime());
+			}
+			if (shadows && currentShading == SHADING_DEFAULT)
+			{
+				ImGui::Text("Shadow cascades rendered %d/%d, casters drawn %d",
+					shadowMap.RenderedCascades(), CascadedShadowMap::NUM_CASCADES, shadowMap.DrawnCasters());
+			}
+			if (currentShading == SHADING_DEFERRED || clusteredLighting)
+			{
+				ImGui::Text("Light upload %.1f KB in %d ranges", lights.UploadedBytes() / 1024.0f, (int)lights.UploadedRanges());
+			}
 
-		ImGui::End();
+			ImGui::End();
 
-		if (showDemoWindow)
-			ImGui::ShowDemoWindow(&showDemoWindow);
-		showMainMenuBar(currentModel, currentModelPath);
+			if (showDemoWindow)
+				ImGui::ShowDemoWindow(&showDemoWindow);
+			if (showProfiler)
+				Profiler::DrawWindow(&showProfiler);
+			if (showMemory)
+				MemoryTracker::DrawWindow(&showMemory);
+			if (showMainMenuBar(currentModel, currentModelPath))
+			{
+				shadowMap.Invalidate();
+				FramePacer::RequestRedraw();
+			}
+		}
 		
 
 
 		// **********************************************************
 		// * SCENE DRAWING SECTION									*
 		// **********************************************************
-		currentModel.Draw(*currentShader, camera);
+		// Swap in programs that finished compiling before any state is applied to them
+		defaultShaders.Poll();
+		depthShaders.Poll();
+
+		if (currentShading == SHADING_DEFERRED)
+		{
+			PROFILE_GPU_SCOPE("Deferred");
+			{
+				PROFILE_SCOPE("Light upload");
+				animatePointLights(lights, pointLights, time);
+				animateSpotLights(lights, spotLights, time);
+				lights.Upload();
+			}
+			dirLight.Apply(deferredRenderer.dirLightShader);
+			deferredRenderer.Render(currentModel, camera, lights);
+		}
+		else if (currentShading == SHADING_DEPTH)
+		{
+			PROFILE_GPU_SCOPE("Depth");
+			currentModel.Draw(depthShaders, camera);
+		}
+		else
+		{
+			PROFILE_GPU_SCOPE("Forward");
+			// Toggles select a specialized program instead of branching on uniforms
+			unsigned int features = 0;
+			if (lighting)
+				features |= FEATURE_LIGHTING;
+			if (lighting && clusteredLighting)
+				features |= FEATURE_CLUSTERED_LIGHTING;
+			if (lighting && shadows)
+				features |= FEATURE_SHADOWS;
+
+			if (features & FEATURE_CLUSTERED_LIGHTING)
+			{
+				{
+					PROFILE_SCOPE("Light upload");
+					animatePointLights(lights, pointLights, time);
+					animateSpotLights(lights, spotLights, time);
+					lights.Upload();
+				}
+				clusteredLights.Update(camera, lights);
+			}
+			if (features & FEATURE_SHADOWS)
+				shadowMap.Render(currentModel, camera, dirLight.GetDirection());
+
+			// Per-frame state goes to the textured and untextured variant of this feature set, and
+			// their skinned versions while the model is animated
+			unsigned int variants[] = { features, features | FEATURE_TEXTURED,
+				features | FEATURE_SKINNING, features | FEATURE_TEXTURED | FEATURE_SKINNING };
+			for (unsigned int variant : variants)
+			{
+				if ((variant & FEATURE_SKINNING) && !currentModel.Animated())
+					continue;
+				Shader& shader = defaultShaders.Get(variant);
+				if (features & FEATURE_CLUSTERED_LIGHTING)
+					clusteredLights.Apply(shader, camera, lights);
+				if (features & FEATURE_SHADOWS)
+					shadowMap.Apply(shader, camera);
+			}
+			PROFILE_GPU_SCOPE("Scene");
+			currentModel.Draw(defaultShaders, features, camera);
+		}
 
 
 
 		// Render ImGui UIs
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		if (useImGui)
+		{
+			PROFILE_GPU_SCOPE("ImGui render");
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
 
 		// Update and Render additional Platform Windows
-		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+		if (useImGui && (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable))
 		{
 			GLFWwindow* backup_current_context = glfwGetCurrentContext();
 			ImGui::UpdatePlatformWindows();
 			ImGui::RenderPlatformWindowsDefault();
 			glfwMakeContextCurrent(backup_current_context);
 		}
+		DrawData::EndFrame();
+		Animator::EndFrame();
+		DeletionQueue::EndFrame();
+		Profiler::EndFrame();
 
-		// Handel camera input
-		if (!io.WantCaptureMouse && !io.WantCaptureKeyboard)
-			camera.ProcessInputs(window);
-		// Setting up matrices for 3D perspective
-		camera.UpdateMatrix(cameraFOV, 0.1f, 100.0f);
+		if (headless.enabled)
+		{
+			// Wait for the GPU so a frame's time includes its rendering, not only its submission
+			glFinish();
+			const BenchmarkScenario& scenario = scenarios[scenarioIndex];
+			if (frame >= scenario.warmupFrames)
+			{
+				frameMilliseconds.push_back(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count());
+				drawCalls += Profiler::DrawCalls();
+				triangles += Profiler::Triangles();
+			}
+			frame++;
 
-		// Check and call events and swap the frame buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+			if (frame == scenario.warmupFrames + scenario.frames)
+			{
+				BenchmarkResult result = summarizeBenchmark(scenario, frameMilliseconds, drawCalls, triangles);
+				result.gpuP50 = Profiler::FramePercentile(0.5f, true);
+				result.gpuP95 = Profiler::FramePercentile(0.95f, true);
+				result.gpuP99 = Profiler::FramePercentile(0.99f, true);
+				result.gpuBytes = MemoryTracker::GPUBytes();
+				result.cpuGeometryBytes = MemoryTracker::TotalBytes(MEMORY_CPU_GEOMETRY);
+				printBenchmarkResult(result, headless);
+				results.push_back(result);
+
+				frame = 0;
+				frameMilliseconds.clear();
+				drawCalls = 0.0;
+				triangles = 0.0;
+				scenarioIndex++;
+			}
+		}
+		else
+		{
+			if (!FramePacer::lowLatency)
+				processCameraInput();
+
+			// Check and call events and swap the frame buffers
+			glfwSwapBuffers(window);
+			// Keeps the CPU from queueing frames ahead of the GPU
+			if (FramePacer::lowLatency)
+				glFinish();
+			FramePacer::Presented();
+			if (!FramePacer::lowLatency)
+				glfwPollEvents();
+		}
+
+		// Startup lasts until the first frame is presented, which includes linking the programs it used
+		if (firstFrame)
+		{
+			const ShaderCacheStats& shaderStats = Shader::CacheStats();
+			std::cout << (shaderStats.cacheMisses == 0 ? "Warm" : "Cold") << " startup: "
+				<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupTime).count() << " ms to first frame, "
+				<< shaderStats.cacheHits << " programs loaded from cache in " << shaderStats.loadMilliseconds << " ms, "
+				<< shaderStats.cacheMisses << " compiled from source in " << shaderStats.compileMilliseconds << " ms" << std::endl;
+			firstFrame = false;
+		}
+	}
+
+
+
+	int exitCode = 0;
+	if (headless.enabled)
+	{
+		MemoryTracker::PrintReport();
+		if (!headless.jsonPath.empty() && writeBenchmarkJson(headless.jsonPath, results, headless))
+			std::cout << "Wrote " << results.size() << " results to " << headless.jsonPath << std::endl;
+		// Regressions fail the run so scripts can stop on them
+		if (!headless.baselinePath.empty() && compareWithBaseline(results, headless.baselinePath, headless.regressionThreshold) != 0)
+			exitCode = 1;
+		if (!headless.tracePath.empty() && Profiler::ExportChromeTrace(headless.tracePath))
+			std::cout << "Wrote " << Profiler::NumResolvedFrames() << " profiled frames to " << headless.tracePath << std::endl;
+		if (!headless.outputPath.empty() && !offscreenTarget.SavePPM(headless.outputPath))
+			std::cout << "Failed to write " << headless.outputPath << std::endl;
+	}
+	else if (!headless.recordCameraPath.empty())
+	{
+		if (cameraPath.Save(headless.recordCameraPath))
+			std::cout << "Recorded " << cameraPath.Duration() << " s of camera path to " << headless.recordCameraPath << std::endl;
+		else
+			std::cout << "Failed to write " << headless.recordCameraPath << std::endl;
 	}
 
 
 
 	// Cleanup ImGui
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
+	if (useImGui)
+		ImGui_ImplOpenGL3_Shutdown();
+	if (window)
+		ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
 
 
 	// Clean up the objects and shader program
-	shaderProgram.Delete();
+	ShaderWatcher::Stop();
+	TextureStreamer::Stop();
+	WorkerPool::Stop();
+	DrawData::Delete();
+	defaultShaders.Delete();
+	depthShaders.Delete();
 	lightShader.Delete();
-
-	glfwDestroyWindow(window);
-	glfwTerminate();
-	return 0;
+	deferredRenderer.Delete();
+	clusteredLights.Delete();
+	lights.Delete();
+	shadowMap.Delete();
+	offscreenTarget.Delete();
+	currentModel.Delete();
+	Animator::Delete();
+	floor.Delete();
+	light.Delete();
+	floorTextureArrays.clear();
+	Profiler::Delete();
+	// Objects still alive are destroyed after the context, they must not touch it anymore
+	DeletionQueue::Shutdown();
+
+	if (window)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+	headlessContext.Destroy();
+	return exitCode;
 }
 
 // Resize viewport whenever the size of the window is changed
@@ -413,6 +1016,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
 	camera.UpdateAspectRatio(width, height);
+	FramePacer::RequestRedraw();
 }
 
 // Adjust FOV by scrolling
@@ -427,8 +1031,18 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 
 
-void showMainMenuBar(Model &model, std::string& currentModelPath)
+shadingMode getShadingMode(const std::string& name)
+{
+	if (name == "depth")
+		return SHADING_DEPTH;
+	if (name == "deferred")
+		return SHADING_DEFERRED;
+	return SHADING_DEFAULT;
+}
+
+bool showMainMenuBar(Model &model, std::string& currentModelPath)
 {
+	bool modelChanged = false;
 	if (ImGui::BeginMainMenuBar())
 	{
 		if (ImGui::BeginMenu("File"))
@@ -442,7 +1056,8 @@ void showMainMenuBar(Model &model, std::string& currentModelPath)
 				{
 					std::replace(outPath, outPath + strlen(outPath), '\\', '/');
 					currentModelPath = outPath;
-					model = Model(outPath);
+					model = Model(outPath, true, model.GeometryResidency());
+					modelChanged = true;
 					free(outPath);
 				}
 				else if (result == NFD_CANCEL) {}
@@ -455,4 +1070,191 @@ void showMainMenuBar(Model &model, std::string& currentModelPath)
 		}
 		ImGui::EndMainMenuBar();
 	}
+	return modelChanged;
+}
+
+void printGeometryResidencyReport()
+{
+	std::vector<std::string> paths;
+	for (const BenchmarkScenario& scenario : benchmarkScenarios())
+	{
+		if (!scenario.modelPath.empty() && std::find(paths.begin(), paths.end(), scenario.modelPath) == paths.end())
+			paths.push_back(scenario.modelPath);
+	}
+
+	// Loading prints as it goes, so the table is collected and printed at the end
+	std::vector<std::string> rows;
+	size_t totals[GEOMETRY_RESIDENCY_COUNT] = {};
+	for (const std::string& path : paths)
+	{
+		size_t before = MemoryTracker::TotalBytes(MEMORY_CPU_GEOMETRY);
+		Model model(path.c_str(), true, GEOMETRY_KEEP);
+		if (model.Empty())
+			continue;
+
+		char row[512];
+		int length = snprintf(row, sizeof(row), "%-56s", path.c_str());
+		for (int i = 0; i < GEOMETRY_RESIDENCY_COUNT; i++)
+		{
+			model.SetGeometryResidency((geometryResidency)i);
+			size_t bytes = MemoryTracker::TotalBytes(MEMORY_CPU_GEOMETRY) - before;
+			totals[i] += bytes;
+			length += snprintf(row + length, sizeof(row) - length, " %10.2f", bytes / (1024.0 * 1024.0));
+		}
+		rows.push_back(row);
+	}
+
+	char line[512];
+	int length = snprintf(line, sizeof(line), "%-56s", "CPU geometry in MB");
+	for (int i = 0; i < GEOMETRY_RESIDENCY_COUNT; i++)
+		length += snprintf(line + length, sizeof(line) - length, " %10s", geometryResidencyName((geometryResidency)i));
+	std::cout << line << std::endl;
+	for (const std::string& row : rows)
+		std::cout << row << std::endl;
+	length = snprintf(line, sizeof(line), "%-56s", "total");
+	for (int i = 0; i < GEOMETRY_RESIDENCY_COUNT; i++)
+		length += snprintf(line + length, sizeof(line) - length, " %10.2f", totals[i] / (1024.0 * 1024.0));
+	std::cout << line << std::endl;
+}
+
+void printLoaderReport()
+{
+	const int RUNS = 5;
+	std::vector<std::string> paths;
+	for (const BenchmarkScenario& scenario : benchmarkScenarios())
+	{
+		size_t extension = scenario.modelPath.find_last_of('.');
+		std::string suffix = extension == std::string::npos ? "" : scenario.modelPath.substr(extension);
+		if ((suffix == ".gltf" || suffix == ".glb" || suffix == ".pmx" || suffix == ".obj") && std::find(paths.begin(), paths.end(), scenario.modelPath) == paths.end())
+			paths.push_back(scenario.modelPath);
+	}
+
+	// Runs alternate between the loaders so both see the same file cache, the median hides
+	// the first cold read
+	bool nativeLoaders = Model::nativeLoaders;
+	std::vector<std::string> rows;
+	for (const std::string& path : paths)
+	{
+		std::vector<float> milliseconds[2];
+		long long peakBytes[2] = {};
+		for (int run = 0; run < RUNS; run++)
+		{
+			for (int loader = 0; loader < 2; loader++)
+			{
+				Model::nativeLoaders = loader == 0;
+				AllocationCounter::ResetPeak();
+				long long liveBytes = AllocationCounter::LiveBytes();
+				auto start = std::chrono::high_resolution_clock::now();
+				Model model(path.c_str());
+				if (!model.Empty())
+					milliseconds[loader].push_back(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+				peakBytes[loader] = std::max(peakBytes[loader], AllocationCounter::PeakBytes() - liveBytes);
+				model.Delete();
+				DeletionQueue::EndFrame();
+			}
+		}
+		if (milliseconds[0].empty() || milliseconds[1].empty())
+			continue;
+
+		float median[2];
+		for (int loader = 0; loader < 2; loader++)
+		{
+			std::sort(milliseconds[loader].begin(), milliseconds[loader].end());
+			median[loader] = milliseconds[loader][milliseconds[loader].size() / 2];
+		}
+		char row[512];
+		snprintf(row, sizeof(row), "%-56s %10.2f %10.2f %9.2fx %10.2f %10.2f", path.c_str(), median[0], median[1], median[1] / std::max(median[0], 0.001f),
+			peakBytes[0] / (1024.0 * 1024.0), peakBytes[1] / (1024.0 * 1024.0));
+		rows.push_back(row);
+	}
+	Model::nativeLoaders = nativeLoaders;
+
+	char line[512];
+	snprintf(line, sizeof(line), "%-56s %10s %10s %10s %10s %10s", "Load time in ms, peak heap in MB", "native", "Assimp", "speedup", "native MB", "Assimp MB");
+	std::cout << line << std::endl;
+	for (const std::string& row : rows)
+		std::cout << row << std::endl;
+}
+
+void generatePointLights(LightManager& lights, std::vector<unsigned int>& handles, int count)
+{
+	for (size_t i = 0; i < handles.size(); i++)
+		lights.Remove(handles[i]);
+	handles.clear();
+	handles.reserve(count);
+
+	// Shrink the light range as the count grows so the overlap per pixel stays similar
+	float quadratic = 75.0f * glm::max(1.0f, count / 256.0f);
+
+	for (int i = 0; i < count; i++)
+	{
+		// Golden angle spiral through a shell around the model
+		float t = (i + 0.5f) / count;
+		float y = 1.0f - 2.0f * t;
+		float ring = glm::sqrt(1.0f - y * y);
+		float angle = i * 2.39996323f;
+		float shell = count > 256 ? 0.4f + glm::fract(i * 0.618034f) : 1.2f;
+		glm::vec3 position = glm::vec3(glm::cos(angle) * ring, y, glm::sin(angle) * ring) * shell;
+
+		glm::vec3 color = glm::vec3(
+			0.5f + 0.5f * glm::cos(angle),
+			0.5f + 0.5f * glm::cos(angle + 2.094f),
+			0.5f + 0.5f * glm::cos(angle + 4.189f)
+		);
+
+		handles.push_back(lights.Add(PointLight(0.0f, 1.0f, 1.0f, position, color, 1.0f, 4.5f, quadratic)));
+	}
+}
+
+void animatePointLights(LightManager& lights, const std::vector<unsigned int>& handles, float time)
+{
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		// Orbit around the vertical axis, alternating direction per light
+		float speed = (i % 2 == 0 ? 0.3f : -0.2f) * (1.0f + (i % 7) * 0.1f);
+		glm::vec3 position = lights.GetPosition(handles[i]);
+		float radius = glm::length(glm::vec2(position.x, position.z));
+		float angle = i * 2.39996323f + time * speed;
+		position.x = glm::cos(angle) * radius;
+		position.z = glm::sin(angle) * radius;
+		lights.SetPosition(handles[i], position);
+	}
+}
+
+void generateSpotLights(LightManager& lights, std::vector<unsigned int>& handles, int count)
+{
+	for (size_t i = 0; i < handles.size(); i++)
+		lights.Remove(handles[i]);
+	handles.clear();
+	handles.reserve(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		// Ring of spot lights above the model, all aimed at the center
+		float angle = i * 2.39996323f;
+		float height = 0.5f + glm::fract(i * 0.618034f);
+		glm::vec3 position = glm::vec3(glm::cos(angle) * 1.5f, height, glm::sin(angle) * 1.5f);
+
+		glm::vec3 color = glm::vec3(
+			0.5f + 0.5f * glm::sin(angle),
+			0.5f + 0.5f * glm::sin(angle + 2.094f),
+			0.5f + 0.5f * glm::sin(angle + 4.189f)
+		);
+
+		handles.push_back(lights.Add(SpotLight(0.0f, 1.0f, 1.0f, position, -glm::normalize(position), color, 1.0f, 4.5f, 40.0f)));
+	}
+}
+
+void animateSpotLights(LightManager& lights, const std::vector<unsigned int>& handles, float time)
+{
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		glm::vec3 position = lights.GetPosition(handles[i]);
+		float radius = glm::length(glm::vec2(position.x, position.z));
+		float angle = i * 2.39996323f + time * 0.25f;
+		position.x = glm::cos(angle) * radius;
+		position.z = glm::sin(angle) * radius;
+		lights.SetPosition(handles[i], position);
+		lights.SetDirection(handles[i], -position);
+	}
 }
\ No newline at end of file
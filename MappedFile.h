@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file through virtual memory. Pages are read on first access and
+// shared with the file cache, so parsing a large file doesn't copy it into a buffer first.
+// Owns the mapping, it can be moved but not copied.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+
+	// An empty file opens with no data
+	bool Open(const std::string& path);
+	void Close();
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,211 @@
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+#include "imgui.h"
+
+size_t MemoryTracker::budgetBytes = 0;
+
+namespace
+{
+	struct Allocation
+	{
+		size_t owner;
+		size_t bytes;
+	};
+
+	const char* categoryNames[MEMORY_CATEGORY_COUNT] = { "Vertex buffers", "Index buffers", "Textures", "CPU geometry" };
+
+	// GL names are only unique within a category
+	std::map<std::pair<int, GLuint>, Allocation> allocations;
+	std::vector<MemoryOwnerStats> owners;
+	std::vector<size_t> ownerStack;
+	size_t totals[MEMORY_CATEGORY_COUNT] = {};
+	bool overBudget = false;
+
+	size_t OwnerIndex(const std::string& owner)
+	{
+		for (size_t i = 0; i < owners.size(); i++)
+			if (owners[i].owner == owner)
+				return i;
+		owners.emplace_back();
+		owners.back().owner = owner;
+		return owners.size() - 1;
+	}
+
+	size_t CurrentOwner()
+	{
+		if (ownerStack.empty())
+			return OwnerIndex("Other");
+		return ownerStack.back();
+	}
+
+	float Megabytes(size_t bytes)
+	{
+		return bytes / (1024.0f * 1024.0f);
+	}
+
+	void CheckBudget()
+	{
+		size_t used = MemoryTracker::GPUBytes();
+		bool exceeded = MemoryTracker::budgetBytes > 0 && used > MemoryTracker::budgetBytes;
+		if (exceeded && !overBudget)
+		{
+			char line[160];
+			snprintf(line, sizeof(line), "WARNING::MEMORY:: GPU memory %.1f MB exceeds the budget of %.1f MB",
+				Megabytes(used), Megabytes(MemoryTracker::budgetBytes));
+			std::cout << line << std::endl;
+		}
+		overBudget = exceeded;
+	}
+}
+
+void MemoryTracker::Allocate(memoryCategory category, GLuint ID, size_t bytes)
+{
+	// A name can be filled again, e.g. glBufferData on an existing buffer
+	Free(category, ID);
+
+	size_t owner = CurrentOwner();
+	allocations[std::make_pair((int)category, ID)] = Allocation{ owner, bytes };
+	owners[owner].bytes[category] += bytes;
+	owners[owner].allocations++;
+	totals[category] += bytes;
+	if (category != MEMORY_CPU_GEOMETRY)
+		CheckBudget();
+}
+
+void MemoryTracker::Free(memoryCategory category, GLuint ID)
+{
+	auto allocation = allocations.find(std::make_pair((int)category, ID));
+	if (allocation == allocations.end())
+		return;
+
+	MemoryOwnerStats& owner = owners[allocation->second.owner];
+	owner.bytes[category] -= allocation->second.bytes;
+	owner.allocations--;
+	totals[category] -= allocation->second.bytes;
+	allocations.erase(allocation);
+	CheckBudget();
+}
+
+void MemoryTracker::Resize(memoryCategory category, GLuint ID, size_t bytes)
+{
+	auto allocation = allocations.find(std::make_pair((int)category, ID));
+	if (allocation == allocations.end())
+		return;
+
+	MemoryOwnerStats& owner = owners[allocation->second.owner];
+	owner.bytes[category] += bytes - allocation->second.bytes;
+	totals[category] += bytes - allocation->second.bytes;
+	allocation->second.bytes = bytes;
+	if (category != MEMORY_CPU_GEOMETRY)
+		CheckBudget();
+}
+
+void MemoryTracker::PushOwner(const std::string& owner)
+{
+	ownerStack.push_back(OwnerIndex(owner));
+}
+
+void MemoryTracker::PopOwner()
+{
+	if (!ownerStack.empty())
+		ownerStack.pop_back();
+}
+
+size_t MemoryTracker::TotalBytes(memoryCategory category)
+{
+	return totals[category];
+}
+
+size_t MemoryTracker::GPUBytes()
+{
+	return totals[MEMORY_VERTEX_BUFFER] + totals[MEMORY_INDEX_BUFFER] + totals[MEMORY_TEXTURE];
+}
+
+std::vector<MemoryOwnerStats> MemoryTracker::Owners()
+{
+	std::vector<MemoryOwnerStats> used;
+	for (const MemoryOwnerStats& owner : owners)
+		if (owner.allocations > 0)
+			used.push_back(owner);
+
+	auto total = [](const MemoryOwnerStats& owner)
+	{
+		size_t bytes = 0;
+		for (size_t categoryBytes : owner.bytes)
+			bytes += categoryBytes;
+		return bytes;
+	};
+	std::sort(used.begin(), used.end(), [&](const MemoryOwnerStats& a, const MemoryOwnerStats& b) { return total(a) > total(b); });
+	return used;
+}
+
+void MemoryTracker::DrawWindow(bool* open)
+{
+	if (!ImGui::Begin("Memory", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (overBudget)
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "GPU memory %.1f MB over budget", Megabytes(GPUBytes()));
+	else
+		ImGui::Text("GPU memory %.1f MB", Megabytes(GPUBytes()));
+	int budgetMegabytes = (int)(budgetBytes / (1024 * 1024));
+	if (ImGui::InputInt("Budget MB (0 = off)", &budgetMegabytes, 64, 256))
+	{
+		budgetBytes = (size_t)std::max(budgetMegabytes, 0) * 1024 * 1024;
+		CheckBudget();
+	}
+	for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+		ImGui::Text("%s: %.2f MB", categoryNames[category], Megabytes(totals[category]));
+
+	ImGui::SeparatorText("Per asset");
+	if (ImGui::BeginTable("Owners", MEMORY_CATEGORY_COUNT + 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Asset");
+		for (const char* name : categoryNames)
+			ImGui::TableSetupColumn(name);
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableHeadersRow();
+		for (const MemoryOwnerStats& owner : Owners())
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(owner.owner.c_str());
+			for (size_t bytes : owner.bytes)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f MB", Megabytes(bytes));
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", (int)owner.allocations);
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+void MemoryTracker::PrintReport()
+{
+	char line[320];
+	snprintf(line, sizeof(line), "Memory: GPU %.2f MB (vertex %.2f, index %.2f, texture %.2f), CPU geometry %.2f MB",
+		Megabytes(GPUBytes()), Megabytes(totals[MEMORY_VERTEX_BUFFER]), Megabytes(totals[MEMORY_INDEX_BUFFER]),
+		Megabytes(totals[MEMORY_TEXTURE]), Megabytes(totals[MEMORY_CPU_GEOMETRY]));
+	std::cout << line << std::endl;
+	for (const MemoryOwnerStats& owner : Owners())
+	{
+		snprintf(line, sizeof(line), "  %-60s vertex %8.2f  index %8.2f  texture %8.2f  CPU %8.2f MB",
+			owner.owner.c_str(), Megabytes(owner.bytes[MEMORY_VERTEX_BUFFER]), Megabytes(owner.bytes[MEMORY_INDEX_BUFFER]),
+			Megabytes(owner.bytes[MEMORY_TEXTURE]), Megabytes(owner.bytes[MEMORY_CPU_GEOMETRY]));
+		std::cout << line << std::endl;
+	}
+	if (overBudget)
+		std::cout << "GPU memory is over the budget of " << Megabytes(budgetBytes) << " MB" << std::endl;
+}
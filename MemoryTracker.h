@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+enum memoryCategory
+{
+	MEMORY_VERTEX_BUFFER,
+	MEMORY_INDEX_BUFFER,
+	MEMORY_TEXTURE,
+	// Copies of vertices and indices that meshes keep in RAM
+	MEMORY_CPU_GEOMETRY,
+	MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryOwnerStats
+{
+	std::string owner;
+	size_t bytes[MEMORY_CATEGORY_COUNT] = {};
+	size_t allocations = 0;
+};
+
+// Records the size of every buffer, texture and CPU geometry copy by category and GL name.
+// Allocations are attributed to the owner that is current when they are made, models set
+// themselves as owner while they load. Sizes of textures are estimates, drivers pad and
+// lay out images as they like.
+class MemoryTracker
+{
+public:
+	// Warns once the GPU categories together exceed this many bytes, 0 disables the budget
+	static size_t budgetBytes;
+
+	static void Allocate(memoryCategory category, GLuint ID, size_t bytes);
+	static void Free(memoryCategory category, GLuint ID);
+	// Changes the size of an allocation and keeps its owner, for textures that stream levels
+	static void Resize(memoryCategory category, GLuint ID, size_t bytes);
+
+	static void PushOwner(const std::string& owner);
+	static void PopOwner();
+
+	static size_t TotalBytes(memoryCategory category);
+	static size_t GPUBytes();
+	// Owners that still hold memory, largest first
+	static std::vector<MemoryOwnerStats> Owners();
+
+	static void DrawWindow(bool* open);
+	static void PrintReport();
+};
+
+// Attributes allocations made during its lifetime to an owner
+class MemoryOwnerScope
+{
+public:
+	MemoryOwnerScope(const std::string& owner) { MemoryTracker::PushOwner(owner); }
+	~MemoryOwnerScope() { MemoryTracker::PopOwner(); }
+};
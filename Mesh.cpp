@@ -1,75 +1,300 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures)
+#include <cstddef>
+
+#include "MemoryTracker.h"
+#include "MeshProcessing.h"
+#include "Profiler.h"
+
+const char* geometryResidencyName(geometryResidency residency)
+{
+	switch (residency)
+	{
+	case GEOMETRY_KEEP: return "keep";
+	case GEOMETRY_COMPACT: return "compact";
+	case GEOMETRY_DISCARD: return "discard";
+	case GEOMETRY_ON_DEMAND: return "on-demand";
+	default: return "unknown";
+	}
+}
+
+bool parseGeometryResidency(const std::string& name, geometryResidency& residency)
+{
+	for (int i = 0; i < GEOMETRY_RESIDENCY_COUNT; i++)
+	{
+		if (name == geometryResidencyName((geometryResidency)i))
+		{
+			residency = (geometryResidency)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures, geometryResidency residency) :
+	vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), residency(residency)
 {
-	Mesh::vertices = vertices;
-	Mesh::indices = indices;
-	Mesh::textures = textures;
+	if (!Mesh::textures.empty())
+		uvDensity = textureCoordinateDensity(Mesh::vertices, Mesh::indices);
+	Upload(true);
+}
 
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, geometryResidency residency) :
+	vertices(std::move(vertices)), indices(std::move(indices)), residency(residency)
+{
+	Upload(false);
+}
+
+Mesh::Mesh(const MeshSource& source, std::vector<Texture> textures, geometryResidency residency) :
+	textures(std::move(textures)), residency(residency)
+{
+	vertexCount = (GLsizei)source.NumVertices();
+	indexCount = (GLsizei)source.NumIndices();
+	if (!Mesh::textures.empty())
+		uvDensity = source.TextureCoordinateDensity();
+
+	// Packed data is copied by the driver, the rest is converted into the mapped buffers.
+	// Mapping an empty range is an error, empty buffers are left unmapped, and only a buffer
+	// that did get mapped is unmapped again.
 	VAO.Bind();
-	VertexBuffer VBO(vertices);
-	EntityBuffer EBO(indices);
-	VAO.LinkAttrib(VBO, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
-	VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
-	VAO.LinkAttrib(VBO, 2, 2, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
-	VAO.Unbind();
-	VBO.Unbind();
-	EBO.Unbind();
+	const void* packedVertices = source.PackedVertices();
+	VBO = VertexBuffer((size_t)vertexCount, packedVertices);
+	if (!packedVertices && vertexCount > 0)
+	{
+		if (Vertex* mapped = VBO.Map(vertexCount))
+		{
+			source.WriteVertices(mapped);
+			VBO.Unmap();
+		}
+	}
+	const void* packedIndices = source.PackedIndices();
+	EBO = EntityBuffer((size_t)indexCount, packedIndices);
+	if (!packedIndices && indexCount > 0)
+	{
+		if (GLuint* mapped = EBO.Map(indexCount))
+		{
+			source.WriteIndices(mapped);
+			EBO.Unmap();
+		}
+	}
+	if (source.HasSkins() && vertexCount > 0)
+	{
+		const VertexSkin* packedSkins = source.PackedSkins();
+		skinVBO = VertexBuffer((size_t)vertexCount, packedSkins);
+		if (!packedSkins)
+		{
+			if (VertexSkin* mapped = skinVBO.MapSkins(vertexCount))
+			{
+				source.WriteSkins(mapped);
+				skinVBO.Unmap();
+			}
+		}
+
+		// The mapped skins can't be read back, so unpacked ones are converted once more
+		std::vector<glm::vec3> skinPositions(vertexCount);
+		source.WritePositions(skinPositions.data());
+		std::vector<VertexSkin> skins;
+		if (!packedSkins)
+		{
+			skins.resize(vertexCount);
+			source.WriteSkins(skins.data());
+			packedSkins = skins.data();
+		}
+		jointBounds = computeJointBounds(skinPositions.data(), packedSkins, (size_t)vertexCount);
+	}
+	MemoryTracker::Allocate(MEMORY_CPU_GEOMETRY, VAO.ID, 0);
+	LinkAttributes(true);
+
+	// The copies the policy keeps are converted from the source too instead of read back
+	if (residency == GEOMETRY_KEEP)
+	{
+		vertices.resize(vertexCount);
+		source.WriteVertices(vertices.data());
+	}
+	if (residency == GEOMETRY_KEEP || residency == GEOMETRY_COMPACT)
+	{
+		indices.resize(indexCount);
+		source.WriteIndices(indices.data());
+	}
+	if (residency == GEOMETRY_COMPACT)
+	{
+		positions.resize(vertexCount);
+		source.WritePositions(positions.data());
+	}
+	TrackMemory();
 }
 
-Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices)
+Mesh& Mesh::operator=(Mesh&& other) noexcept
 {
-	Mesh::vertices = vertices;
-	Mesh::indices = indices;
+	if (this != &other)
+	{
+		Delete();
+		vertices = std::move(other.vertices);
+		indices = std::move(other.indices);
+		positions = std::move(other.positions);
+		textures = std::move(other.textures);
+		VAO = std::move(other.VAO);
+		VBO = std::move(other.VBO);
+		EBO = std::move(other.EBO);
+		skinVBO = std::move(other.skinVBO);
+		jointBounds = std::move(other.jointBounds);
+		uvDensity = other.uvDensity;
+		vertexCount = other.vertexCount;
+		indexCount = other.indexCount;
+		residency = other.residency;
+	}
+	return *this;
+}
 
+void Mesh::Upload(bool textureCoordinates)
+{
 	VAO.Bind();
-	VertexBuffer VBO(vertices);
-	EntityBuffer EBO(indices);
+	VBO = VertexBuffer(vertices);
+	EBO = EntityBuffer(indices);
+	vertexCount = (GLsizei)vertices.size();
+	indexCount = (GLsizei)indices.size();
+	MemoryTracker::Allocate(MEMORY_CPU_GEOMETRY, VAO.ID, 0);
+	LinkAttributes(textureCoordinates);
+	Evict();
+}
+
+void Mesh::LinkAttributes(bool textureCoordinates)
+{
 	VAO.LinkAttrib(VBO, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
 	VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
+	if (textureCoordinates)
+		VAO.LinkAttrib(VBO, 2, 2, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
+	if (skinVBO.ID)
+	{
+		VAO.LinkAttribInteger(skinVBO, 3, 4, GL_UNSIGNED_SHORT, sizeof(VertexSkin), (void*)offsetof(VertexSkin, joints));
+		VAO.LinkAttrib(skinVBO, 4, 4, GL_UNSIGNED_BYTE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, weights), GL_TRUE);
+	}
 	VAO.Unbind();
 	VBO.Unbind();
 	EBO.Unbind();
 }
 
-void Mesh::Draw(
-	Shader& shader,
-	Camera& camera,
-	glm::mat4 matrix
-)
+void Mesh::SetResidency(geometryResidency residency)
 {
-	shader.Activate();
-	VAO.Bind();
-
-	size_t numDiffuse = 0;
-	size_t numSpecular = 0;
+	Mesh::residency = residency;
+	if (residency == GEOMETRY_KEEP)
+		FaultIn();
+	Evict();
+}
 
-	for (size_t i = 0; i < textures.size(); i++)
+void Mesh::FaultIn()
+{
+	if (!VAO.ID)
+		return;
+	// The copy read target leaves the element buffer binding of whatever VAO is bound alone
+	if (vertices.size() != (size_t)vertexCount)
 	{
-		std::string num;
-		std::string name;
-		textureType type = textures[i].type;
+		vertices.resize(vertexCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, VBO.ID);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+	}
+	if (indices.size() != (size_t)indexCount)
+	{
+		indices.resize(indexCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, EBO.ID);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	TrackMemory();
+}
 
-		if (type == DIFFUSE)
-		{
-			num = std::to_string(numDiffuse++);
-			name = "textureDiffuse" + num;
-		}
-		else if (type == SPECULAR)
+void Mesh::Evict()
+{
+	switch (residency)
+	{
+	case GEOMETRY_KEEP:
+		std::vector<glm::vec3>().swap(positions);
+		break;
+	case GEOMETRY_COMPACT:
+		if (positions.size() != (size_t)vertexCount)
 		{
-			num = std::to_string(numSpecular++);
-			name = "textureSpecular" + num;
+			FaultIn();
+			positions.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				positions[i] = vertices[i].position;
 		}
+		std::vector<Vertex>().swap(vertices);
+		break;
+	default:
+		std::vector<Vertex>().swap(vertices);
+		std::vector<GLuint>().swap(indices);
+		std::vector<glm::vec3>().swap(positions);
+		break;
+	}
+	TrackMemory();
+}
 
-		textures[i].Bind(i);
-		textures[i].SetTextureUnit(shader, name.c_str(), i);
+void Mesh::TrackMemory()
+{
+	if (VAO.ID)
+		MemoryTracker::Resize(MEMORY_CPU_GEOMETRY, VAO.ID,
+			vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(GLuint) + positions.capacity() * sizeof(glm::vec3));
+}
+
+void Mesh::Draw(Shader& shader, int drawIndex, int paletteBase)
+{
+	shader.Activate();
+	VAO.Bind();
+
+	// The samplers point to fixed units, a draw only binds the arrays and picks the layers
+	const Texture* diffuse = nullptr;
+	const Texture* specular = nullptr;
+	for (const Texture& texture : textures)
+	{
+		if (texture.type == DIFFUSE && !diffuse)
+			diffuse = &texture;
+		else if (texture.type == SPECULAR && !specular)
+			specular = &texture;
 	}
+	// A missing map reads the other one, like the unset sampler on unit 0 used to
+	if (!diffuse)
+		diffuse = specular;
+	if (!specular)
+		specular = diffuse;
+	if (diffuse)
+	{
+		diffuse->Bind(Texture::DIFFUSE_UNIT);
+		specular->Bind(Texture::SPECULAR_UNIT);
+		shader.SetInt("diffuseLayer", diffuse->layer);
+		shader.SetInt("specularLayer", specular->layer);
+	}
+
+	shader.SetInt("drawIndex", drawIndex);
+	if (paletteBase >= 0)
+		shader.SetInt("paletteBase", paletteBase);
 
-	shader.SetVec3("cameraPosition", camera.Position);
-	camera.SetShaderMatrix(shader, "camera");
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	Profiler::CountDraw(indexCount / 3);
+}
 
-	shader.SetMat4("model", matrix);
+void Mesh::DrawDepth(Shader& shader, int drawIndex, int paletteBase)
+{
+	shader.SetInt("drawIndex", drawIndex);
+	if (paletteBase >= 0)
+		shader.SetInt("paletteBase", paletteBase);
 
+	VAO.Bind();
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	Profiler::CountDraw(indexCount / 3);
+}
 
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+void Mesh::Delete()
+{
+	if (VAO.ID)
+		MemoryTracker::Free(MEMORY_CPU_GEOMETRY, VAO.ID);
+	VAO.Delete();
+	VBO.Delete();
+	EBO.Delete();
+	skinVBO.Delete();
+	std::vector<Vertex>().swap(vertices);
+	std::vector<GLuint>().swap(indices);
+	std::vector<glm::vec3>().swap(positions);
+	std::vector<JointBounds>().swap(jointBounds);
+	vertexCount = 0;
+	indexCount = 0;
 }
\ No newline at end of file
@@ -2,25 +2,87 @@
 
 #include <string>
 
+#include "Animation.h"
 #include "VertexArray.h"
 #include "EntityBuffer.h"
 #include "Camera.h"
 #include "Texture.h"
 
+class MeshSource;
+
+// What a mesh keeps of its geometry in RAM once the buffers are uploaded
+enum geometryResidency
+{
+	// Vertices and indices, as loaded
+	GEOMETRY_KEEP,
+	// Positions and indices only, enough for picking and culling
+	GEOMETRY_COMPACT,
+	// Nothing, the buffers are the only copy
+	GEOMETRY_DISCARD,
+	// Nothing until FaultIn reads the geometry back from the buffers, Evict drops it again
+	GEOMETRY_ON_DEMAND,
+	GEOMETRY_RESIDENCY_COUNT
+};
+
+const char* geometryResidencyName(geometryResidency residency);
+// Accepts the names above in lower case, returns false for anything else
+bool parseGeometryResidency(const std::string& name, geometryResidency& residency);
+
+// Owns its vertex array, buffers and CPU copies of the geometry, it can be moved but not copied
 class Mesh
 {
 public:
+	// Empty unless the residency policy keeps them or FaultIn brought them back
 	std::vector <Vertex> vertices;
 	std::vector <GLuint> indices;
+	// Filled by GEOMETRY_COMPACT instead of vertices
+	std::vector <glm::vec3> positions;
 	std::vector <Texture> textures;
+	// Sizes of the buffers, valid whatever the policy left in RAM
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	geometryResidency residency = GEOMETRY_KEEP;
 
 	VertexArray VAO;
+	// Only referenced by the VAO, kept to free them in Delete
+	VertexBuffer VBO;
+	EntityBuffer EBO;
+	// Joints and weights of skinned meshes, see VertexSkin, otherwise empty
+	VertexBuffer skinVBO;
+	// Local boxes of the palette entries the skins use, for bounds in the current pose
+	std::vector<JointBounds> jointBounds;
+	// UV units per unit of local length, decides which texture levels get streamed in
+	float uvDensity = 0.0f;
+
+	// Takes over the vectors, pass them with std::move unless the caller still needs them
+	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures, geometryResidency residency = GEOMETRY_KEEP);
+	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, geometryResidency residency = GEOMETRY_KEEP);
+	// Writes the source straight into the mapped buffers, only the copies the policy keeps are
+	// allocated on the heap
+	Mesh(const MeshSource& source, std::vector<Texture> textures, geometryResidency residency);
+	Mesh(Mesh&& other) = default;
+	Mesh& operator=(Mesh&& other) noexcept;
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	~Mesh() { Delete(); }
+	// Matrices come from the draw data at drawIndex, the camera is already set on the shader.
+	// Skinned variants read their joints from the palette at paletteBase.
+	void Draw(Shader& shader, int drawIndex, int paletteBase = -1);
+	// Geometry only, for depth passes whose view-projection is already set on the active shader
+	void DrawDepth(Shader& shader, int drawIndex, int paletteBase = -1);
+	// Applies a policy, fetching the geometry back from the buffers if it keeps more than now
+	void SetResidency(geometryResidency residency);
+	// Makes vertices and indices available whatever the policy, reading them back from the
+	// buffers if they were dropped. Blocks until the GPU is done writing the buffers.
+	void FaultIn();
+	// Drops whatever the policy does not keep, for example after a FaultIn
+	void Evict();
+	// Frees the buffers and the CPU copies early, textures belong to the model and stay
+	void Delete();
+	bool Skinned() const { return skinVBO.ID != 0; }
 
-	Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures);
-	Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices);
-	void Draw(
-		Shader& shader,
-		Camera& camera,
-		glm::mat4 matrix = glm::mat4(1.0f)
-	);
+private:
+	void Upload(bool textureCoordinates);
+	void LinkAttributes(bool textureCoordinates);
+	void TrackMemory();
 };
\ No newline at end of file
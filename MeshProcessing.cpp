@@ -0,0 +1,405 @@
+#include "MeshProcessing.h"
+
+#include <cfloat>
+#include <cmath>
+
+#include "Animation.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MESH_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles any intrinsic without flags
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "the kernels read aiVector3D as three floats");
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "the kernels write a Vertex as eight floats");
+
+static simdLevel detectSimdLevel()
+{
+#ifdef MESH_SIMD_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	// AVX registers also need the operating system to save them, which OSXSAVE and XCR0 tell
+	bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osSavesAvx)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	// Checks the operating system support of AVX registers as well
+	__builtin_cpu_init();
+	bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+	bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+	if (avx2)
+		return SIMD_AVX2;
+	if (sse41)
+		return SIMD_SSE41;
+#endif
+	return SIMD_SCALAR;
+}
+
+static simdLevel& currentSimdLevel()
+{
+	static simdLevel level = supportedSimdLevel();
+	return level;
+}
+
+simdLevel supportedSimdLevel()
+{
+	static simdLevel level = detectSimdLevel();
+	return level;
+}
+
+simdLevel activeSimdLevel()
+{
+	return currentSimdLevel();
+}
+
+void useSimdLevel(simdLevel level)
+{
+	currentSimdLevel() = level < supportedSimdLevel() ? level : supportedSimdLevel();
+}
+
+const char* simdLevelName(simdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE41: return "SSE4.1";
+	case SIMD_AVX2: return "AVX2";
+	default: return "scalar";
+	}
+}
+
+static void convertVerticesScalar(const aiVector3D* positions, const aiVector3D* normals, const aiVector3D* uvs, size_t begin, size_t end, Vertex* out)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		// Process vertex position, normals and texture coordinates
+		Vertex vertex;
+		vertex.position = glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+		vertex.normal = glm::vec3(normals[i].x, normals[i].y, normals[i].z);
+		vertex.texureUV = uvs ? glm::vec2(uvs[i].x, uvs[i].y) : glm::vec2(0.0f);
+		out[i] = vertex;
+	}
+}
+
+static void boundsScalar(const aiVector3D* positions, size_t begin, size_t end, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		glm::vec3 position(positions[i].x, positions[i].y, positions[i].z);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+}
+
+// Folds lanes of accumulators that ran over whole groups of xyz triples, lane k holds
+// component k % 3
+static void foldBounds(const float* mins, const float* maxs, int lanes, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	for (int k = 0; k < lanes; k++)
+	{
+		boundsMin[k % 3] = std::fmin(boundsMin[k % 3], mins[k]);
+		boundsMax[k % 3] = std::fmax(boundsMax[k % 3], maxs[k]);
+	}
+}
+
+#ifdef MESH_SIMD_X86
+// The 16 byte loads of a position or normal read one float of the next vertex, so the last
+// vertex goes through the scalar loop
+TARGET_SSE41 static void convertVerticesSse41(const aiVector3D* positions, const aiVector3D* normals, const aiVector3D* uvs, size_t count, Vertex* out)
+{
+	size_t end = count > 0 ? count - 1 : 0;
+	__m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < end; i++)
+	{
+		__m128 position = _mm_loadu_ps(&positions[i].x);
+		__m128 normal = _mm_loadu_ps(&normals[i].x);
+		__m128 uv = uvs ? _mm_castpd_ps(_mm_load_sd((const double*)&uvs[i].x)) : zero;
+		// position xyz, normal x | normal yz, uv
+		__m128 low = _mm_blend_ps(position, _mm_shuffle_ps(normal, normal, _MM_SHUFFLE(0, 0, 0, 0)), 0x8);
+		__m128 high = _mm_shuffle_ps(normal, uv, _MM_SHUFFLE(1, 0, 2, 1));
+		float* vertex = (float*)&out[i];
+		_mm_storeu_ps(vertex, low);
+		_mm_storeu_ps(vertex + 4, high);
+	}
+	convertVerticesScalar(positions, normals, uvs, end, count, out);
+}
+
+// A vertex is one 32 byte store, assembled with a cross-lane permute
+TARGET_AVX2 static void convertVerticesAvx2(const aiVector3D* positions, const aiVector3D* normals, const aiVector3D* uvs, size_t count, Vertex* out)
+{
+	size_t end = count > 0 ? count - 1 : 0;
+	__m256i order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	__m256 zero = _mm256_setzero_ps();
+	for (size_t i = 0; i < end; i++)
+	{
+		__m256 pair = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&positions[i].x)), _mm_loadu_ps(&normals[i].x), 1);
+		__m256 packed = _mm256_permutevar8x32_ps(pair, order);
+		__m256 uv = uvs ? _mm256_castpd_ps(_mm256_broadcast_sd((const double*)&uvs[i].x)) : zero;
+		_mm256_storeu_ps((float*)&out[i], _mm256_blend_ps(packed, uv, 0xC0));
+	}
+	convertVerticesScalar(positions, normals, uvs, end, count, out);
+}
+
+// Four positions are three loads, each accumulator lane sees one fixed component
+TARGET_SSE41 static void boundsSse41(const aiVector3D* positions, size_t count, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	const float* floats = &positions[0].x;
+	__m128 min[3], max[3];
+	for (int j = 0; j < 3; j++)
+	{
+		min[j] = _mm_set1_ps(FLT_MAX);
+		max[j] = _mm_set1_ps(-FLT_MAX);
+	}
+	size_t end = count / 4 * 4;
+	for (size_t i = 0; i < end; i += 4)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			__m128 values = _mm_loadu_ps(floats + i * 3 + j * 4);
+			min[j] = _mm_min_ps(min[j], values);
+			max[j] = _mm_max_ps(max[j], values);
+		}
+	}
+	float mins[12], maxs[12];
+	for (int j = 0; j < 3; j++)
+	{
+		_mm_storeu_ps(mins + j * 4, min[j]);
+		_mm_storeu_ps(maxs + j * 4, max[j]);
+	}
+	foldBounds(mins, maxs, 12, boundsMin, boundsMax);
+	boundsScalar(positions, end, count, boundsMin, boundsMax);
+}
+
+TARGET_AVX2 static void boundsAvx2(const aiVector3D* positions, size_t count, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	const float* floats = &positions[0].x;
+	__m256 min[3], max[3];
+	for (int j = 0; j < 3; j++)
+	{
+		min[j] = _mm256_set1_ps(FLT_MAX);
+		max[j] = _mm256_set1_ps(-FLT_MAX);
+	}
+	size_t end = count / 8 * 8;
+	for (size_t i = 0; i < end; i += 8)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			__m256 values = _mm256_loadu_ps(floats + i * 3 + j * 8);
+			min[j] = _mm256_min_ps(min[j], values);
+			max[j] = _mm256_max_ps(max[j], values);
+		}
+	}
+	float mins[24], maxs[24];
+	for (int j = 0; j < 3; j++)
+	{
+		_mm256_storeu_ps(mins + j * 8, min[j]);
+		_mm256_storeu_ps(maxs + j * 8, max[j]);
+	}
+	foldBounds(mins, maxs, 24, boundsMin, boundsMax);
+	boundsScalar(positions, end, count, boundsMin, boundsMax);
+}
+#endif
+
+void convertMeshVertices(const aiMesh* mesh, std::vector<Vertex>& vertices)
+{
+	size_t first = vertices.size();
+	vertices.resize(first + mesh->mNumVertices);
+	writeMeshVertices(mesh, vertices.data() + first);
+}
+
+void convertMeshIndices(const aiMesh* mesh, std::vector<GLuint>& indices)
+{
+	size_t first = indices.size();
+	indices.resize(first + countMeshIndices(mesh));
+	writeMeshIndices(mesh, indices.data() + first);
+}
+
+size_t countMeshIndices(const aiMesh* mesh)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < mesh->mNumFaces; i++)
+		count += mesh->mFaces[i].mNumIndices;
+	return count;
+}
+
+void writeMeshVertices(const aiMesh* mesh, Vertex* out)
+{
+	const aiVector3D* uvs = mesh->mTextureCoords[0];
+	size_t count = mesh->mNumVertices;
+#ifdef MESH_SIMD_X86
+	if (activeSimdLevel() == SIMD_AVX2)
+		return convertVerticesAvx2(mesh->mVertices, mesh->mNormals, uvs, count, out);
+	if (activeSimdLevel() == SIMD_SSE41)
+		return convertVerticesSse41(mesh->mVertices, mesh->mNormals, uvs, count, out);
+#endif
+	convertVerticesScalar(mesh->mVertices, mesh->mNormals, uvs, 0, count, out);
+}
+
+size_t AssimpMeshSource::NumVertices() const
+{
+	return mesh->mNumVertices;
+}
+
+size_t AssimpMeshSource::NumIndices() const
+{
+	return countMeshIndices(mesh);
+}
+
+void AssimpMeshSource::WriteVertices(Vertex* out) const
+{
+	writeMeshVertices(mesh, out);
+}
+
+void AssimpMeshSource::WritePositions(glm::vec3* out) const
+{
+	for (size_t i = 0; i < mesh->mNumVertices; i++)
+		out[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+}
+
+void AssimpMeshSource::WriteIndices(GLuint* out) const
+{
+	writeMeshIndices(mesh, out);
+}
+
+float AssimpMeshSource::TextureCoordinateDensity() const
+{
+	return textureCoordinateDensity(mesh);
+}
+
+void AssimpMeshSource::WriteSkins(VertexSkin* out) const
+{
+	// Assimp lists the weights by bone, a vertex can be in any number of them
+	std::vector<JointInfluences> influences(mesh->mNumVertices);
+	for (size_t i = 0; i < mesh->mNumBones; i++)
+	{
+		const aiBone* bone = mesh->mBones[i];
+		for (size_t j = 0; j < bone->mNumWeights; j++)
+		{
+			const aiVertexWeight& weight = bone->mWeights[j];
+			if (weight.mVertexId < mesh->mNumVertices)
+				influences[weight.mVertexId].Add(bonePalette[i], weight.mWeight);
+		}
+	}
+	for (size_t i = 0; i < mesh->mNumVertices; i++)
+		out[i] = influences[i].Pack();
+}
+
+void writeMeshIndices(const aiMesh* mesh, GLuint* out)
+{
+	for (size_t i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		for (size_t j = 0; j < face.mNumIndices; j++)
+			*out++ = face.mIndices[j];
+	}
+}
+
+void computeMeshBounds(const aiVector3D* positions, size_t count, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	if (count == 0)
+	{
+		boundsMin = boundsMax = glm::vec3(0.0f);
+		return;
+	}
+#ifdef MESH_SIMD_X86
+	if (activeSimdLevel() == SIMD_AVX2)
+		return boundsAvx2(positions, count, boundsMin, boundsMax);
+	if (activeSimdLevel() == SIMD_SSE41)
+		return boundsSse41(positions, count, boundsMin, boundsMax);
+#endif
+	boundsScalar(positions, 0, count, boundsMin, boundsMax);
+}
+
+void transformBounds(const glm::mat4& matrix, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	// Every corner is the center plus or minus each column times the extent, so the box around
+	// all 8 is the transformed center plus or minus the absolute columns times the extent
+	glm::vec3 center = glm::vec3(matrix * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+	glm::vec3 extent = (localMax - localMin) * 0.5f;
+	glm::vec3 halfSize = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y + glm::abs(glm::vec3(matrix[2])) * extent.z;
+	boundsMin = center - halfSize;
+	boundsMax = center + halfSize;
+}
+
+void accumulateBounds(const glm::mat4& matrix, const glm::vec3& meshMin, const glm::vec3& meshMax, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	glm::vec3 min, max;
+	transformBounds(matrix, meshMin, meshMax, min, max);
+	boundsMin = glm::min(boundsMin, min);
+	boundsMax = glm::max(boundsMax, max);
+}
+
+glm::mat3 normalMatrix(const glm::mat4& model)
+{
+	return glm::mat3(glm::transpose(glm::inverse(model)));
+}
+
+void TriangleAreas::Add(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec2& uvA, const glm::vec2& uvB, const glm::vec2& uvC)
+{
+	// Twice the areas, the factor cancels in the ratio
+	position += glm::length(glm::cross(b - a, c - a));
+	glm::vec2 uvEdge0 = uvB - uvA;
+	glm::vec2 uvEdge1 = uvC - uvA;
+	uv += std::abs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x);
+}
+
+float TriangleAreas::Density() const
+{
+	if (position <= 0.0 || uv <= 0.0)
+		return 0.0f;
+	return (float)std::sqrt(uv / position);
+}
+
+float textureCoordinateDensity(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+	TriangleAreas areas;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vertex& a = vertices[indices[i]];
+		const Vertex& b = vertices[indices[i + 1]];
+		const Vertex& c = vertices[indices[i + 2]];
+		areas.Add(a.position, b.position, c.position, a.texureUV, b.texureUV, c.texureUV);
+	}
+	return areas.Density();
+}
+
+float textureCoordinateDensity(const aiMesh* mesh)
+{
+	const aiVector3D* uvs = mesh->mTextureCoords[0];
+	if (!uvs)
+		return 0.0f;
+
+	TriangleAreas areas;
+	for (size_t i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3)
+			continue;
+		const unsigned int* v = face.mIndices;
+		areas.Add(
+			glm::vec3(mesh->mVertices[v[0]].x, mesh->mVertices[v[0]].y, mesh->mVertices[v[0]].z),
+			glm::vec3(mesh->mVertices[v[1]].x, mesh->mVertices[v[1]].y, mesh->mVertices[v[1]].z),
+			glm::vec3(mesh->mVertices[v[2]].x, mesh->mVertices[v[2]].y, mesh->mVertices[v[2]].z),
+			glm::vec2(uvs[v[0]].x, uvs[v[0]].y), glm::vec2(uvs[v[1]].x, uvs[v[1]].y), glm::vec2(uvs[v[2]].x, uvs[v[2]].y));
+	}
+	return areas.Density();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <assimp/mesh.h>
+
+#include <vector>
+
+#include "VertexBuffer.h"
+
+// CPU side of turning assimp meshes into vertices, indices and bounds. It needs neither GL
+// nor the importer, so the micro benchmarks can run it on synthetic meshes.
+//
+// Vertex conversion and position bounds run SSE4.1 or AVX2 kernels on x86 CPUs that have
+// them, picked once at runtime, and a scalar loop anywhere else.
+
+enum simdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2
+};
+
+// Best level the CPU and operating system support
+simdLevel supportedSimdLevel();
+// Level the kernels use, the supported one unless lowered with useSimdLevel
+simdLevel activeSimdLevel();
+// Clamps to the supported level, for benchmarks and for comparing the kernels
+void useSimdLevel(simdLevel level);
+const char* simdLevelName(simdLevel level);
+
+// Geometry of one mesh as a loader has it. Meshes are built from it by writing straight into
+// mapped buffers and into the CPU copies their residency policy keeps.
+class MeshSource
+{
+public:
+	virtual ~MeshSource() {}
+	virtual size_t NumVertices() const = 0;
+	virtual size_t NumIndices() const = 0;
+	// Write NumVertices vertices or positions and NumIndices indices, only writing to out
+	virtual void WriteVertices(Vertex* out) const = 0;
+	virtual void WritePositions(glm::vec3* out) const = 0;
+	virtual void WriteIndices(GLuint* out) const = 0;
+	// See textureCoordinateDensity
+	virtual float TextureCoordinateDensity() const = 0;
+	// Data already laid out as Vertex or GLuint arrays, uploaded without conversion, or null
+	virtual const void* PackedVertices() const { return nullptr; }
+	virtual const void* PackedIndices() const { return nullptr; }
+	// Skinned meshes write NumVertices skins, see VertexSkin
+	virtual bool HasSkins() const { return false; }
+	virtual void WriteSkins(VertexSkin*) const {}
+	virtual const VertexSkin* PackedSkins() const { return nullptr; }
+};
+
+// Position, normal and the first UV channel of an assimp mesh. With a palette entry for every
+// bone of the mesh its bone weights become vertex skins.
+class AssimpMeshSource : public MeshSource
+{
+public:
+	explicit AssimpMeshSource(const aiMesh* mesh, const int* bonePalette = nullptr) : mesh(mesh), bonePalette(bonePalette) {}
+	size_t NumVertices() const override;
+	size_t NumIndices() const override;
+	void WriteVertices(Vertex* out) const override;
+	void WritePositions(glm::vec3* out) const override;
+	void WriteIndices(GLuint* out) const override;
+	float TextureCoordinateDensity() const override;
+	bool HasSkins() const override { return bonePalette && mesh->HasBones(); }
+	void WriteSkins(VertexSkin* out) const override;
+
+private:
+	const aiMesh* mesh;
+	const int* bonePalette;
+};
+
+// Sums of triangle areas in local and UV space, for texture coordinate densities
+struct TriangleAreas
+{
+	double position = 0.0;
+	double uv = 0.0;
+
+	void Add(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec2& uvA, const glm::vec2& uvB, const glm::vec2& uvC);
+	// UV units per unit of length, zero without any area
+	float Density() const;
+};
+
+// Appends position, normal and the first UV channel of every vertex
+void convertMeshVertices(const aiMesh* mesh, std::vector<Vertex>& vertices);
+void convertMeshIndices(const aiMesh* mesh, std::vector<GLuint>& indices);
+// Number of indices over all faces, the size convertMeshIndices appends
+size_t countMeshIndices(const aiMesh* mesh);
+// Write mNumVertices vertices or countMeshIndices indices to out, for example into a mapped
+// buffer. Only writes, so out may be write-combined memory.
+void writeMeshVertices(const aiMesh* mesh, Vertex* out);
+void writeMeshIndices(const aiMesh* mesh, GLuint* out);
+// Smallest box around the given positions, both corners are zero for an empty mesh
+void computeMeshBounds(const aiVector3D* positions, size_t count, glm::vec3& boundsMin, glm::vec3& boundsMax);
+// Box around all 8 corners of a local box transformed by an affine matrix
+void transformBounds(const glm::mat4& matrix, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& boundsMin, glm::vec3& boundsMax);
+// Grows the bounds by a mesh's local box placed with the node matrix
+void accumulateBounds(const glm::mat4& matrix, const glm::vec3& meshMin, const glm::vec3& meshMax, glm::vec3& boundsMin, glm::vec3& boundsMax);
+// UV units per unit of length in local space, from the areas of all triangles in both spaces.
+// Zero for meshes without texture coordinates.
+float textureCoordinateDensity(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+// The same straight from the triangles of an assimp mesh
+float textureCoordinateDensity(const aiMesh* mesh);
+// Transforms normals with the model matrix without skewing them under non-uniform scale
+glm::mat3 normalMatrix(const glm::mat4& model);
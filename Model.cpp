@@ -1,129 +1,767 @@
 #include "Model.h"
 
-Model::Model(const char* path, bool flipTexture)
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <unordered_map>
+
+#include "AllocationCounter.h"
+#include "DrawData.h"
+#include "Gltf.h"
+#include "Obj.h"
+#include "Pmx.h"
+#include "MemoryTracker.h"
+#include "MeshProcessing.h"
+#include "TextureStreamer.h"
+
+bool Model::nativeLoaders = true;
+const int Model::MAX_NODE_DEPTH;
+
+Model::Model(const char* path, bool flipTexture, geometryResidency residency) :
+	residency(residency)
 {
 	LoadModel(path, flipTexture);
 }
 
-void Model::Draw(Shader& shader, Camera& camera, float scale)
+void Model::Draw(ShaderPermutations& shaders, Camera& camera)
+{
+	DrawMeshes(shaders, 0, false, camera);
+}
+
+void Model::Draw(ShaderPermutations& shaders, unsigned int features, Camera& camera)
+{
+	DrawMeshes(shaders, features, true, camera);
+}
+
+void Model::DrawMeshes(ShaderPermutations& shaders, unsigned int features, bool textured, Camera& camera)
+{
+	UploadDrawData();
+	DrawData::Bind();
+	// Skinned meshes draw as they were bound until the animator posed them in this frame
+	int paletteBase = animation.PaletteBase();
+	if (paletteBase >= 0)
+		Animator::Bind();
+	unsigned int variants[] = { features & ~FEATURE_TEXTURED, features | FEATURE_TEXTURED,
+		(features & ~FEATURE_TEXTURED) | FEATURE_SKINNING, features | FEATURE_TEXTURED | FEATURE_SKINNING };
+	for (unsigned int variant : variants)
+	{
+		if (((variant & FEATURE_SKINNING) && paletteBase < 0) || (!textured && (variant & FEATURE_TEXTURED)))
+			continue;
+		Shader& shader = shaders.Get(variant);
+		shader.Activate();
+		shader.SetVec3("cameraPosition", camera.Position);
+		camera.SetShaderMatrix(shader, "camera");
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		unsigned int meshFeatures = features;
+		if (textured)
+			meshFeatures = meshes[i].textures.empty() ? features & ~FEATURE_TEXTURED : features | FEATURE_TEXTURED;
+		if (paletteBase >= 0 && meshes[i].Skinned())
+		{
+			meshes[i].Draw(shaders.Get(meshFeatures | FEATURE_SKINNING), drawBase + (int)i, paletteBase);
+			continue;
+		}
+		meshes[i].Draw(shaders.Get(meshFeatures), drawBase + (int)i);
+	}
+}
+
+size_t Model::DrawShadowCasters(ShaderPermutations& shaders, const glm::mat4& lightSpace, const glm::mat4& lightView, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
 {
+	size_t drawn = 0;
+	UploadDrawData();
+	DrawData::Bind();
+	int paletteBase = animation.PaletteBase();
+	const glm::mat4* joints = animation.JointMatrices();
+	if (paletteBase >= 0)
+	{
+		Animator::Bind();
+		Shader& skinnedShader = shaders.Get(FEATURE_SKINNING);
+		skinnedShader.Activate();
+		skinnedShader.SetMat4("lightSpace", lightSpace);
+	}
+	Shader& shader = shaders.Get(0);
+	shader.Activate();
+	shader.SetMat4("lightSpace", lightSpace);
+	Shader* active = &shader;
 	for (size_t i = 0; i < meshes.size(); i++)
 	{
 		glm::mat4 objectModelMatrix = transformation * matrices[i];
-		objectModelMatrix = glm::scale(objectModelMatrix, glm::vec3(scale));
+		bool posed = paletteBase >= 0 && joints && meshes[i].Skinned();
+
+		// Light space bounds of the mesh from all 8 corners of its local box, posed skinned
+		// meshes are wherever their joints moved them
+		glm::vec3 meshMin = meshAabbMin[i];
+		glm::vec3 meshMax = meshAabbMax[i];
+		if (posed)
+			posedBounds(*skeleton, joints, meshes[i].jointBounds, meshMin, meshMax);
+		glm::vec3 casterMin, casterMax;
+		transformBounds(lightView * objectModelMatrix, meshMin, meshMax, casterMin, casterMax);
 
-		// Set the normal matrix in the shader to calculate the proper normal direction
-		shader.SetMat3("normalMatrix", glm::mat3(glm::transpose(glm::inverse(objectModelMatrix))));
+		// Casters may lie anywhere towards the light, so only the far side bounds the z test
+		if (casterMax.x < boundsMin.x || casterMin.x > boundsMax.x ||
+			casterMax.y < boundsMin.y || casterMin.y > boundsMax.y ||
+			casterMax.z < boundsMin.z)
+			continue;
+
+		Shader& meshShader = posed ? shaders.Get(FEATURE_SKINNING) : shader;
+		if (&meshShader != active)
+		{
+			meshShader.Activate();
+			active = &meshShader;
+		}
+		meshes[i].DrawDepth(meshShader, drawBase + (int)i, posed ? paletteBase : -1);
+		drawn++;
+	}
+	return drawn;
+}
+
+void Model::UploadDrawData()
+{
+	// Every draw of the model in this frame shares one upload
+	if (drawDataEpoch == DrawData::Epoch() || meshes.empty())
+		return;
+
+	glm::vec4* texels = DrawData::Allocate(meshes.size(), drawBase);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		glm::mat4 objectModelMatrix = transformation * matrices[i];
+		glm::mat3 objectNormalMatrix = normalMatrix(objectModelMatrix);
+		for (int column = 0; column < 4; column++)
+			texels[column] = objectModelMatrix[column];
+		for (int column = 0; column < 3; column++)
+			texels[4 + column] = glm::vec4(objectNormalMatrix[column], 0.0f);
+		texels += DrawData::TEXELS_PER_DRAW;
+	}
+	DrawData::Commit();
+	// Read after Allocate, growing the buffer starts a new epoch
+	drawDataEpoch = DrawData::Epoch();
+}
+
+// Tests a view space sphere against the sides, the near and the far plane of the view
+static bool sphereInView(const glm::vec3& center, float radius, const Camera& camera)
+{
+	float tanHalfY = std::tan(glm::radians(camera.FOVdeg) * 0.5f);
+	float tanHalfX = tanHalfY * camera.width / camera.height;
+	if (center.z - radius > -camera.nearPlane || center.z + radius < -camera.farPlane)
+		return false;
+	// Side planes pass through the eye, their normals point out of the view
+	float sideX = (std::abs(center.x) + center.z * tanHalfX) / std::sqrt(1.0f + tanHalfX * tanHalfX);
+	float sideY = (std::abs(center.y) + center.z * tanHalfY) / std::sqrt(1.0f + tanHalfY * tanHalfY);
+	return sideX < radius && sideY < radius;
+}
+
+void Model::RequestTextureLevels(const Camera& camera)
+{
+	// Pixels that one unit of length covers at a distance of one
+	float pixelsPerUnit = camera.height / (2.0f * std::tan(glm::radians(camera.FOVdeg) * 0.5f));
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].textures.empty() || meshes[i].uvDensity <= 0.0f)
+			continue;
+
+		glm::mat4 objectModelMatrix = transformation * matrices[i];
+		float scale = std::max(glm::length(glm::vec3(objectModelMatrix[0])),
+			std::max(glm::length(glm::vec3(objectModelMatrix[1])), glm::length(glm::vec3(objectModelMatrix[2]))));
+		glm::vec3 center = glm::vec3(camera.viewMatrix * objectModelMatrix * glm::vec4((meshAabbMin[i] + meshAabbMax[i]) * 0.5f, 1.0f));
+		float radius = glm::length(meshAabbMax[i] - meshAabbMin[i]) * 0.5f * scale;
+		if (!sphereInView(center, radius, camera))
+			continue;
+
+		// The closest point of the mesh decides, the texels there are the largest on screen
+		float distance = std::max(glm::length(center) - radius, camera.nearPlane);
+		float uvPerPixel = meshes[i].uvDensity / scale * distance / pixelsPerUnit;
+		for (Texture& texture : meshes[i].textures)
+			TextureStreamer::Request(texture.ID, uvPerPixel);
+	}
+}
+
+void Model::SetGeometryResidency(geometryResidency residency)
+{
+	Model::residency = residency;
+	for (Mesh& mesh : meshes)
+		mesh.SetResidency(residency);
+}
 
-		meshes[i].Draw(shader, camera, objectModelMatrix);
+void Model::PlayClip(int clip)
+{
+	if (clip < 0 || (size_t)clip >= clips.size() || !skeleton)
+	{
+		animation.Delete();
+		currentClip = -1;
+		return;
 	}
+	if (animation.ID < 0)
+		animation = AnimationInstance(*skeleton, &clips[clip]);
+	else
+		animation.Play(&clips[clip]);
+	currentClip = clip;
+}
+
+void Model::Delete()
+{
+	animation.Delete();
+	currentClip = -1;
+	clips.clear();
+	skeleton.reset();
+	meshes.clear();
+	texturesLoaded.clear();
+	textureArrays.clear();
+	embeddedImages.clear();
+	meshAabbMin.clear();
+	meshAabbMax.clear();
+	matrices.clear();
 }
 
 void Model::LoadModel(std::string path, bool flipTexture)
 {
+	MemoryOwnerScope owner(path);
+	directory = path.substr(0, path.find_last_of('/'));
+	aabbMin = glm::vec3(FLT_MAX);
+	aabbMax = glm::vec3(-FLT_MAX);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	AllocationCounter::ResetPeak();
+	long long liveBytes = AllocationCounter::LiveBytes();
+	LoadStats stats;
+	size_t extension = path.find_last_of('.');
+	std::string suffix = extension == std::string::npos ? "" : path.substr(extension);
+	std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+	bool loaded = false;
+	if (nativeLoaders && (suffix == ".gltf" || suffix == ".glb"))
+		loaded = LoadGltf(path, flipTexture, stats);
+	else if (nativeLoaders && suffix == ".pmx")
+		loaded = LoadPmx(path, flipTexture, stats);
+	else if (nativeLoaders && suffix == ".obj")
+		loaded = LoadObj(path, flipTexture, stats);
+	if (!loaded)
+		loaded = LoadAssimp(path, flipTexture, stats);
+	if (!loaded)
+		return;
+
+	if (meshes.empty())
+		aabbMin = aabbMax = glm::vec3(0.0f);
+	LoadTextures();
+	if (skeleton && skeleton->Empty())
+		skeleton.reset();
+	if (skeleton)
+		PlayClip(0);
+
+	// Normalize the model size within size 1 cube and move model to the center (0.0, 0.0, 0.0)
+	glm::vec3 origin2ModelCenter = (aabbMax + aabbMin) * 0.5f;
+	glm::vec3 modelSize = aabbMax - aabbMin;
+	glm::vec3 scale2NormalSize = glm::vec3(1.0f) / glm::max(glm::max(modelSize.x, modelSize.y), modelSize.z);
+	transformation = glm::scale(transformation, scale2NormalSize);
+	transformation = glm::translate(transformation, -origin2ModelCenter);
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Scene Name:\t" << stats.sceneName << std::endl;
+	std::cout << "Loaded by:\t" << stats.loader << " in " << milliseconds << " ms" << std::endl;
+	std::cout << "Number of Meshes:\t" << meshes.size() << std::endl;
+	std::cout << "Number of Textures:\t" << texturesLoaded.size() << " in " << textureArrays.size() << " arrays" << std::endl;
+	std::cout << "Heap Allocations:\t" << stats.readAllocations << " reading, " << stats.meshAllocations << " creating meshes" << std::endl;
+	std::cout << "Peak Heap:\t" << (AllocationCounter::PeakBytes() - liveBytes) / (1024.0 * 1024.0) << " MB" << std::endl;
+	if (skeleton)
+		std::cout << "Skeleton:\t" << skeleton->NumJoints() << " joints, " << skeleton->PaletteSize() << " palette entries, " << clips.size() << " clips" << std::endl;
+}
+
+bool Model::LoadAssimp(const std::string& path, bool flipTexture, LoadStats& stats)
+{
+	size_t allocationsBefore = AllocationCounter::Count();
 	Assimp::Importer importer;
 	const aiScene* scene = flipTexture ?
-		importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_GenBoundingBoxes) :
-		importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_GenBoundingBoxes);
+		importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs) :
+		importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
 		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
 	}
-	directory = path.substr(0, path.find_last_of('/'));
+	if (!scene)
+		return false;
+
+	stats.loader = "Assimp";
+	stats.sceneName = scene->mName.C_Str();
+	stats.readAllocations = AllocationCounter::Count() - allocationsBefore;
+	allocationsBefore = AllocationCounter::Count();
+	std::vector<std::vector<int>> bonePalettes;
+	LoadAssimpSkeleton(scene, bonePalettes);
+	size_t numInstances = CountMeshInstances(scene->mRootNode);
+	meshes.reserve(numInstances);
+	matrices.reserve(numInstances);
+	meshAabbMin.reserve(numInstances);
+	meshAabbMax.reserve(numInstances);
+	ProcessNode(scene->mRootNode, scene, glm::mat4(1.0f), bonePalettes);
+	stats.meshAllocations = AllocationCounter::Count() - allocationsBefore;
+	return true;
+}
 
-	if (scene)
+bool Model::LoadGltf(const std::string& path, bool flipTexture, LoadStats& stats)
+{
+	size_t allocationsBefore = AllocationCounter::Count();
+	GltfDocument document;
+	if (!document.Load(path))
+		return false;
+	const JsonValue& json = document.json;
+	const JsonValue& scene = json["scenes"][(size_t)json["scene"].AsInt(0)];
+	if (scene.IsNull())
 	{
-		ProcessNode(scene->mRootNode, scene, glm::mat4(1.0f));
+		std::cout << "glTF loader found no scene in " << path << std::endl;
+		return false;
+	}
 
-		// Normalize the model size within size 1 cube and move model to the center (0.0, 0.0, 0.0)
-		glm::vec3 origin2ModelCenter = (aabbMax + aabbMin) * 0.5f;
-		glm::vec3 modelSize = aabbMax - aabbMin;
-		glm::vec3 scale2NormalSize = glm::vec3(1.0f) / glm::max(glm::max(modelSize.x, modelSize.y), modelSize.z);
-		transformation = glm::scale(transformation, scale2NormalSize);
-		transformation = glm::translate(transformation, -origin2ModelCenter);
+	// Everything is checked before the first mesh is made, so a model is loaded entirely by
+	// one of the loaders
+	const JsonValue& meshList = json["meshes"];
+	std::vector<std::vector<GltfPrimitive>> primitives(meshList.Size());
+	for (size_t i = 0; i < meshList.Size(); i++)
+	{
+		const JsonValue& primitiveList = meshList[i]["primitives"];
+		for (size_t j = 0; j < primitiveList.Size(); j++)
+		{
+			// Assimp has to triangulate other modes and generate missing normals
+			const JsonValue& primitive = primitiveList[j];
+			const JsonValue& attributes = primitive["attributes"];
+			GltfPrimitive loaded;
+			loaded.flipV = !flipTexture;
+			bool valid = primitive["mode"].AsInt(GL_TRIANGLES) == GL_TRIANGLES
+				&& document.Accessor(attributes["POSITION"].AsInt(-1), loaded.positions) && loaded.positions.components == 3
+				&& document.Accessor(attributes["NORMAL"].AsInt(-1), loaded.normals) && loaded.normals.components == 3
+				&& loaded.normals.count == loaded.positions.count;
+			if (valid && attributes.Has("TEXCOORD_0"))
+				valid = document.Accessor(attributes["TEXCOORD_0"].AsInt(), loaded.uvs) && loaded.uvs.components == 2 && loaded.uvs.count == loaded.positions.count;
+			if (valid && primitive.Has("indices"))
+			{
+				loaded.hasIndices = true;
+				valid = document.Accessor(primitive["indices"].AsInt(), loaded.indices) && loaded.indices.components == 1;
+			}
+			// Only the first four joints of a vertex move it, further sets are left out
+			if (valid && attributes.Has("JOINTS_0"))
+			{
+				valid = document.Accessor(attributes["JOINTS_0"].AsInt(), loaded.joints) && loaded.joints.components == 4 && loaded.joints.count == loaded.positions.count
+					&& document.Accessor(attributes["WEIGHTS_0"].AsInt(-1), loaded.weights) && loaded.weights.components == 4 && loaded.weights.count == loaded.positions.count;
+			}
+			if (!valid)
+			{
+				std::cout << "glTF loader can't read primitive " << j << " of mesh " << i << " in " << path << std::endl;
+				return false;
+			}
+			primitives[i].push_back(loaded);
+		}
+	}
 
-		std::cout << "Scene Name:\t" << scene->mName.C_Str() << std::endl;
-		std::cout << "Number of Meshes:\t" << meshes.size() << std::endl;
-		std::cout << "Number of Textures:\t" << texturesLoaded.size() << std::endl;
+	// Checked before any texture is registered, a failure still leaves the model to Assimp
+	std::unique_ptr<Skeleton> loadedSkeleton;
+	std::vector<int> skinPalettes;
+	if (json["skins"].Size() > 0)
+	{
+		loadedSkeleton.reset(new Skeleton());
+		std::vector<int> nodeJoints;
+		if (!document.LoadSkeleton(*loadedSkeleton, skinPalettes, nodeJoints))
+			return false;
+		document.LoadAnimations(nodeJoints, clips);
 	}
+
+	// Nothing fails from here on, so textures and embedded images can be registered
+	std::vector<std::string> imagePaths = document.ImagePaths(embeddedImages);
+	std::vector<std::vector<Texture>> materialTextures(json["materials"].Size());
+	for (size_t i = 0; i < materialTextures.size(); i++)
+	{
+		// Assimp's mapping, the base color or diffuse texture and a specular texture
+		const JsonValue& material = json["materials"][i];
+		const JsonValue& specularGlossiness = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+		const JsonValue& diffuse = material["pbrMetallicRoughness"].Has("baseColorTexture") ?
+			material["pbrMetallicRoughness"]["baseColorTexture"] : specularGlossiness["diffuseTexture"];
+		const JsonValue& specular = specularGlossiness.Has("specularGlossinessTexture") ?
+			specularGlossiness["specularGlossinessTexture"] : material["extensions"]["KHR_materials_specular"]["specularTexture"];
+		const JsonValue* textures[] = { &diffuse, &specular };
+		textureType types[] = { DIFFUSE, SPECULAR };
+		for (int t = 0; t < 2; t++)
+		{
+			int image = json["textures"][(size_t)(*textures[t])["index"].AsInt(-1)]["source"].AsInt(-1);
+			if (image >= 0 && (size_t)image < imagePaths.size() && !imagePaths[image].empty())
+				materialTextures[i].push_back(LoadedTexture(imagePaths[image], types[t]));
+		}
+	}
+	skeleton = std::move(loadedSkeleton);
+	stats.loader = "glTF";
+	stats.sceneName = scene["name"].AsString();
+	stats.readAllocations = AllocationCounter::Count() - allocationsBefore;
+
+	allocationsBefore = AllocationCounter::Count();
+	const JsonValue& roots = scene["nodes"];
+	size_t numInstances = 0;
+	for (size_t i = 0; i < roots.Size(); i++)
+		numInstances += CountGltfMeshInstances(json, roots[i].AsInt(-1), primitives, 0);
+	meshes.reserve(numInstances);
+	matrices.reserve(numInstances);
+	meshAabbMin.reserve(numInstances);
+	meshAabbMax.reserve(numInstances);
+	for (size_t i = 0; i < roots.Size(); i++)
+		ProcessGltfNode(json, roots[i].AsInt(-1), primitives, materialTextures, skinPalettes, glm::mat4(1.0f), 0);
+	stats.meshAllocations = AllocationCounter::Count() - allocationsBefore;
+	return true;
 }
 
-void Model::ProcessNode(aiNode* node, const aiScene* scene, glm::mat4 matrix)
+bool Model::LoadPmx(const std::string& path, bool flipTexture, LoadStats& stats)
 {
-	// Store the transformation of the node
-	aiMatrix4x4 mat = node->mTransformation;
-	glm::mat4 matParent = glm::mat4(
-		mat[0][0], mat[1][0], mat[2][0], mat[3][0],
-		mat[0][1], mat[1][1], mat[2][1], mat[3][1],
-		mat[0][2], mat[1][2], mat[2][2], mat[3][2],
-		mat[0][3], mat[1][3], mat[2][3], mat[3][3]
-	);
-	glm::mat4 matNode = matrix * matParent;
+	size_t allocationsBefore = AllocationCounter::Count();
+	PmxDocument document;
+	if (!document.Load(path, !flipTexture))
+		return false;
+	stats.loader = "PMX";
+	stats.sceneName = document.name;
+	stats.readAllocations = AllocationCounter::Count() - allocationsBefore;
 
-	// Process all the node's meshes
-	for (size_t i = 0; i < node->mNumMeshes; i++)
+	// Bones can come before their parents, each is added once its parent is. Palette entries keep the file's order, which the vertex
+	// skins refer to, and bind the bones where the file puts them.
+	skeleton.reset(new Skeleton());
+	std::vector<int> boneJoints(document.numBones, -1);
+	size_t numAdded = 0;
+	bool breakLoops = false;
+	while (numAdded < document.numBones)
 	{
-		// Store the mesh
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(ProcessMesh(mesh, scene));
-		matrices.push_back(matNode);
+		size_t addedBefore = numAdded;
+		for (size_t i = 0; i < document.numBones; i++)
+		{
+			const PmxBone& bone = document.bones[i];
+			int parent = bone.parent >= 0 ? boneJoints[bone.parent] : -1;
+			if (boneJoints[i] >= 0 || (bone.parent >= 0 && parent < 0 && !breakLoops))
+				continue;
+			JointPose rest;
+			glm::vec3 parentPosition = parent >= 0 ? document.bones[bone.parent].position : glm::vec3(0.0f);
+			rest.translation = glm::vec4(bone.position - parentPosition, 0.0f);
+			boneJoints[i] = skeleton->AddJoint(bone.name, parent, rest);
+			numAdded++;
+		}
+		// A pass without progress leaves bones in loops, the next one adds them as roots
+		breakLoops = numAdded == addedBefore;
+	}
+	for (size_t i = 0; i < document.numBones; i++)
+		skeleton->AddPaletteEntry(boneJoints[i], glm::translate(glm::mat4(1.0f), -document.bones[i].position));
 
-		// Update the bounding box
-		glm::vec3 max = glm::vec3(matNode * glm::vec4(getGlmVec3FromAiVec3(mesh->mAABB.mMax), 1.0f));
-		glm::vec3 min = glm::vec3(matNode * glm::vec4(getGlmVec3FromAiVec3(mesh->mAABB.mMin), 1.0f));
-
-		if (aabbMax.x < max.x)
-			aabbMax.x = max.x;
-		if (aabbMax.y < max.y)
-			aabbMax.y = max.y;
-		if (aabbMax.z < max.z)
-			aabbMax.z = max.z;
-
-		if (aabbMin.x > min.x)
-			aabbMin.x = min.x;
-		if (aabbMin.y > min.y)
-			aabbMin.y = min.y;
-		if (aabbMin.z > min.z)
-			aabbMin.z = min.z;
+	// One mesh per material as Assimp makes them, but sharing vertices between faces
+	allocationsBefore = AllocationCounter::Count();
+	meshes.reserve(document.numMaterials);
+	matrices.reserve(document.numMaterials);
+	meshAabbMin.reserve(document.numMaterials);
+	meshAabbMax.reserve(document.numMaterials);
+	for (size_t i = 0; i < document.numMaterials; i++)
+	{
+		const PmxMaterial& material = document.materials[i];
+		if (material.numVertices == 0)
+			continue;
+		std::vector<Texture> textures;
+		if (material.texture >= 0)
+			textures.push_back(LoadedTexture(directory + "/" + document.textures[material.texture], DIFFUSE));
+		meshes.push_back(Mesh(PmxMaterialMesh(document, material), std::move(textures), residency));
+		matrices.push_back(glm::mat4(1.0f));
+		meshAabbMin.push_back(material.aabbMin);
+		meshAabbMax.push_back(material.aabbMax);
+		accumulateBounds(glm::mat4(1.0f), material.aabbMin, material.aabbMax, aabbMin, aabbMax);
 	}
-	// Then do the same for each of its childern
-	for (size_t i = 0; i < node->mNumChildren; i++)
+	stats.meshAllocations = AllocationCounter::Count() - allocationsBefore;
+	return true;
+}
+
+bool Model::LoadObj(const std::string& path, bool flipTexture, LoadStats& stats)
+{
+	size_t allocationsBefore = AllocationCounter::Count();
+	ObjDocument document;
+	if (!document.Load(path, flipTexture))
+		return false;
+	stats.loader = "OBJ";
+	stats.sceneName = path.substr(path.find_last_of('/') + 1);
+	stats.readAllocations = AllocationCounter::Count() - allocationsBefore;
+
+	allocationsBefore = AllocationCounter::Count();
+	meshes.reserve(document.meshes.size());
+	matrices.reserve(document.meshes.size());
+	meshAabbMin.reserve(document.meshes.size());
+	meshAabbMax.reserve(document.meshes.size());
+	for (const ObjMesh& mesh : document.meshes)
 	{
-		ProcessNode(node->mChildren[i], scene, matNode);
+		std::vector<Texture> textures;
+		if (mesh.material >= 0)
+		{
+			const ObjMaterial& material = document.materials[mesh.material];
+			if (!material.diffuse.empty())
+				textures.push_back(LoadedTexture(directory + "/" + material.diffuse, DIFFUSE));
+			if (!material.specular.empty())
+				textures.push_back(LoadedTexture(directory + "/" + material.specular, SPECULAR));
+		}
+		meshes.push_back(Mesh(mesh, std::move(textures), residency));
+		matrices.push_back(glm::mat4(1.0f));
+		meshAabbMin.push_back(mesh.aabbMin);
+		meshAabbMax.push_back(mesh.aabbMax);
+		accumulateBounds(glm::mat4(1.0f), mesh.aabbMin, mesh.aabbMax, aabbMin, aabbMax);
 	}
+	stats.meshAllocations = AllocationCounter::Count() - allocationsBefore;
+	return true;
 }
 
-Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+size_t Model::CountGltfMeshInstances(const JsonValue& json, int node, const std::vector<std::vector<GltfPrimitive>>& primitives, int depth)
 {
-	std::vector<Vertex> vertices;
-	std::vector<GLuint> indices;
-	std::vector<Texture> textures;
+	const JsonValue& description = json["nodes"][(size_t)node];
+	if (description.IsNull() || depth > MAX_NODE_DEPTH)
+		return 0;
+	int mesh = description["mesh"].AsInt(-1);
+	size_t count = mesh >= 0 && (size_t)mesh < primitives.size() ? primitives[mesh].size() : 0;
+	const JsonValue& children = description["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+		count += CountGltfMeshInstances(json, children[i].AsInt(-1), primitives, depth + 1);
+	return count;
+}
+
+void Model::ProcessGltfNode(const JsonValue& json, int node, const std::vector<std::vector<GltfPrimitive>>& primitives,
+	const std::vector<std::vector<Texture>>& materialTextures, const std::vector<int>& skinPalettes, glm::mat4 matrix, int depth)
+{
+	// Nodes must form a tree, the depth limit stops files that loop
+	const JsonValue& description = json["nodes"][(size_t)node];
+	if (description.IsNull() || depth > MAX_NODE_DEPTH)
+		return;
+	glm::mat4 matNode = matrix * GltfDocument::NodeMatrix(description);
+
+	// Every primitive becomes a mesh of its own, as Assimp splits them
+	int mesh = description["mesh"].AsInt(-1);
+	int skin = description["skin"].AsInt(-1);
+	if (mesh >= 0 && (size_t)mesh < primitives.size())
+	{
+		const JsonValue& primitiveList = json["meshes"][(size_t)mesh]["primitives"];
+		for (size_t i = 0; i < primitives[mesh].size(); i++)
+		{
+			// The same mesh can be bound to different skins by different nodes
+			GltfPrimitive primitive = primitives[mesh][i];
+			if (skin >= 0 && (size_t)skin < skinPalettes.size())
+			{
+				primitive.paletteOffset = skinPalettes[skin];
+				primitive.paletteSize = (int)json["skins"][(size_t)skin]["joints"].Size();
+			}
+			int material = primitiveList[i]["material"].AsInt(-1);
+			std::vector<Texture> textures;
+			if (material >= 0 && (size_t)material < materialTextures.size())
+				textures = materialTextures[material];
+			meshes.push_back(Mesh(primitive, std::move(textures), residency));
 
+			glm::vec3 meshMin = primitive.positions.min;
+			glm::vec3 meshMax = primitive.positions.max;
+			if (primitive.positions.Packed(GL_FLOAT, 3))
+				computeMeshBounds((const aiVector3D*)primitive.positions.data, primitive.positions.count, meshMin, meshMax);
+			else if (!primitive.positions.hasBounds)
+				meshMin = meshMax = glm::vec3(0.0f);
+			// Joints place skinned meshes and ignore the node, the bounds assume the bind pose
+			// puts them where the node does
+			glm::mat4 meshMatrix = matNode;
+			if (primitive.HasSkins())
+			{
+				transformBounds(matNode, meshMin, meshMax, meshMin, meshMax);
+				meshMatrix = glm::mat4(1.0f);
+			}
+			matrices.push_back(meshMatrix);
+			meshAabbMin.push_back(meshMin);
+			meshAabbMax.push_back(meshMax);
+			accumulateBounds(meshMatrix, meshMin, meshMax, aabbMin, aabbMax);
+		}
+	}
 
-	for (size_t i = 0; i < mesh->mNumVertices; i++)
+	const JsonValue& children = description["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+		ProcessGltfNode(json, children[i].AsInt(-1), primitives, materialTextures, skinPalettes, matNode, depth + 1);
+}
+
+Texture Model::LoadedTexture(const std::string& path, textureType type)
+{
+	for (const Texture& texture : texturesLoaded)
 	{
-		Vertex vertex;
+		if (texture.path == path)
+			return texture;
+	}
+	// Loaded by LoadTextures together with all other images of the model
+	Texture texture(path, type);
+	texturesLoaded.push_back(texture);
+	return texture;
+}
 
-		// Process vertex position, normals and texture coordinates
-		vertex.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-		vertex.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-		if (mesh->mTextureCoords[0])
-			vertex.texureUV = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-		else
-			vertex.texureUV = glm::vec2(0.0f);
+void Model::LoadTextures()
+{
+	textureArrays = createTextureArrays(texturesLoaded);
+	std::unordered_map<std::string, const Texture*> loadedByPath;
+	for (const Texture& loaded : texturesLoaded)
+		loadedByPath[loaded.path] = &loaded;
+	for (Mesh& mesh : meshes)
+	{
+		for (Texture& texture : mesh.textures)
+		{
+			const Texture* loaded = loadedByPath[texture.path];
+			texture.ID = loaded->ID;
+			texture.layer = loaded->layer;
+		}
+	}
+}
+
+size_t Model::CountMeshInstances(const aiNode* node)
+{
+	size_t count = node->mNumMeshes;
+	for (size_t i = 0; i < node->mNumChildren; i++)
+		count += CountMeshInstances(node->mChildren[i]);
+	return count;
+}
+
+void Model::LoadAssimpSkeleton(const aiScene* scene, std::vector<std::vector<int>>& bonePalettes)
+{
+	bonePalettes.assign(scene->mNumMeshes, std::vector<int>());
+	std::unordered_map<std::string, const aiNode*> nodesByName;
+	std::vector<const aiNode*> stack(1, scene->mRootNode);
+	while (!stack.empty())
+	{
+		const aiNode* node = stack.back();
+		stack.pop_back();
+		nodesByName.emplace(node->mName.C_Str(), node);
+		stack.insert(stack.end(), node->mChildren, node->mChildren + node->mNumChildren);
+	}
+
+	// The nodes of the bones and everything above them, -1 until they are added
+	std::unordered_map<const aiNode*, int> nodeJoints;
+	for (size_t i = 0; i < scene->mNumMeshes; i++)
+	{
+		const aiMesh* mesh = scene->mMeshes[i];
+		for (size_t j = 0; j < mesh->mNumBones; j++)
+		{
+			auto found = nodesByName.find(mesh->mBones[j]->mName.C_Str());
+			for (const aiNode* node = found != nodesByName.end() ? found->second : nullptr; node && !nodeJoints.count(node); node = node->mParent)
+				nodeJoints[node] = -1;
+		}
+	}
+	if (nodeJoints.empty())
+		return;
+
+	// Parents first, walking down from the root
+	skeleton.reset(new Skeleton());
+	stack.assign(1, scene->mRootNode);
+	while (!stack.empty())
+	{
+		const aiNode* node = stack.back();
+		stack.pop_back();
+		auto joint = nodeJoints.find(node);
+		if (joint == nodeJoints.end())
+			continue;
+		int parent = node->mParent && nodeJoints.count(node->mParent) ? nodeJoints[node->mParent] : -1;
+		joint->second = skeleton->AddJoint(node->mName.C_Str(), parent, decomposePose(getGlmMat4FromAiMat4(node->mTransformation)));
+		stack.insert(stack.end(), node->mChildren, node->mChildren + node->mNumChildren);
+	}
+
+	// Bones of different meshes on the same node with the same offset share a palette entry
+	for (size_t i = 0; i < scene->mNumMeshes; i++)
+	{
+		const aiMesh* mesh = scene->mMeshes[i];
+		for (size_t j = 0; j < mesh->mNumBones; j++)
+		{
+			const aiBone* bone = mesh->mBones[j];
+			auto found = nodesByName.find(bone->mName.C_Str());
+			int joint = found != nodesByName.end() ? nodeJoints[found->second] : 0;
+			glm::mat4 offset = getGlmMat4FromAiMat4(bone->mOffsetMatrix);
+			int entry = -1;
+			for (size_t k = 0; k < skeleton->PaletteSize() && entry < 0; k++)
+			{
+				if (skeleton->paletteJoints[k] == joint && skeleton->inverseBindMatrices[k] == offset)
+					entry = (int)k;
+			}
+			bonePalettes[i].push_back(entry >= 0 ? entry : skeleton->AddPaletteEntry(joint, offset));
+		}
+	}
+
+	for (size_t i = 0; i < scene->mNumAnimations; i++)
+	{
+		const aiAnimation* animation = scene->mAnimations[i];
+		// Assimp leaves the rate at zero for formats without one
+		double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+		AnimationClip clip;
+		clip.name = animation->mName.length > 0 ? animation->mName.C_Str() : "Animation " + std::to_string(i);
+		clip.duration = (float)(animation->mDuration / ticksPerSecond);
+		for (size_t j = 0; j < animation->mNumChannels; j++)
+		{
+			const aiNodeAnim* nodeAnimation = animation->mChannels[j];
+			auto found = nodesByName.find(nodeAnimation->mNodeName.C_Str());
+			auto joint = found != nodesByName.end() ? nodeJoints.find(found->second) : nodeJoints.end();
+			if (joint == nodeJoints.end())
+				continue;
 
-		vertices.push_back(vertex);
+			AnimationChannel translation, rotation, scale;
+			translation.path = ANIMATION_TRANSLATION;
+			rotation.path = ANIMATION_ROTATION;
+			scale.path = ANIMATION_SCALE;
+			for (size_t k = 0; k < nodeAnimation->mNumPositionKeys; k++)
+			{
+				const aiVectorKey& key = nodeAnimation->mPositionKeys[k];
+				translation.times.push_back((float)(key.mTime / ticksPerSecond));
+				translation.values.push_back(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.0f));
+			}
+			for (size_t k = 0; k < nodeAnimation->mNumRotationKeys; k++)
+			{
+				const aiQuatKey& key = nodeAnimation->mRotationKeys[k];
+				rotation.times.push_back((float)(key.mTime / ticksPerSecond));
+				rotation.values.push_back(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w));
+			}
+			for (size_t k = 0; k < nodeAnimation->mNumScalingKeys; k++)
+			{
+				const aiVectorKey& key = nodeAnimation->mScalingKeys[k];
+				scale.times.push_back((float)(key.mTime / ticksPerSecond));
+				scale.values.push_back(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.0f));
+			}
+			AnimationChannel* channels[] = { &translation, &rotation, &scale };
+			for (AnimationChannel* channel : channels)
+			{
+				channel->joint = joint->second;
+				if (!channel->times.empty() && std::is_sorted(channel->times.begin(), channel->times.end()))
+					clip.channels.push_back(std::move(*channel));
+			}
+		}
+		if (!clip.channels.empty())
+			clips.push_back(std::move(clip));
 	}
-	// Process indices
-	for (size_t i = 0; i < mesh->mNumFaces; i++)
+}
+
+void Model::ProcessNode(aiNode* node, const aiScene* scene, glm::mat4 matrix, const std::vector<std::vector<int>>& bonePalettes)
+{
+	// Store the transformation of the node
+	glm::mat4 matNode = matrix * getGlmMat4FromAiMat4(node->mTransformation);
+
+	// Process all the node's meshes
+	for (size_t i = 0; i < node->mNumMeshes; i++)
 	{
-		aiFace face = mesh->mFaces[i];
-		for (size_t j = 0; j < face.mNumIndices; j++)
+		// Store the mesh
+		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		const std::vector<int>& bonePalette = bonePalettes[node->mMeshes[i]];
+		meshes.push_back(ProcessMesh(mesh, scene, bonePalette.empty() ? nullptr : bonePalette.data()));
+		glm::vec3 meshMin, meshMax;
+		computeMeshBounds(mesh->mVertices, mesh->mNumVertices, meshMin, meshMax);
+		// Bones place skinned meshes, in the bind pose where the node does
+		glm::mat4 meshMatrix = matNode;
+		if (meshes.back().Skinned())
 		{
-			indices.push_back(face.mIndices[j]);
+			transformBounds(matNode, meshMin, meshMax, meshMin, meshMax);
+			meshMatrix = glm::mat4(1.0f);
 		}
+		matrices.push_back(meshMatrix);
+		meshAabbMin.push_back(meshMin);
+		meshAabbMax.push_back(meshMax);
+
+		// Update the bounding box
+		accumulateBounds(meshMatrix, meshAabbMin.back(), meshAabbMax.back(), aabbMin, aabbMax);
 	}
+	// Then do the same for each of its childern
+	for (size_t i = 0; i < node->mNumChildren; i++)
+	{
+		ProcessNode(node->mChildren[i], scene, matNode, bonePalettes);
+	}
+}
+
+Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene, const int* bonePalette)
+{
+	std::vector<Texture> textures;
+
 	// Process material
 	if (mesh->mMaterialIndex >= 0)
 	{
@@ -134,7 +772,7 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 	}
 
-	return Mesh(vertices, indices, textures);
+	return Mesh(AssimpMeshSource(mesh, bonePalette), std::move(textures), residency);
 }
 
 std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTextureType aiTexType, textureType texType, const aiScene* scene)
@@ -162,23 +800,7 @@ std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTexture
 			filePath = directory + "/" + path.data;
 		}
 
-		bool skip = false;
-		for (unsigned int j = 0; j < texturesLoaded.size(); j++)
-		{
-			if (texturesLoaded[j].path == filePath)
-			{
-				textures.push_back(texturesLoaded[j]);
-				skip = true;
-				break;
-			}
-		}
-
-		if (!skip)
-		{
-			Texture texture(filePath.c_str(), texType, texturesLoaded.size());
-			textures.push_back(texture);
-			texturesLoaded.push_back(texture);
-		}
+		textures.push_back(LoadedTexture(filePath, texType));
 	}
 	return textures;
 }
@@ -186,4 +808,15 @@ std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTexture
 glm::vec3 getGlmVec3FromAiVec3(aiVector3D& vec)
 {
 	return glm::vec3(vec.x, vec.y, vec.z);
+}
+
+glm::mat4 getGlmMat4FromAiMat4(const aiMatrix4x4& mat)
+{
+	// Assimp stores rows, glm columns
+	return glm::mat4(
+		mat[0][0], mat[1][0], mat[2][0], mat[3][0],
+		mat[0][1], mat[1][1], mat[2][1], mat[3][1],
+		mat[0][2], mat[1][2], mat[2][2], mat[3][2],
+		mat[0][3], mat[1][3], mat[2][3], mat[3][3]
+	);
 }
\ No newline at end of file
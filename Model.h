@@ -4,30 +4,101 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <memory>
+
+#include "Animator.h"
+#include "Gltf.h"
 #include "Mesh.h"
+#include "TextureArray.h"
 
+// Owns its meshes and texture arrays, so it can be moved but not copied
 class Model
 {
 public:
-	Model(const char* path, bool flipTexture = true);
-	void Draw(Shader& shader, Camera& camera, float scale = 1.0f);
+	// Reads .gltf, .glb, .pmx and .obj files without Assimp unless they use features only Assimp has
+	static bool nativeLoaders;
+
+	// Nothing reads the geometry of loaded models on the CPU yet, so by default only the
+	// buffers hold it
+	Model(const char* path, bool flipTexture = true, geometryResidency residency = GEOMETRY_DISCARD);
+	// For shaders that don't depend on textures, only skinned meshes get another variant
+	void Draw(ShaderPermutations& shaders, Camera& camera);
+	// Picks the textured or untextured variant of the given feature set per mesh
+	void Draw(ShaderPermutations& shaders, unsigned int features, Camera& camera);
+	// Draws the meshes whose world bounds in the current pose overlap the light space box,
+	// returns the number drawn. lightSpace goes to the plain and the skinned variant.
+	size_t DrawShadowCasters(ShaderPermutations& shaders, const glm::mat4& lightSpace, const glm::mat4& lightView, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// Asks the texture streamer for the levels every visible mesh needs at its distance
+	void RequestTextureLevels(const Camera& camera);
+	// Applies a CPU geometry policy to every mesh
+	void SetGeometryResidency(geometryResidency residency);
+	geometryResidency GeometryResidency() const
+	{
+		return residency;
+	}
+	// Frees the meshes and textures early, destroying or replacing the model does it otherwise
+	void Delete();
+	// Clips of the skeleton, the first one plays after loading
+	size_t NumClips() const
+	{
+		return clips.size();
+	}
+	const std::string& ClipName(size_t clip) const
+	{
+		return clips[clip].name;
+	}
+	int CurrentClip() const
+	{
+		return currentClip;
+	}
+	// Switches to another clip, -1 stops animating and draws the meshes as they were bound
+	void PlayClip(int clip);
+	// True while a clip plays, skinned meshes then use the FEATURE_SKINNING variants
+	bool Animated() const
+	{
+		return animation.ID >= 0;
+	}
+	// True if loading failed or the file has no meshes
+	bool Empty() const
+	{
+		return meshes.empty();
+	}
 	void Translate(const glm::vec3& trans)
 	{
 		transformation = glm::translate(transformation, trans);
+		drawDataEpoch = 0;
 	}
 	void Rotate(float angle, const glm::vec3& axis)
 	{
 		transformation = glm::rotate(transformation, glm::radians(angle), axis);
+		drawDataEpoch = 0;
 	}
 	void Scale(const glm::vec3& scale)
 	{
 		transformation = glm::scale(transformation, scale);
+		drawDataEpoch = 0;
 	}
 
 private:
+	// Deeper node hierarchies in glTF files are treated as loops
+	static const int MAX_NODE_DEPTH = 256;
+
+	struct LoadStats
+	{
+		const char* loader = "";
+		std::string sceneName;
+		size_t readAllocations = 0;
+		size_t meshAllocations = 0;
+	};
+
 	std::vector<Mesh> meshes;
 	std::string directory;
 	std::vector<Texture> texturesLoaded;
+	// Images inside glTF buffers, declared before the arrays so they outlive the streamed ones
+	std::vector<EmbeddedImage> embeddedImages;
+	// Hold the images of texturesLoaded, grouped by size and format
+	std::vector<TextureArray> textureArrays;
+	geometryResidency residency;
 
 	glm::vec3 translation = glm::vec3(0.0f);
 	float rotationRadians = glm::radians(0.0f);
@@ -35,14 +106,51 @@ private:
 	glm::vec3 scale = glm::vec3(1.0f);
 	std::vector<glm::mat4> matrices;
 	glm::mat4 transformation = glm::mat4(1.0f);
+	// Index of the first mesh in the draw data and the epoch it was written in
+	int drawBase = 0;
+	unsigned int drawDataEpoch = 0;
+
+	// Joints of the skinned meshes, on the heap so the Animator's pointer survives moving the
+	// model. Moving the clips keeps their elements in place as well.
+	std::unique_ptr<Skeleton> skeleton;
+	std::vector<AnimationClip> clips;
+	// Declared after the skeleton and clips it points to, so it is removed first
+	AnimationInstance animation;
+	int currentClip = -1;
 
 	glm::vec3 aabbMin = glm::vec3(0.0f);
 	glm::vec3 aabbMax = glm::vec3(0.0f);
+	// Local space bounds of every mesh, parallel to meshes
+	std::vector<glm::vec3> meshAabbMin;
+	std::vector<glm::vec3> meshAabbMax;
 
+	// Writes the matrices of all meshes into the draw data unless this frame has them already
+	void UploadDrawData();
+	// Skinned meshes use the FEATURE_SKINNING variant while posed, textured picks the
+	// FEATURE_TEXTURED one per mesh
+	void DrawMeshes(ShaderPermutations& shaders, unsigned int features, bool textured, Camera& camera);
 	void LoadModel(std::string path, bool flipTexture);
-	void ProcessNode(aiNode *node, const aiScene* scene, glm::mat4 matrix);
-	Mesh ProcessMesh(aiMesh *mesh, const aiScene* scene);
+	bool LoadAssimp(const std::string& path, bool flipTexture, LoadStats& stats);
+	// Adds nothing and returns false if the file has to be loaded by Assimp
+	bool LoadGltf(const std::string& path, bool flipTexture, LoadStats& stats);
+	bool LoadPmx(const std::string& path, bool flipTexture, LoadStats& stats);
+	bool LoadObj(const std::string& path, bool flipTexture, LoadStats& stats);
+	// Loads the images of all materials into arrays once the meshes refer to them
+	void LoadTextures();
+	// Meshes referenced by the node and its children, a mesh used twice counts twice
+	static size_t CountMeshInstances(const aiNode* node);
+	// Joints of all bones and their ancestors, bonePalettes receives the palette entry of every
+	// bone of every mesh
+	void LoadAssimpSkeleton(const aiScene* scene, std::vector<std::vector<int>>& bonePalettes);
+	void ProcessNode(aiNode *node, const aiScene* scene, glm::mat4 matrix, const std::vector<std::vector<int>>& bonePalettes);
+	Mesh ProcessMesh(aiMesh *mesh, const aiScene* scene, const int* bonePalette);
+	static size_t CountGltfMeshInstances(const JsonValue& json, int node, const std::vector<std::vector<GltfPrimitive>>& primitives, int depth);
+	void ProcessGltfNode(const JsonValue& json, int node, const std::vector<std::vector<GltfPrimitive>>& primitives,
+		const std::vector<std::vector<Texture>>& materialTextures, const std::vector<int>& skinPalettes, glm::mat4 matrix, int depth);
+	// The texture of an image path, added to texturesLoaded the first time
+	Texture LoadedTexture(const std::string& path, textureType type);
 	std::vector<Texture> LoadMaterialTextures(aiMaterial* material, aiTextureType aiTexType, textureType texType, const aiScene* scene);
 };
 
-glm::vec3 getGlmVec3FromAiVec3(aiVector3D& vec);
\ No newline at end of file
+glm::vec3 getGlmVec3FromAiVec3(aiVector3D& vec);
+glm::mat4 getGlmMat4FromAiMat4(const aiMatrix4x4& mat);
\ No newline at end of file
@@ -0,0 +1,538 @@
+#include "Obj.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+namespace
+{
+	// Files are split into at most four chunks per thread and no chunks smaller than this
+	const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+	const unsigned int RELATIVE_POSITION = 1;
+	const unsigned int RELATIVE_UV = 2;
+	const unsigned int RELATIVE_NORMAL = 4;
+
+	const double POWERS_OF_10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Indices of a face corner. Positive indices in the file become 0 based indices into the
+	// whole file, negative ones 0 based indices into the chunk, which may point into earlier
+	// chunks, and set their bit in relative. Missing UVs and normals are -1 without the bit.
+	struct ObjCorner
+	{
+		int position;
+		int uv;
+		int normal;
+		unsigned int relative;
+	};
+
+	// Corners from firstCorner on use the named material, until the next group
+	struct ObjGroup
+	{
+		std::string material;
+		size_t firstCorner;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		// Three per triangle, polygons are split into fans
+		std::vector<ObjCorner> corners;
+		std::vector<ObjGroup> groups;
+		std::vector<std::string> libraries;
+		bool invalid = false;
+		// Index of the chunk's first position, UV and normal in the whole file
+		size_t firstPosition = 0;
+		size_t firstUV = 0;
+		size_t firstNormal = 0;
+	};
+
+	// Corners of a chunk drawn with one material
+	struct ObjSpan
+	{
+		const ObjChunk* chunk;
+		size_t firstCorner;
+		size_t endCorner;
+	};
+
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	bool isDigit(char c)
+	{
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			p++;
+		return p;
+	}
+
+	// The rest of the line without surrounding white space
+	std::string restOfLine(const char* p, const char* end)
+	{
+		p = skipSpaces(p, end);
+		while (end > p && (isSpace(end[-1]) || end[-1] == '\r'))
+			end--;
+		return std::string(p, end);
+	}
+
+	// Decimal with optional sign, fraction and exponent. The first 19 significant digits are
+	// collected in an integer and scaled once, which needs no terminator or locale and is
+	// much faster than strtof. Missing numbers read as 0.
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		p = skipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		for (; p < end && isDigit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && isDigit(*p); p++)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				negativeExponent = *p++ == '-';
+			int e = 0;
+			for (; p < end && isDigit(*p); p++)
+				e = std::min(e * 10 + (*p - '0'), 100000);
+			exponent += negativeExponent ? -e : e;
+		}
+
+		double number = (double)mantissa;
+		if (exponent < 0)
+			number = exponent >= -22 ? number / POWERS_OF_10[-exponent] : number * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			number = exponent <= 22 ? number * POWERS_OF_10[exponent] : number * std::pow(10.0, exponent);
+		value = (float)(negative ? -number : number);
+		return p;
+	}
+
+	// One index of a corner, returns null for 0 and missing numbers
+	const char* parseIndex(const char* p, const char* end, size_t localCount, int& index, unsigned int& relative, unsigned int bit)
+	{
+		bool negative = false;
+		if (p < end && *p == '-')
+		{
+			negative = true;
+			p++;
+		}
+		long long value = 0;
+		const char* start = p;
+		for (; p < end && isDigit(*p); p++)
+			value = std::min(value * 10 + (*p - '0'), (long long)INT32_MAX);
+		if (p == start || value == 0)
+			return nullptr;
+
+		if (negative)
+		{
+			index = (int)((long long)localCount - value);
+			relative |= bit;
+		}
+		else
+		{
+			index = (int)(value - 1);
+		}
+		return p;
+	}
+
+	void parseFace(const char* p, const char* end, ObjChunk& chunk)
+	{
+		ObjCorner first = {}, previous = {};
+		int numCorners = 0;
+		while (true)
+		{
+			p = skipSpaces(p, end);
+			if (p >= end || (!isDigit(*p) && *p != '-'))
+				break;
+
+			ObjCorner corner = { -1, -1, -1, 0 };
+			p = parseIndex(p, end, chunk.positions.size(), corner.position, corner.relative, RELATIVE_POSITION);
+			if (p && p < end && *p == '/')
+			{
+				p++;
+				if (p < end && *p != '/')
+					p = parseIndex(p, end, chunk.uvs.size(), corner.uv, corner.relative, RELATIVE_UV);
+				if (p && p < end && *p == '/')
+					p = parseIndex(p + 1, end, chunk.normals.size(), corner.normal, corner.relative, RELATIVE_NORMAL);
+			}
+			if (!p)
+			{
+				chunk.invalid = true;
+				return;
+			}
+
+			if (numCorners == 0)
+				first = corner;
+			if (numCorners >= 2)
+			{
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
+			}
+			previous = corner;
+			numCorners++;
+		}
+	}
+
+	void parseChunk(ObjChunk& chunk)
+	{
+		const char* p = chunk.begin;
+		while (p < chunk.end)
+		{
+			const char* end = (const char*)std::memchr(p, '\n', chunk.end - p);
+			if (!end)
+				end = chunk.end;
+			p = skipSpaces(p, end);
+
+			if (end - p >= 2)
+			{
+				if (p[0] == 'v' && isSpace(p[1]))
+				{
+					glm::vec3 position;
+					const char* q = parseFloat(p + 2, end, position.x);
+					q = parseFloat(q, end, position.y);
+					parseFloat(q, end, position.z);
+					chunk.positions.push_back(position);
+				}
+				else if (p[0] == 'v' && p[1] == 't' && end - p >= 3 && isSpace(p[2]))
+				{
+					glm::vec2 uv;
+					parseFloat(parseFloat(p + 3, end, uv.x), end, uv.y);
+					chunk.uvs.push_back(uv);
+				}
+				else if (p[0] == 'v' && p[1] == 'n' && end - p >= 3 && isSpace(p[2]))
+				{
+					glm::vec3 normal;
+					const char* q = parseFloat(p + 3, end, normal.x);
+					q = parseFloat(q, end, normal.y);
+					parseFloat(q, end, normal.z);
+					chunk.normals.push_back(normal);
+				}
+				else if (p[0] == 'f' && isSpace(p[1]))
+				{
+					parseFace(p + 2, end, chunk);
+				}
+				else if (end - p > 7 && std::memcmp(p, "usemtl", 6) == 0 && isSpace(p[6]))
+				{
+					chunk.groups.push_back(ObjGroup{ restOfLine(p + 7, end), chunk.corners.size() });
+				}
+				else if (end - p > 7 && std::memcmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+				{
+					chunk.libraries.push_back(restOfLine(p + 7, end));
+				}
+			}
+			p = end + 1;
+		}
+	}
+
+	// Index into the whole file, -1 if it is missing or out of range
+	int resolve(int index, bool relative, size_t first, size_t count)
+	{
+		long long resolved = relative ? (long long)first + index : index;
+		return resolved >= 0 && resolved < (long long)count ? (int)resolved : -1;
+	}
+}
+
+bool ObjDocument::Load(const std::string& path, bool flipV)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cout << "ERROR::OBJ::FILE_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	size_t slash = path.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+	if (!Parse((const char*)file.Data(), file.Size(), directory, flipV))
+	{
+		std::cout << "ERROR::OBJ::NOT_LOADED: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ObjDocument::Parse(const char* text, size_t size, const std::string& directory, bool flipV)
+{
+	materials.clear();
+	meshes.clear();
+	unsigned int threads = numThreads > 0 ? numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Chunks start after a line break, so no line is split between two of them
+	size_t numChunks = std::max<size_t>(std::min<size_t>(size / MIN_CHUNK_BYTES, threads * 4), 1);
+	std::vector<ObjChunk> chunks(numChunks);
+	const char* begin = text;
+	const char* end = text + size;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < numChunks)
+		{
+			const char* target = std::max(text + size / numChunks * (i + 1), begin);
+			const char* lineEnd = (const char*)std::memchr(target, '\n', end - target);
+			chunkEnd = lineEnd ? lineEnd + 1 : end;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = chunkEnd;
+		begin = chunkEnd;
+	}
+	parallelFor(numChunks, threads, [&](size_t i) { parseChunk(chunks[i]); });
+
+	size_t numPositions = 0, numUVs = 0, numNormals = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		if (chunk.invalid)
+		{
+			std::cout << "ERROR::OBJ::FACE_NOT_READ: an index is 0 or not a number" << std::endl;
+			return false;
+		}
+		chunk.firstPosition = numPositions;
+		chunk.firstUV = numUVs;
+		chunk.firstNormal = numNormals;
+		numPositions += chunk.positions.size();
+		numUVs += chunk.uvs.size();
+		numNormals += chunk.normals.size();
+	}
+
+	// Material names map to the libraries' materials, names no library has are added without
+	// textures
+	std::vector<std::string> libraries;
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (const std::string& library : chunk.libraries)
+		{
+			if (std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+			{
+				libraries.push_back(library);
+				LoadMaterials(directory + "/" + library);
+			}
+		}
+	}
+	std::unordered_map<std::string, int> materialIndices;
+	for (size_t i = 0; i < materials.size(); i++)
+		materialIndices.emplace(materials[i].name, (int)i);
+
+	// Spans of corners per mesh, a chunk continues with the material the one before ended with
+	std::vector<std::vector<ObjSpan>> meshSpans;
+	std::vector<size_t> meshCorners;
+	std::unordered_map<int, size_t> meshOfMaterial;
+	int material = -1;
+	auto addSpan = [&](const ObjChunk& chunk, size_t firstCorner, size_t endCorner)
+	{
+		if (firstCorner == endCorner)
+			return;
+		auto found = meshOfMaterial.find(material);
+		if (found == meshOfMaterial.end())
+		{
+			found = meshOfMaterial.emplace(material, meshes.size()).first;
+			meshes.emplace_back();
+			meshes.back().material = material;
+			meshSpans.emplace_back();
+			meshCorners.push_back(0);
+		}
+		meshSpans[found->second].push_back(ObjSpan{ &chunk, firstCorner, endCorner });
+		meshCorners[found->second] += endCorner - firstCorner;
+	};
+	for (const ObjChunk& chunk : chunks)
+	{
+		size_t firstCorner = 0;
+		for (const ObjGroup& group : chunk.groups)
+		{
+			addSpan(chunk, firstCorner, group.firstCorner);
+			auto found = materialIndices.find(group.material);
+			if (found == materialIndices.end())
+			{
+				found = materialIndices.emplace(group.material, (int)materials.size()).first;
+				materials.push_back(ObjMaterial{ group.material, "", "" });
+			}
+			material = found->second;
+			firstCorner = group.firstCorner;
+		}
+		addSpan(chunk, firstCorner, chunk.corners.size());
+	}
+
+	// Vertex lists of all chunks end to end, so corners can index them directly
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	positions.reserve(numPositions);
+	uvs.reserve(numUVs);
+	normals.reserve(numNormals);
+	for (const ObjChunk& chunk : chunks)
+	{
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+	}
+
+	// Corners equal in all three indices share a vertex. The open addressing table holds
+	// vertex + 1 and is at most half full.
+	std::vector<const char*> errors(meshes.size(), nullptr);
+	parallelFor(meshes.size(), threads, [&](size_t m)
+	{
+		ObjMesh& mesh = meshes[m];
+		size_t capacity = 16;
+		while (capacity < meshCorners[m] * 2)
+			capacity *= 2;
+		std::vector<GLuint> table(capacity, 0);
+		std::vector<glm::ivec3> keys;
+		keys.reserve(meshCorners[m] / 4);
+		mesh.vertices.reserve(meshCorners[m] / 4);
+		mesh.indices.reserve(meshCorners[m]);
+		mesh.aabbMin = glm::vec3(FLT_MAX);
+		mesh.aabbMax = glm::vec3(-FLT_MAX);
+
+		for (const ObjSpan& span : meshSpans[m])
+		{
+			const ObjChunk& chunk = *span.chunk;
+			for (size_t c = span.firstCorner; c < span.endCorner; c++)
+			{
+				const ObjCorner& corner = chunk.corners[c];
+				glm::ivec3 key(resolve(corner.position, (corner.relative & RELATIVE_POSITION) != 0, chunk.firstPosition, positions.size()),
+					resolve(corner.uv, (corner.relative & RELATIVE_UV) != 0, chunk.firstUV, uvs.size()),
+					resolve(corner.normal, (corner.relative & RELATIVE_NORMAL) != 0, chunk.firstNormal, normals.size()));
+				if (key.x < 0)
+				{
+					errors[m] = "a face points past the positions";
+					return;
+				}
+				if (key.z < 0)
+				{
+					errors[m] = "a face has no normals";
+					return;
+				}
+
+				size_t slot = ((size_t)key.x * 73856093u ^ (size_t)(key.y + 1) * 19349663u ^ (size_t)key.z * 83492791u) & (capacity - 1);
+				while (table[slot] != 0 && keys[table[slot] - 1] != key)
+					slot = (slot + 1) & (capacity - 1);
+				if (table[slot] == 0)
+				{
+					Vertex vertex;
+					vertex.position = positions[key.x];
+					vertex.normal = normals[key.z];
+					vertex.texureUV = key.y >= 0 ? uvs[key.y] : glm::vec2(0.0f);
+					if (flipV && key.y >= 0)
+						vertex.texureUV.y = 1.0f - vertex.texureUV.y;
+					mesh.vertices.push_back(vertex);
+					keys.push_back(key);
+					table[slot] = (GLuint)mesh.vertices.size();
+					mesh.aabbMin = glm::min(mesh.aabbMin, vertex.position);
+					mesh.aabbMax = glm::max(mesh.aabbMax, vertex.position);
+				}
+				mesh.indices.push_back(table[slot] - 1);
+			}
+		}
+	});
+	for (const char* error : errors)
+	{
+		if (error)
+		{
+			std::cout << "ERROR::OBJ::FACE_NOT_READ: " << error << std::endl;
+			meshes.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ObjDocument::LoadMaterials(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::OBJ::MTL_NOT_READ: " << path << std::endl;
+		return;
+	}
+
+	// Only the maps Model uses, the file name is the last word after any options
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const char* p = skipSpaces(line.data(), line.data() + line.size());
+		const char* end = line.data() + line.size();
+		size_t length = end - p;
+		std::string* map = nullptr;
+		if (length > 7 && std::memcmp(p, "newmtl", 6) == 0 && isSpace(p[6]))
+			materials.push_back(ObjMaterial{ restOfLine(p + 7, end), "", "" });
+		else if (!materials.empty() && length > 7 && std::memcmp(p, "map_Kd", 6) == 0 && isSpace(p[6]))
+			map = &materials.back().diffuse;
+		else if (!materials.empty() && length > 7 && std::memcmp(p, "map_Ks", 6) == 0 && isSpace(p[6]))
+			map = &materials.back().specular;
+		if (map)
+		{
+			std::string value = restOfLine(p + 7, end);
+			size_t space = value.find_last_of(" \t");
+			*map = space == std::string::npos ? value : value.substr(space + 1);
+			std::replace(map->begin(), map->end(), '\\', '/');
+		}
+	}
+}
+
+void ObjMesh::WriteVertices(Vertex* out) const
+{
+	std::copy(vertices.begin(), vertices.end(), out);
+}
+
+void ObjMesh::WritePositions(glm::vec3* out) const
+{
+	for (size_t i = 0; i < vertices.size(); i++)
+		out[i] = vertices[i].position;
+}
+
+void ObjMesh::WriteIndices(GLuint* out) const
+{
+	std::copy(indices.begin(), indices.end(), out);
+}
+
+float ObjMesh::TextureCoordinateDensity() const
+{
+	return textureCoordinateDensity(vertices, indices);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "MeshProcessing.h"
+#include "VertexBuffer.h"
+
+// Textures of a material from the .mtl libraries, relative to the model
+struct ObjMaterial
+{
+	std::string name;
+	std::string diffuse;
+	std::string specular;
+};
+
+// All faces of one material with the corners that are the same in position, UV and normal
+// merged into one vertex
+class ObjMesh : public MeshSource
+{
+public:
+	// Index into the document's materials or -1 for faces before any usemtl
+	int material = -1;
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	glm::vec3 aabbMin = glm::vec3(0.0f);
+	glm::vec3 aabbMax = glm::vec3(0.0f);
+
+	size_t NumVertices() const override { return vertices.size(); }
+	size_t NumIndices() const override { return indices.size(); }
+	void WriteVertices(Vertex* out) const override;
+	void WritePositions(glm::vec3* out) const override;
+	void WriteIndices(GLuint* out) const override;
+	float TextureCoordinateDensity() const override;
+	const void* PackedVertices() const override { return vertices.data(); }
+	const void* PackedIndices() const override { return indices.data(); }
+};
+
+// A Wavefront OBJ read without Assimp. The memory mapped file is split into chunks that end
+// at line breaks and every chunk is parsed on its own thread. Indices relative to the end of
+// the vertex lists are resolved once all chunks know their counts, then every material's
+// corners are merged through a hash table, materials again in parallel.
+class ObjDocument
+{
+public:
+	// Threads to parse with, 0 for one per core
+	unsigned int numThreads = 0;
+	std::vector<ObjMaterial> materials;
+	// In the order their materials are first used
+	std::vector<ObjMesh> meshes;
+
+	// Prints why and returns false for files that can't be read or have faces without normals,
+	// which Assimp generates. flipV stores 1 - v, OBJ puts the UV origin at the bottom left.
+	bool Load(const std::string& path, bool flipV);
+	// Parses OBJ text, .mtl libraries are read from directory
+	bool Parse(const char* text, size_t size, const std::string& directory, bool flipV);
+
+private:
+	void LoadMaterials(const std::string& path);
+};
@@ -0,0 +1,496 @@
+#include "Pmx.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "Animation.h"
+#include "MappedFile.h"
+
+namespace
+{
+	enum pmxGlobal
+	{
+		PMX_TEXT_ENCODING,
+		PMX_ADDITIONAL_VEC4,
+		PMX_VERTEX_INDEX_SIZE,
+		PMX_TEXTURE_INDEX_SIZE,
+		PMX_MATERIAL_INDEX_SIZE,
+		PMX_BONE_INDEX_SIZE,
+		PMX_MORPH_INDEX_SIZE,
+		PMX_RIGID_BODY_INDEX_SIZE,
+		PMX_GLOBAL_COUNT
+	};
+
+	// Reads little endian values front to back. Reading past the end returns zeros and sets
+	// failed, so a section is checked once instead of every read.
+	struct PmxReader
+	{
+		const unsigned char* data;
+		const unsigned char* end;
+		bool failed = false;
+
+		size_t Remaining() const
+		{
+			return (size_t)(end - data);
+		}
+
+		const unsigned char* Take(size_t bytes)
+		{
+			if (failed || bytes > Remaining())
+			{
+				failed = true;
+				return nullptr;
+			}
+			const unsigned char* taken = data;
+			data += bytes;
+			return taken;
+		}
+
+		template <typename T>
+		T Read()
+		{
+			T value = T();
+			if (const unsigned char* bytes = Take(sizeof(T)))
+				std::memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
+
+		// Texture, material and bone indices are signed, -1 is none
+		int Index(int size)
+		{
+			switch (size)
+			{
+			case 1: return Read<int8_t>();
+			case 2: return Read<int16_t>();
+			default: return Read<int32_t>();
+			}
+		}
+
+		// Vertex indices are unsigned unless they take 4 bytes
+		GLuint VertexIndex(int size)
+		{
+			switch (size)
+			{
+			case 1: return Read<uint8_t>();
+			case 2: return Read<uint16_t>();
+			default: return (GLuint)Read<int32_t>();
+			}
+		}
+
+		// Length prefixed UTF-16LE or UTF-8 text as a UTF-8 string in the arena
+		const char* Text(bool utf8, Arena& arena)
+		{
+			int32_t length = Read<int32_t>();
+			const unsigned char* bytes = Take(length > 0 ? (size_t)length : 0);
+			if (!bytes || length <= 0)
+				return "";
+
+			// A UTF-16 unit never takes more than 3 bytes in UTF-8, a surrogate pair 4
+			char* text = arena.Allocate<char>(utf8 ? length + 1 : (size_t)length / 2 * 3 + 1);
+			if (!text)
+				return "";
+			if (utf8)
+			{
+				std::memcpy(text, bytes, length);
+				text[length] = '\0';
+				return text;
+			}
+
+			char* out = text;
+			for (int32_t i = 0; i + 1 < length; i += 2)
+			{
+				uint32_t c = bytes[i] | bytes[i + 1] << 8;
+				if (c >= 0xD800 && c < 0xDC00 && i + 3 < length)
+				{
+					uint32_t low = bytes[i + 2] | bytes[i + 3] << 8;
+					if (low >= 0xDC00 && low < 0xE000)
+					{
+						c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+						i += 2;
+					}
+				}
+				if (c < 0x80)
+				{
+					*out++ = (char)c;
+				}
+				else if (c < 0x800)
+				{
+					*out++ = (char)(0xC0 | c >> 6);
+					*out++ = (char)(0x80 | (c & 0x3F));
+				}
+				else if (c < 0x10000)
+				{
+					*out++ = (char)(0xE0 | c >> 12);
+					*out++ = (char)(0x80 | (c >> 6 & 0x3F));
+					*out++ = (char)(0x80 | (c & 0x3F));
+				}
+				else
+				{
+					*out++ = (char)(0xF0 | c >> 18);
+					*out++ = (char)(0x80 | (c >> 12 & 0x3F));
+					*out++ = (char)(0x80 | (c >> 6 & 0x3F));
+					*out++ = (char)(0x80 | (c & 0x3F));
+				}
+			}
+			*out = '\0';
+			return text;
+		}
+	};
+
+	// Bone weights of a vertex with the given deform type, false for unknown types
+	bool readBoneWeights(PmxReader& reader, uint8_t type, int boneIndexSize, VertexSkin& skin)
+	{
+		JointInfluences influences;
+		switch (type)
+		{
+		case 0:                                                           // BDEF1
+			influences.Add(reader.Index(boneIndexSize), 1.0f);
+			break;
+		case 1:                                                           // BDEF2
+		case 3:                                                           // SDEF
+		{
+			int first = reader.Index(boneIndexSize);
+			int second = reader.Index(boneIndexSize);
+			float weight = reader.Read<float>();
+			influences.Add(first, weight);
+			influences.Add(second, 1.0f - weight);
+			// Center and the two reference points of spherical deformation
+			if (type == 3)
+				reader.Take(3 * sizeof(glm::vec3));
+			break;
+		}
+		case 2:                                                           // BDEF4
+		case 4:                                                           // QDEF, PMX 2.1
+		{
+			int bones[4];
+			for (int i = 0; i < 4; i++)
+				bones[i] = reader.Index(boneIndexSize);
+			for (int i = 0; i < 4; i++)
+				influences.Add(bones[i], reader.Read<float>());
+			break;
+		}
+		default:
+			return false;
+		}
+		// Bone -1 stands for none, its weight is dropped
+		for (int i = 0; i < 4; i++)
+		{
+			if (influences.joints[i] < 0)
+				influences.weights[i] = 0.0f;
+		}
+		skin = influences.Pack();
+		return true;
+	}
+}
+
+bool PmxDocument::Load(const std::string& path, bool flipV)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cout << "ERROR::PMX::FILE_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	PmxReader reader = { file.Data(), file.Data() + file.Size() };
+
+	const unsigned char* magic = reader.Take(4);
+	version = reader.Read<float>();
+	uint8_t numGlobals = reader.Read<uint8_t>();
+	if (!magic || std::memcmp(magic, "PMX ", 4) != 0 || version < 2.0f || numGlobals < PMX_GLOBAL_COUNT)
+	{
+		std::cout << "ERROR::PMX::NOT_PMX_2: " << path << std::endl;
+		return false;
+	}
+	int globals[PMX_GLOBAL_COUNT];
+	const unsigned char* globalBytes = reader.Take(numGlobals);
+	for (int i = 0; i < PMX_GLOBAL_COUNT; i++)
+		globals[i] = globalBytes ? globalBytes[i] : 0;
+	for (int i = PMX_VERTEX_INDEX_SIZE; i < PMX_GLOBAL_COUNT; i++)
+	{
+		if (globals[i] != 1 && globals[i] != 2 && globals[i] != 4)
+		{
+			std::cout << "ERROR::PMX::INDEX_SIZE_NOT_SUPPORTED: " << globals[i] << " in " << path << std::endl;
+			return false;
+		}
+	}
+	bool utf8 = globals[PMX_TEXT_ENCODING] == 1;
+	int vertexIndexSize = globals[PMX_VERTEX_INDEX_SIZE];
+	int textureIndexSize = globals[PMX_TEXTURE_INDEX_SIZE];
+	int boneIndexSize = globals[PMX_BONE_INDEX_SIZE];
+
+	// Local and universal names and comments
+	name = reader.Text(utf8, arena);
+	reader.Text(utf8, arena);
+	reader.Text(utf8, arena);
+	reader.Text(utf8, arena);
+
+	// Counts are checked against the bytes left before anything is allocated for them, so a
+	// broken file can't ask for more memory than it could possibly describe
+	const size_t MIN_VERTEX_BYTES = 8 * sizeof(float) + 1 + 1 + sizeof(float);
+	int32_t vertexCount = reader.Read<int32_t>();
+	if (reader.failed || vertexCount < 0 || (size_t)vertexCount > reader.Remaining() / MIN_VERTEX_BYTES)
+	{
+		std::cout << "ERROR::PMX::VERTICES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	numVertices = (size_t)vertexCount;
+	vertices = arena.Allocate<Vertex>(numVertices);
+	skins = arena.Allocate<VertexSkin>(numVertices);
+	size_t additionalBytes = (size_t)globals[PMX_ADDITIONAL_VEC4] * sizeof(glm::vec4);
+	for (size_t i = 0; i < numVertices && !reader.failed; i++)
+	{
+		const unsigned char* bytes = reader.Take(8 * sizeof(float));
+		if (!bytes)
+			break;
+		float values[8];
+		std::memcpy(values, bytes, sizeof(values));
+		Vertex& vertex = vertices[i];
+		vertex.position = glm::vec3(values[0], values[1], -values[2]);
+		vertex.normal = glm::vec3(values[3], values[4], -values[5]);
+		vertex.texureUV = glm::vec2(values[6], flipV ? 1.0f - values[7] : values[7]);
+
+		reader.Take(additionalBytes);
+		if (!readBoneWeights(reader, reader.Read<uint8_t>(), boneIndexSize, skins[i]))
+			reader.failed = true;
+		// Edge scale
+		reader.Take(sizeof(float));
+	}
+	if (reader.failed)
+	{
+		std::cout << "ERROR::PMX::VERTICES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+
+	int32_t indexCount = reader.Read<int32_t>();
+	if (reader.failed || indexCount < 0 || (size_t)indexCount > reader.Remaining() / vertexIndexSize)
+	{
+		std::cout << "ERROR::PMX::FACES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	numIndices = (size_t)indexCount;
+	indices = arena.Allocate<GLuint>(numIndices);
+	if (vertexIndexSize == 4)
+	{
+		if (const unsigned char* bytes = reader.Take(numIndices * sizeof(GLuint)))
+			std::memcpy(indices, bytes, numIndices * sizeof(GLuint));
+	}
+	else
+	{
+		for (size_t i = 0; i < numIndices; i++)
+			indices[i] = reader.VertexIndex(vertexIndexSize);
+	}
+
+	int32_t textureCount = reader.Read<int32_t>();
+	if (reader.failed || textureCount < 0 || (size_t)textureCount > reader.Remaining() / sizeof(int32_t))
+	{
+		std::cout << "ERROR::PMX::TEXTURES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	numTextures = (size_t)textureCount;
+	textures = arena.Allocate<const char*>(numTextures);
+	for (size_t i = 0; i < numTextures; i++)
+	{
+		char* texture = (char*)reader.Text(utf8, arena);
+		std::replace(texture, texture + std::strlen(texture), '\\', '/');
+		textures[i] = texture;
+	}
+
+	const size_t MIN_MATERIAL_BYTES = 2 * sizeof(int32_t) + 17 * sizeof(float) + 1 + 4 + 3;
+	int32_t materialCount = reader.Read<int32_t>();
+	if (reader.failed || materialCount < 0 || (size_t)materialCount > reader.Remaining() / MIN_MATERIAL_BYTES)
+	{
+		std::cout << "ERROR::PMX::MATERIALS_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	numMaterials = (size_t)materialCount;
+	materials = arena.Allocate<PmxMaterial>(numMaterials);
+	size_t firstIndex = 0;
+	for (size_t i = 0; i < numMaterials; i++)
+	{
+		PmxMaterial& material = *new (&materials[i]) PmxMaterial();
+		material.name = reader.Text(utf8, arena);
+		reader.Text(utf8, arena);
+		material.diffuse = reader.Read<glm::vec4>();
+		// Specular, specular strength, ambient, drawing flags, edge color and edge size
+		reader.Take(sizeof(glm::vec3) + sizeof(float) + sizeof(glm::vec3) + 1 + sizeof(glm::vec4) + sizeof(float));
+		material.texture = reader.Index(textureIndexSize);
+		// Sphere map and its blend mode, then a shared toon (a byte) or a toon texture
+		reader.Index(textureIndexSize);
+		reader.Read<uint8_t>();
+		if (reader.Read<uint8_t>() == 1)
+			reader.Read<uint8_t>();
+		else
+			reader.Index(textureIndexSize);
+		reader.Text(utf8, arena);
+		int32_t materialIndices = reader.Read<int32_t>();
+		if (reader.failed || materialIndices < 0 || (size_t)materialIndices > numIndices - firstIndex)
+		{
+			std::cout << "ERROR::PMX::MATERIALS_NOT_READ: " << path << std::endl;
+			return false;
+		}
+		if (material.texture >= (int)numTextures)
+			material.texture = -1;
+		material.firstIndex = firstIndex;
+		material.numIndices = (size_t)materialIndices;
+		firstIndex += material.numIndices;
+	}
+
+	const size_t MIN_BONE_BYTES = 2 * sizeof(int32_t) + sizeof(glm::vec3) + 1 + sizeof(int32_t) + sizeof(uint16_t) + 1;
+	int32_t boneCount = reader.Read<int32_t>();
+	if (reader.failed || boneCount < 0 || (size_t)boneCount > reader.Remaining() / MIN_BONE_BYTES)
+	{
+		std::cout << "ERROR::PMX::BONES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	numBones = (size_t)boneCount;
+	bones = arena.Allocate<PmxBone>(numBones);
+	for (size_t i = 0; i < numBones && !reader.failed; i++)
+	{
+		PmxBone& bone = *new (&bones[i]) PmxBone();
+		bone.name = reader.Text(utf8, arena);
+		reader.Text(utf8, arena);
+		glm::vec3 position = reader.Read<glm::vec3>();
+		bone.position = glm::vec3(position.x, position.y, -position.z);
+		bone.parent = reader.Index(boneIndexSize);
+		if (bone.parent < 0 || bone.parent >= boneCount || (size_t)bone.parent == i)
+			bone.parent = -1;
+		// Deform layer, then what follows depends on the flags
+		reader.Read<int32_t>();
+		uint16_t flags = reader.Read<uint16_t>();
+		if (flags & 0x0001)
+			reader.Index(boneIndexSize);
+		else
+			reader.Take(sizeof(glm::vec3));
+		// Inherited rotation or translation, fixed axis, local axes and external parent
+		if (flags & 0x0300)
+			reader.Take((size_t)boneIndexSize + sizeof(float));
+		if (flags & 0x0400)
+			reader.Take(sizeof(glm::vec3));
+		if (flags & 0x0800)
+			reader.Take(2 * sizeof(glm::vec3));
+		if (flags & 0x2000)
+			reader.Take(sizeof(int32_t));
+		if (flags & 0x0020)
+		{
+			// IK target, loop count, angle limit and the links with optional angle limits
+			reader.Take((size_t)boneIndexSize + sizeof(int32_t) + sizeof(float));
+			int32_t numLinks = reader.Read<int32_t>();
+			if (numLinks < 0)
+				reader.failed = true;
+			for (int32_t link = 0; link < numLinks && !reader.failed; link++)
+			{
+				reader.Index(boneIndexSize);
+				if (reader.Read<uint8_t>() == 1)
+					reader.Take(2 * sizeof(glm::vec3));
+			}
+		}
+	}
+	if (reader.failed)
+	{
+		std::cout << "ERROR::PMX::BONES_NOT_READ: " << path << std::endl;
+		return false;
+	}
+	// Weights on bones the file doesn't have go to the first one
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			if (skins[i].joints[j] >= numBones)
+				skins[i].joints[j] = 0;
+		}
+	}
+
+	// Materials of MMD models use vertices scattered over the whole list, so each gets a copy of
+	// the ones its faces use, in the order they are first used. Every face belongs to one
+	// material, its indices are rewritten in place. Indices past the vertices become 0.
+	GLuint* owner = arena.Allocate<GLuint>(numVertices);
+	GLuint* remap = arena.Allocate<GLuint>(numVertices);
+	std::fill(owner, owner + numVertices, 0);
+	for (size_t i = 0; i < numMaterials; i++)
+	{
+		PmxMaterial& material = materials[i];
+		GLuint* first = indices + material.firstIndex;
+		GLuint* last = first + material.numIndices;
+		GLuint stamp = (GLuint)i + 1;
+		for (GLuint* index = first; index != last; index++)
+		{
+			if (*index < numVertices && owner[*index] != stamp)
+			{
+				owner[*index] = stamp;
+				remap[*index] = (GLuint)material.numVertices++;
+			}
+		}
+
+		Vertex* materialVertices = arena.Allocate<Vertex>(material.numVertices);
+		VertexSkin* materialSkins = arena.Allocate<VertexSkin>(material.numVertices);
+		material.vertices = materialVertices;
+		material.skins = materialSkins;
+		for (GLuint* index = first; index != last; index++)
+		{
+			if (*index < numVertices)
+			{
+				materialVertices[remap[*index]] = vertices[*index];
+				const VertexSkin& skin = skins[*index];
+				materialSkins[remap[*index]] = skin;
+				for (int j = 0; j < 4 && numBones > 0 && !material.skinned; j++)
+					material.skinned = skin.weights[j] > 0 && bones[skin.joints[j]].parent >= 0;
+				*index = remap[*index];
+			}
+			else
+			{
+				*index = 0;
+			}
+		}
+
+		if (material.numVertices == 0)
+			continue;
+		material.aabbMin = glm::vec3(FLT_MAX);
+		material.aabbMax = glm::vec3(-FLT_MAX);
+		for (size_t v = 0; v < material.numVertices; v++)
+		{
+			material.aabbMin = glm::min(material.aabbMin, materialVertices[v].position);
+			material.aabbMax = glm::max(material.aabbMax, materialVertices[v].position);
+		}
+	}
+	return true;
+}
+
+void PmxMaterialMesh::WriteVertices(Vertex* out) const
+{
+	std::memcpy(out, material.vertices, material.numVertices * sizeof(Vertex));
+}
+
+void PmxMaterialMesh::WriteSkins(VertexSkin* out) const
+{
+	std::memcpy(out, material.skins, material.numVertices * sizeof(VertexSkin));
+}
+
+void PmxMaterialMesh::WritePositions(glm::vec3* out) const
+{
+	for (size_t i = 0; i < material.numVertices; i++)
+		out[i] = material.vertices[i].position;
+}
+
+void PmxMaterialMesh::WriteIndices(GLuint* out) const
+{
+	std::memcpy(out, document.indices + material.firstIndex, material.numIndices * sizeof(GLuint));
+}
+
+float PmxMaterialMesh::TextureCoordinateDensity() const
+{
+	const Vertex* vertices = material.vertices;
+	const GLuint* indices = document.indices + material.firstIndex;
+	TriangleAreas areas;
+	for (size_t i = 0; i + 2 < material.numIndices; i += 3)
+	{
+		const Vertex& a = vertices[indices[i]];
+		const Vertex& b = vertices[indices[i + 1]];
+		const Vertex& c = vertices[indices[i + 2]];
+		areas.Add(a.position, b.position, c.position, a.texureUV, b.texureUV, c.texureUV);
+	}
+	return areas.Density();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "Arena.h"
+#include "MeshProcessing.h"
+#include "VertexBuffer.h"
+
+// Part of the face list drawn with one material, with its own copy of the vertices it uses.
+// Its indices point into that copy, so every material can become a mesh of its own.
+struct PmxMaterial
+{
+	// UTF-8, in the document's arena
+	const char* name = "";
+	// Index into the texture table or -1
+	int texture = -1;
+	glm::vec4 diffuse = glm::vec4(1.0f);
+	// In the document's arena
+	const Vertex* vertices = nullptr;
+	// Parallel to vertices
+	const VertexSkin* skins = nullptr;
+	// Some vertex is weighted to a bone that has a parent. Materials held by root bones alone
+	// are rigid and get no skin stream.
+	bool skinned = false;
+	size_t numVertices = 0;
+	size_t firstIndex = 0;
+	size_t numIndices = 0;
+	glm::vec3 aabbMin = glm::vec3(0.0f);
+	glm::vec3 aabbMax = glm::vec3(0.0f);
+};
+
+// A joint of the model, placed in model space. Bones may come before their parents.
+struct PmxBone
+{
+	// UTF-8, in the document's arena
+	const char* name = "";
+	// Index into the bones or -1
+	int parent = -1;
+	glm::vec3 position = glm::vec3(0.0f);
+};
+
+// A PMX 2.0 or 2.1 model read without Assimp. The memory mapped file is parsed front to back in
+// one pass and everything decoded from it goes into one arena, vertices, their bone weights,
+// faces, texture paths, materials and bones alike. Morphs and physics come after the bones and
+// are not read. Unlike Assimp, faces keep sharing their vertices.
+//
+// SDEF vertices are weighted like BDEF2 ones and inherited or IK bones like any other, there is
+// no motion to solve them for.
+//
+// Positions and normals are mirrored along z like Assimp does, from the left handed MMD space.
+class PmxDocument
+{
+public:
+	float version = 0.0f;
+	const char* name = "";
+	// Every vertex of the file, the materials draw from copies
+	Vertex* vertices = nullptr;
+	// Up to four bones per vertex, parallel to vertices
+	VertexSkin* skins = nullptr;
+	size_t numVertices = 0;
+	GLuint* indices = nullptr;
+	size_t numIndices = 0;
+	// Relative to the model with / as separator
+	const char** textures = nullptr;
+	size_t numTextures = 0;
+	PmxMaterial* materials = nullptr;
+	size_t numMaterials = 0;
+	PmxBone* bones = nullptr;
+	size_t numBones = 0;
+
+	// Prints why and returns false for files that aren't PMX or end early. flipV stores 1 - v,
+	// PMX puts the UV origin at the top left.
+	bool Load(const std::string& path, bool flipV);
+	size_t ArenaBytes() const { return arena.BytesReserved(); }
+
+private:
+	Arena arena;
+};
+
+// The triangles of one material, uploaded straight from the document
+class PmxMaterialMesh : public MeshSource
+{
+public:
+	PmxMaterialMesh(const PmxDocument& document, const PmxMaterial& material) : document(document), material(material) {}
+
+	size_t NumVertices() const override { return material.numVertices; }
+	size_t NumIndices() const override { return material.numIndices; }
+	void WriteVertices(Vertex* out) const override;
+	void WritePositions(glm::vec3* out) const override;
+	void WriteIndices(GLuint* out) const override;
+	float TextureCoordinateDensity() const override;
+	const void* PackedVertices() const override { return material.vertices; }
+	const void* PackedIndices() const override { return document.indices + material.firstIndex; }
+	bool HasSkins() const override { return material.skinned; }
+	void WriteSkins(VertexSkin* out) const override;
+	const VertexSkin* PackedSkins() const override { return material.skins; }
+
+private:
+	const PmxDocument& document;
+	const PmxMaterial& material;
+};
@@ -0,0 +1,446 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "imgui.h"
+
+#include "Json.h"
+
+const int Profiler::QUERY_LATENCY;
+const int Profiler::HISTORY_SIZE;
+bool Profiler::enabled = true;
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct ProfileEvent
+	{
+		const char* name;
+		int depth;
+		// Microseconds since the profiler started
+		double cpuStart;
+		double cpuEnd;
+		// Timestamp query indices of the frame, -1 for CPU only scopes
+		int beginQuery;
+		int endQuery;
+		// Placed on the CPU timeline, the GPU track starts with the frame's CPU start
+		double gpuStart;
+		double gpuEnd;
+	};
+
+	struct ProfileFrame
+	{
+		unsigned long long number = 0;
+		bool gpuValid = false;
+		// The first event is always the whole frame
+		std::vector<ProfileEvent> events;
+	};
+
+	// Frame waiting for its timestamp queries
+	struct QuerySlot
+	{
+		ProfileFrame frame;
+		std::vector<GLuint> queries;
+		int usedQueries = 0;
+		bool pending = false;
+	};
+
+	struct ScopeHistory
+	{
+		float cpu[Profiler::HISTORY_SIZE];
+		float gpu[Profiler::HISTORY_SIZE];
+		int next = 0;
+		int count = 0;
+	};
+
+	Clock::time_point startTime = Clock::now();
+	QuerySlot slots[Profiler::QUERY_LATENCY];
+	unsigned long long frameNumber = 0;
+	bool inFrame = false;
+	std::vector<int> scopeStack;
+
+	// Ring buffers of resolved frames and their times
+	ProfileFrame history[Profiler::HISTORY_SIZE];
+	float cpuFrameTimes[Profiler::HISTORY_SIZE];
+	float gpuFrameTimes[Profiler::HISTORY_SIZE];
+	int historyNext = 0;
+	int historyCount = 0;
+	std::map<std::string, ScopeHistory> scopes;
+	bool paused = false;
+
+	// Draws of the frame being recorded and of the last finished one
+	size_t drawCalls = 0;
+	size_t triangles = 0;
+	size_t lastDrawCalls = 0;
+	size_t lastTriangles = 0;
+
+	double Now()
+	{
+		return std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+	}
+
+	QuerySlot& CurrentSlot()
+	{
+		return slots[frameNumber % Profiler::QUERY_LATENCY];
+	}
+
+	int IssueTimestamp()
+	{
+		QuerySlot& slot = CurrentSlot();
+		if (slot.usedQueries == (int)slot.queries.size())
+		{
+			GLuint query;
+			glGenQueries(1, &query);
+			slot.queries.push_back(query);
+		}
+		glQueryCounter(slot.queries[slot.usedQueries], GL_TIMESTAMP);
+		return slot.usedQueries++;
+	}
+
+	void StoreFrame(ProfileFrame& frame)
+	{
+		if (paused || frame.events.empty())
+			return;
+
+		const ProfileEvent& root = frame.events[0];
+		cpuFrameTimes[historyNext] = (float)(root.cpuEnd - root.cpuStart) / 1000.0f;
+		gpuFrameTimes[historyNext] = frame.gpuValid ? (float)(root.gpuEnd - root.gpuStart) / 1000.0f : 0.0f;
+
+		// A scope may run several times per frame, its history holds the sum
+		std::map<std::string, std::pair<float, float>> frameScopes;
+		for (const ProfileEvent& event : frame.events)
+		{
+			std::pair<float, float>& times = frameScopes[event.name];
+			times.first += (float)(event.cpuEnd - event.cpuStart) / 1000.0f;
+			if (frame.gpuValid && event.beginQuery >= 0)
+				times.second += (float)(event.gpuEnd - event.gpuStart) / 1000.0f;
+		}
+		for (auto& frameScope : frameScopes)
+		{
+			ScopeHistory& scope = scopes[frameScope.first];
+			scope.cpu[scope.next] = frameScope.second.first;
+			scope.gpu[scope.next] = frameScope.second.second;
+			scope.next = (scope.next + 1) % Profiler::HISTORY_SIZE;
+			scope.count = std::min(scope.count + 1, Profiler::HISTORY_SIZE);
+		}
+
+		history[historyNext] = std::move(frame);
+		historyNext = (historyNext + 1) % Profiler::HISTORY_SIZE;
+		historyCount = std::min(historyCount + 1, Profiler::HISTORY_SIZE);
+	}
+
+	// Reads the queries of a frame issued QUERY_LATENCY frames ago if they are done, otherwise
+	// its GPU times are dropped instead of waiting
+	void ResolveSlot(QuerySlot& slot)
+	{
+		if (!slot.pending)
+			return;
+		slot.pending = false;
+
+		ProfileFrame& frame = slot.frame;
+		frame.gpuValid = false;
+		if (slot.usedQueries > 0)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(slot.queries[slot.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				std::vector<GLuint64> timestamps(slot.usedQueries);
+				for (int i = 0; i < slot.usedQueries; i++)
+					glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+				GLuint64 frameBegin = timestamps[frame.events[0].beginQuery];
+				double frameStart = frame.events[0].cpuStart;
+				for (ProfileEvent& event : frame.events)
+				{
+					if (event.beginQuery < 0)
+						continue;
+					event.gpuStart = frameStart + (double)(timestamps[event.beginQuery] - frameBegin) / 1000.0;
+					event.gpuEnd = frameStart + (double)(timestamps[event.endQuery] - frameBegin) / 1000.0;
+				}
+				frame.gpuValid = true;
+			}
+		}
+		StoreFrame(frame);
+	}
+
+	ImU32 ScopeColor(const char* name)
+	{
+		unsigned int hash = 2166136261u;
+		for (const char* c = name; *c; c++)
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		return ImColor::HSV((hash % 360) / 360.0f, 0.55f, 0.75f);
+	}
+
+	void DrawTrack(const char* label, const ProfileFrame& frame, bool gpu, double frameStart, double span)
+	{
+		int maxDepth = 0;
+		for (const ProfileEvent& event : frame.events)
+			maxDepth = std::max(maxDepth, event.depth);
+
+		ImGui::TextUnformatted(label);
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+		float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+
+		for (const ProfileEvent& event : frame.events)
+		{
+			if (gpu && event.beginQuery < 0)
+				continue;
+			double start = gpu ? event.gpuStart : event.cpuStart;
+			double end = gpu ? event.gpuEnd : event.cpuEnd;
+			ImVec2 min(origin.x + (float)((start - frameStart) / span) * width, origin.y + event.depth * rowHeight);
+			ImVec2 max(origin.x + (float)((end - frameStart) / span) * width, min.y + rowHeight - 1.0f);
+			max.x = std::max(max.x, min.x + 1.0f);
+
+			drawList->AddRectFilled(min, max, ScopeColor(event.name));
+			ImVec4 clip(min.x, min.y, max.x, max.y);
+			drawList->AddText(NULL, 0.0f, ImVec2(min.x + 2.0f, min.y), IM_COL32_WHITE, event.name, NULL, 0.0f, &clip);
+			if (ImGui::IsMouseHoveringRect(min, max))
+				ImGui::SetTooltip("%s\n%.3f ms", event.name, (end - start) / 1000.0);
+		}
+		ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+	}
+
+	void WriteEvent(std::ofstream& out, bool& first, const char* name, double start, double end, int thread)
+	{
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "{\"name\":" << escapeJson(name);
+		char times[128];
+		snprintf(times, sizeof(times), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", start, end - start, thread);
+		out << times;
+	}
+}
+
+void Profiler::BeginFrame()
+{
+	if (inFrame)
+		EndFrame();
+	if (!enabled)
+		return;
+
+	QuerySlot& slot = CurrentSlot();
+	ResolveSlot(slot);
+	slot.frame.number = frameNumber;
+	slot.frame.events.clear();
+	slot.usedQueries = 0;
+
+	inFrame = true;
+	BeginScope("Frame", true);
+}
+
+void Profiler::EndFrame()
+{
+	lastDrawCalls = drawCalls;
+	lastTriangles = triangles;
+	drawCalls = 0;
+	triangles = 0;
+
+	if (!inFrame)
+		return;
+	while (!scopeStack.empty())
+		EndScope();
+
+	CurrentSlot().pending = true;
+	inFrame = false;
+	frameNumber++;
+}
+
+bool Profiler::BeginScope(const char* name, bool gpu)
+{
+	if (!inFrame)
+		return false;
+
+	ProfileFrame& frame = CurrentSlot().frame;
+	ProfileEvent event = { name, (int)scopeStack.size(), Now(), 0.0, -1, -1, 0.0, 0.0 };
+	if (gpu)
+		event.beginQuery = IssueTimestamp();
+	scopeStack.push_back((int)frame.events.size());
+	frame.events.push_back(event);
+	return true;
+}
+
+void Profiler::EndScope()
+{
+	if (scopeStack.empty())
+		return;
+
+	ProfileEvent& event = CurrentSlot().frame.events[scopeStack.back()];
+	scopeStack.pop_back();
+	if (event.beginQuery >= 0)
+		event.endQuery = IssueTimestamp();
+	event.cpuEnd = Now();
+}
+
+float Profiler::FramePercentile(float fraction, bool gpu)
+{
+	std::vector<float> times;
+	for (int i = 0; i < historyCount; i++)
+		if (!gpu || history[i].gpuValid)
+			times.push_back(gpu ? gpuFrameTimes[i] : cpuFrameTimes[i]);
+	if (times.empty())
+		return 0.0f;
+
+	std::sort(times.begin(), times.end());
+	return times[(size_t)(fraction * (times.size() - 1) + 0.5f)];
+}
+
+int Profiler::NumResolvedFrames()
+{
+	return historyCount;
+}
+
+void Profiler::Reset()
+{
+	for (QuerySlot& slot : slots)
+		slot.pending = false;
+	historyNext = 0;
+	historyCount = 0;
+	scopes.clear();
+}
+
+void Profiler::CountDraw(size_t triangleCount, size_t instances)
+{
+	drawCalls++;
+	triangles += triangleCount * instances;
+}
+
+size_t Profiler::DrawCalls()
+{
+	return lastDrawCalls;
+}
+
+size_t Profiler::Triangles()
+{
+	return lastTriangles;
+}
+
+void Profiler::DrawWindow(bool* open)
+{
+	if (!ImGui::Begin("Profiler", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Checkbox("Enabled", &enabled);
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &paused);
+	ImGui::SameLine();
+	if (ImGui::Button("Export Chrome trace"))
+	{
+		if (ExportChromeTrace("ProfilerTrace.json"))
+			std::cout << "Wrote ProfilerTrace.json" << std::endl;
+	}
+
+	ImGui::Text("CPU frame p50 %.2f  p95 %.2f  p99 %.2f ms",
+		FramePercentile(0.5f, false), FramePercentile(0.95f, false), FramePercentile(0.99f, false));
+	ImGui::Text("GPU frame p50 %.2f  p95 %.2f  p99 %.2f ms",
+		FramePercentile(0.5f, true), FramePercentile(0.95f, true), FramePercentile(0.99f, true));
+
+	// The ring starts at the oldest frame once it is full
+	int offset = historyCount == HISTORY_SIZE ? historyNext : 0;
+	ImGui::PlotLines("CPU ms", cpuFrameTimes, historyCount, offset, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 50.0f));
+	ImGui::PlotLines("GPU ms", gpuFrameTimes, historyCount, offset, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 50.0f));
+
+	if (historyCount > 0)
+	{
+		const ProfileFrame& frame = history[(historyNext + HISTORY_SIZE - 1) % HISTORY_SIZE];
+		const ProfileEvent& root = frame.events[0];
+		double span = root.cpuEnd - root.cpuStart;
+		if (frame.gpuValid)
+			span = std::max(span, root.gpuEnd - root.gpuStart);
+		span = std::max(span, 1.0);
+
+		ImGui::SeparatorText("Timeline");
+		ImGui::Text("Frame %llu", frame.number);
+		DrawTrack("CPU", frame, false, root.cpuStart, span);
+		if (frame.gpuValid)
+			DrawTrack("GPU", frame, true, root.cpuStart, span);
+	}
+
+	ImGui::SeparatorText("Scopes");
+	if (ImGui::BeginTable("Scopes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("CPU avg ms");
+		ImGui::TableSetupColumn("CPU max ms");
+		ImGui::TableSetupColumn("GPU avg ms");
+		ImGui::TableHeadersRow();
+		for (auto& scope : scopes)
+		{
+			const ScopeHistory& times = scope.second;
+			float cpuSum = 0.0f, cpuMax = 0.0f, gpuSum = 0.0f;
+			for (int i = 0; i < times.count; i++)
+			{
+				cpuSum += times.cpu[i];
+				cpuMax = std::max(cpuMax, times.cpu[i]);
+				gpuSum += times.gpu[i];
+			}
+			int count = std::max(times.count, 1);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(scope.first.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", cpuSum / count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", cpuMax);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", gpuSum / count);
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Failed to write " << path << std::endl;
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}";
+	out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	bool first = false;
+
+	int oldest = historyCount == HISTORY_SIZE ? historyNext : 0;
+	for (int i = 0; i < historyCount; i++)
+	{
+		const ProfileFrame& frame = history[(oldest + i) % HISTORY_SIZE];
+		for (const ProfileEvent& event : frame.events)
+		{
+			WriteEvent(out, first, event.name, event.cpuStart, event.cpuEnd, 1);
+			if (frame.gpuValid && event.beginQuery >= 0)
+				WriteEvent(out, first, event.name, event.gpuStart, event.gpuEnd, 2);
+		}
+	}
+	out << "\n]}\n";
+	return (bool)out;
+}
+
+void Profiler::Delete()
+{
+	for (QuerySlot& slot : slots)
+	{
+		if (!slot.queries.empty())
+			glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+		slot.queries.clear();
+		slot.usedQueries = 0;
+		slot.pending = false;
+	}
+}
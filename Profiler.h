@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+// Hierarchical frame profiler for the render thread. Scopes record CPU time and, when asked
+// to, GPU time through GL_TIMESTAMP queries. Those are read back QUERY_LATENCY frames later
+// and only if the driver already has the results, so profiling never waits for the GPU.
+// Resolved frames and per-scope times are kept in ring buffers of HISTORY_SIZE frames.
+//
+//   PROFILE_SCOPE("Cluster binning");    // CPU only
+//   PROFILE_GPU_SCOPE("Geometry pass");  // CPU and GPU
+class Profiler
+{
+public:
+	static const int QUERY_LATENCY = 3;
+	static const int HISTORY_SIZE = 240;
+
+	static bool enabled;
+
+	static void BeginFrame();
+	static void EndFrame();
+	// Returns false outside of a profiled frame, the scope must not be ended then
+	static bool BeginScope(const char* name, bool gpu);
+	static void EndScope();
+
+	// Frame time in milliseconds below which the given fraction of the recorded frames lie
+	static float FramePercentile(float fraction, bool gpu);
+	static int NumResolvedFrames();
+	// Drops the history and the frames still waiting for their queries
+	static void Reset();
+
+	// Counted whether profiling is enabled or not, read back after EndFrame
+	static void CountDraw(size_t triangles, size_t instances = 1);
+	static size_t DrawCalls();
+	static size_t Triangles();
+
+	// Timeline of the last resolved frame, frame time percentiles and per-scope averages
+	static void DrawWindow(bool* open);
+	// Writes every frame in the history as Chrome trace events (chrome://tracing, Perfetto)
+	static bool ExportChromeTrace(const std::string& path);
+	static void Delete();
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, bool gpu) { active = Profiler::BeginScope(name, gpu); }
+	~ProfileScope()
+	{
+		if (active)
+			Profiler::EndScope();
+	}
+
+private:
+	bool active;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, false)
+#define PROFILE_GPU_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, true)
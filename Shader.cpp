@@ -1,4 +1,21 @@
 #include "Shader.h"
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char* SHADER_CACHE_DIRECTORY = "ShaderCache";
+static const uint32_t SHADER_CACHE_MAGIC = 0x42504C47; // "GLPB"
+
+bool Shader::useBinaryCache = true;
+ShaderCacheStats Shader::cacheStats;
 
 std::string get_file_contents(const char* filename)
 {
@@ -18,48 +35,295 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+// Inserts the #define lines right after the #version directive
+static std::string InjectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+
+	size_t versionEnd = source.find('\n', source.find("#version"));
+	if (versionEnd == std::string::npos)
+		return defines + source;
+	// Keep the compiler's line numbers pointing at the original file
+	return source.substr(0, versionEnd + 1) + defines + "#line 2\n" + source.substr(versionEnd + 1);
+}
+
+Shader::Shader(const char* vertexFile, const char* fragmentFile) :
+	vertexFile(vertexFile),
+	fragmentFile(fragmentFile)
+{
+	vertexCode = get_file_contents(vertexFile);
+	fragmentCode = get_file_contents(fragmentFile);
+
+	watchGeneration = ShaderWatcher::Generation();
+	vertexVersion = ShaderWatcher::Watch(vertexFile, vertexCode);
+	fragmentVersion = ShaderWatcher::Watch(fragmentFile, fragmentCode);
+}
+
+Shader::Shader(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines) :
+	vertexCode(InjectDefines(vertexCode, defines)),
+	fragmentCode(InjectDefines(fragmentCode, defines))
+{
+}
+
+// 64-bit FNV-1a, continuing from the given hash
+static uint64_t HashString(const std::string& string, uint64_t hash = 14695981039346656037ull)
+{
+	for (unsigned char c : string)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Returns the cache file of a program, or an empty string if the driver can't return program binaries
+static std::string GetCachePath(const std::string& vertexCode, const std::string& fragmentCode)
 {
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	if (!GLAD_GL_ARB_get_program_binary)
+		return "";
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	if (numFormats == 0)
+		return "";
 
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
+	// Binaries are only valid for the exact driver that produced them
+	std::string driver;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const GLubyte* string = glGetString(name);
+		driver += string ? (const char*)string : "";
+		driver += '\n';
+	}
 
-	// compile the vertex shader
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	glCompileShader(vertexShader);
-	CheckCompileErrors(vertexShader, "VERTEX");
+	uint64_t hash = HashString(driver);
+	hash = HashString(vertexCode, hash);
+	hash = HashString(std::string(1, '\0'), hash);
+	hash = HashString(fragmentCode, hash);
 
-	// compile fragment shader
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	glCompileShader(fragmentShader);
-	CheckCompileErrors(fragmentShader, "FRAGMENT");
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)hash);
+	return std::string(SHADER_CACHE_DIRECTORY) + "/" + fileName;
+}
 
-	// link the shaders
-	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
-	CheckCompileErrors(ID, "PROGRAM");
+void Shader::Submit()
+{
+	if (pendingID != 0 || vertexCode.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	pendingCachePath = useBinaryCache ? GetCachePath(vertexCode, fragmentCode) : "";
+	pendingFromCache = !pendingCachePath.empty() && LoadBinary(pendingCachePath);
+
+	if (!pendingFromCache)
+	{
+		const char* vertexSource = vertexCode.c_str();
+		const char* fragmentSource = fragmentCode.c_str();
+
+		// Nothing here asks for a status, so the driver is free to compile in the background
+		pendingVertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(pendingVertexShader, 1, &vertexSource, NULL);
+		glCompileShader(pendingVertexShader);
+
+		pendingFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(pendingFragmentShader, 1, &fragmentSource, NULL);
+		glCompileShader(pendingFragmentShader);
+
+		pendingID = glCreateProgram();
+		if (!pendingCachePath.empty())
+			glProgramParameteri(pendingID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glAttachShader(pendingID, pendingVertexShader);
+		glAttachShader(pendingID, pendingFragmentShader);
+		glLinkProgram(pendingID);
+	}
+
+	// The sources aren't needed anymore once the driver has them
+	vertexCode.clear();
+	vertexCode.shrink_to_fit();
+	fragmentCode.clear();
+	fragmentCode.shrink_to_fit();
+
+	pendingMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool Shader::IsComplete() const
+{
+	if (pendingFromCache || !GLAD_GL_KHR_parallel_shader_compile)
+		return true;
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(pendingID, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+void Shader::Finish()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	bool linked = pendingFromCache;
+	if (!pendingFromCache)
+	{
+		CheckCompileErrors(pendingVertexShader, "VERTEX");
+		CheckCompileErrors(pendingFragmentShader, "FRAGMENT");
+		linked = CheckCompileErrors(pendingID, "PROGRAM");
+
+		glDeleteShader(pendingVertexShader);
+		glDeleteShader(pendingFragmentShader);
+
+		if (linked && !pendingCachePath.empty())
+			SaveBinary(pendingID, pendingCachePath);
+	}
+
+	// A broken edit keeps the last working program
+	if (linked || ID == 0)
+	{
+		glDeleteProgram(ID);
+		ID = pendingID;
+	}
+	else
+		glDeleteProgram(pendingID);
+	pendingID = 0;
+	pendingVertexShader = 0;
+	pendingFragmentShader = 0;
+
+	float milliseconds = pendingMilliseconds + std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	if (pendingFromCache)
+	{
+		cacheStats.cacheHits++;
+		cacheStats.loadMilliseconds += milliseconds;
+	}
+	else
+	{
+		cacheStats.cacheMisses++;
+		cacheStats.compileMilliseconds += milliseconds;
+	}
+
+	if (linked && onCompile)
+	{
+		glUseProgram(ID);
+		onCompile(*this);
+	}
+}
+
+void Shader::DiscardPending()
+{
+	if (pendingID == 0)
+		return;
+	glDeleteShader(pendingVertexShader);
+	glDeleteShader(pendingFragmentShader);
+	glDeleteProgram(pendingID);
+	pendingID = 0;
+	pendingVertexShader = 0;
+	pendingFragmentShader = 0;
+}
+
+bool Shader::Poll()
+{
+	if (!vertexFile.empty() && watchGeneration != ShaderWatcher::Generation())
+	{
+		watchGeneration = ShaderWatcher::Generation();
+		bool changed = ShaderWatcher::Changed(vertexFile, vertexVersion);
+		changed = ShaderWatcher::Changed(fragmentFile, fragmentVersion) || changed;
+		if (changed)
+			Reload(ShaderWatcher::GetSource(vertexFile), ShaderWatcher::GetSource(fragmentFile));
+	}
+
+	if (pendingID == 0 || !IsComplete())
+		return false;
+	Finish();
+	return true;
+}
+
+void Shader::Reload(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	Shader::vertexCode = vertexCode;
+	Shader::fragmentCode = fragmentCode;
+
+	// A program nobody activated yet just compiles the new sources later
+	if (ID == 0 && pendingID == 0)
+		return;
+	DiscardPending();
+	Submit();
+}
+
+bool Shader::LoadBinary(const std::string& path)
+{
+	std::ifstream inFile(path, std::ios::binary);
+	if (!inFile)
+		return false;
+
+	uint32_t header[2];
+	if (!inFile.read((char*)header, sizeof(header)) || header[0] != SHADER_CACHE_MAGIC)
+		return false;
+
+	// A format the current driver doesn't know would only raise GL_INVALID_ENUM
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	std::vector<GLint> formats(numFormats);
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+	if (std::find(formats.begin(), formats.end(), (GLint)header[1]) == formats.end())
+		return false;
+
+	std::vector<char> binary((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+	pendingID = glCreateProgram();
+	glProgramBinary(pendingID, (GLenum)header[1], binary.data(), (GLsizei)binary.size());
+
+	// The driver rejects binaries from other versions even if the key matched
+	GLint success;
+	glGetProgramiv(pendingID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(pendingID);
+		pendingID = 0;
+		return false;
+	}
+	return true;
+}
+
+void Shader::SaveBinary(GLuint program, const std::string& path)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+#ifdef _WIN32
+	_mkdir(SHADER_CACHE_DIRECTORY);
+#else
+	mkdir(SHADER_CACHE_DIRECTORY, 0755);
+#endif
+	std::ofstream outFile(path, std::ios::binary);
+	if (!outFile)
+		return;
+	uint32_t header[2] = { SHADER_CACHE_MAGIC, format };
+	outFile.write((const char*)header, sizeof(header));
+	outFile.write(binary.data(), length);
 }
 
 void Shader::Activate()
 {
+	if (ID == 0)
+	{
+		Submit();
+		if (pendingID != 0)
+			Finish();
+	}
 	glUseProgram(ID);
 }
 
 void Shader::Delete()
 {
+	DiscardPending();
 	glDeleteProgram(ID);
 }
 
-void Shader::CheckCompileErrors(GLuint shaderID, std::string type)
+bool Shader::CheckCompileErrors(GLuint shaderID, std::string type)
 {
 	GLint success;
 	GLchar infoLog[1024];
@@ -81,4 +345,133 @@ void Shader::CheckCompileErrors(GLuint shaderID, std::string type)
 			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 		}
 	}
+	return success;
+}
+
+
+
+ShaderPermutations::ShaderPermutations(const char* vertexFile, const char* fragmentFile) :
+	vertexFile(vertexFile),
+	fragmentFile(fragmentFile)
+{
+	vertexCode = get_file_contents(vertexFile);
+	fragmentCode = get_file_contents(fragmentFile);
+
+	watchGeneration = ShaderWatcher::Generation();
+	vertexVersion = ShaderWatcher::Watch(vertexFile, vertexCode);
+	fragmentVersion = ShaderWatcher::Watch(fragmentFile, fragmentCode);
+}
+
+Shader& ShaderPermutations::Variant(unsigned int features)
+{
+	auto found = variants.find(features);
+	if (found != variants.end())
+		return found->second;
+
+	Shader& shader = variants.emplace(features, Shader(vertexCode, fragmentCode, Defines(features))).first->second;
+	shader.onCompile = onCompile;
+	return shader;
+}
+
+Shader& ShaderPermutations::Get(unsigned int features)
+{
+	Shader& shader = Variant(features);
+	if (shader.IsCompiled())
+		return shader;
+	shader.Submit();
+
+	// Stand in with a ready variant that has no feature beyond the requested ones
+	Shader* fallback = nullptr;
+	size_t fallbackFeatures = 0;
+	for (auto& variant : variants)
+	{
+		if (!variant.second.IsCompiled() || (variant.first & ~features) != 0)
+			continue;
+		size_t sharedFeatures = std::bitset<32>(variant.first).count();
+		if (!fallback || sharedFeatures > fallbackFeatures)
+		{
+			fallback = &variant.second;
+			fallbackFeatures = sharedFeatures;
+		}
+	}
+	return fallback ? *fallback : shader;
+}
+
+void ShaderPermutations::Submit(unsigned int features)
+{
+	Variant(features).Submit();
+}
+
+void ShaderPermutations::Poll()
+{
+	if (watchGeneration != ShaderWatcher::Generation())
+	{
+		watchGeneration = ShaderWatcher::Generation();
+		bool changed = ShaderWatcher::Changed(vertexFile, vertexVersion);
+		changed = ShaderWatcher::Changed(fragmentFile, fragmentVersion) || changed;
+		if (changed)
+		{
+			vertexCode = ShaderWatcher::GetSource(vertexFile);
+			fragmentCode = ShaderWatcher::GetSource(fragmentFile);
+			for (auto& variant : variants)
+			{
+				std::string defines = Defines(variant.first);
+				variant.second.Reload(InjectDefines(vertexCode, defines), InjectDefines(fragmentCode, defines));
+			}
+		}
+	}
+
+	// Without KHR_parallel_shader_compile the status query blocks, so take one program per frame
+	bool waited = false;
+	for (auto& variant : variants)
+	{
+		if (!variant.second.IsPending())
+			continue;
+		if (!GLAD_GL_KHR_parallel_shader_compile)
+		{
+			if (waited)
+				break;
+			waited = true;
+		}
+		variant.second.Poll();
+	}
+}
+
+void ShaderPermutations::ForEach(const std::function<void(Shader&)>& function)
+{
+	for (auto& variant : variants)
+		if (variant.second.IsCompiled())
+			function(variant.second);
+}
+
+size_t ShaderPermutations::NumCompiled() const
+{
+	size_t compiled = 0;
+	for (auto& variant : variants)
+		if (variant.second.IsCompiled())
+			compiled++;
+	return compiled;
+}
+
+void ShaderPermutations::Delete()
+{
+	for (auto& variant : variants)
+		variant.second.Delete();
+	variants.clear();
+}
+
+std::string ShaderPermutations::Defines(unsigned int features)
+{
+	std::string defines;
+	if (features & FEATURE_LIGHTING)
+		defines += "#define LIGHTING\n";
+	if (features & FEATURE_TEXTURED)
+		defines += "#define TEXTURED\n";
+	if (features & FEATURE_CLUSTERED_LIGHTING)
+		defines += "#define CLUSTERED_LIGHTING\n";
+	if (features & FEATURE_SHADOWS)
+		defines += "#define SHADOWS\n";
+	if (features & FEATURE_SKINNING)
+		defines += "#define SKINNING\n";
+	return defines;
 }
\ No newline at end of file
@@ -8,17 +8,67 @@
 #include <sstream>
 #include <iostream>
 #include <cerrno>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
 
 std::string get_file_contents(const char* filename);
 
+// Compile-time features of the default shader, each one is a #define in the generated source
+enum shaderFeature
+{
+	FEATURE_LIGHTING = 1 << 0,
+	FEATURE_TEXTURED = 1 << 1,
+	FEATURE_CLUSTERED_LIGHTING = 1 << 2,
+	FEATURE_SHADOWS = 1 << 3,
+	FEATURE_SKINNING = 1 << 4
+};
+
+// Startup statistics of all programs linked so far, either loaded from the binary cache or compiled
+struct ShaderCacheStats
+{
+	int cacheHits = 0;
+	int cacheMisses = 0;
+	float loadMilliseconds = 0.0f;
+	float compileMilliseconds = 0.0f;
+};
+
+// Programs are compiled lazily, the first Activate() links them. Linked programs are stored as
+// driver binaries in ShaderCache/ keyed by a hash of the final sources and the driver strings,
+// so the next launch can skip compilation. A stale or rejected binary falls back to the sources.
+//
+// Submit() starts compiling without waiting for the result. With KHR_parallel_shader_compile
+// the driver compiles on its own threads and Poll() picks the program up once it is done;
+// without it the status query in Poll() or Activate() waits for the driver. Shaders loaded from
+// files are recompiled the same way when the ShaderWatcher sees an edit, the old program stays
+// in use until the new one linked.
 class Shader
 {
 public:
 	GLuint ID = 0;
+	// Called every time a program got linked, e.g. to set texture units and static uniforms
+	std::function<void(Shader&)> onCompile;
+
 	Shader(const char* vertexFile, const char* fragmentFile);
+	// Uses already loaded sources, inserting the given #define lines after #version
+	Shader(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines);
 
+	// Waits for the program if it is still compiling
 	void Activate();
 	void Delete();
+	bool IsCompiled() const { return ID != 0; }
+	bool IsPending() const { return pendingID != 0; }
+
+	// Hands the sources to the driver, a no-op if the program is already compiled or compiling
+	void Submit();
+	// Swaps in a finished program and restarts compilation after a file edit, call once per frame
+	// before the shader is used. Returns true if a new program got linked.
+	bool Poll();
+	// Compiles new sources in the background, the current program stays in use meanwhile
+	void Reload(const std::string& vertexCode, const std::string& fragmentCode);
+
+	static bool useBinaryCache;
+	static const ShaderCacheStats& CacheStats() { return cacheStats; }
 
 	// Uniform variable setting function
 	void SetBool(std::string uniformVarName, bool value) const
@@ -75,5 +125,69 @@ public:
 	}
 
 private:
-	void CheckCompileErrors(GLuint shader, std::string type);
+	// Sources kept until the program is submitted
+	std::string vertexCode;
+	std::string fragmentCode;
+
+	// Files this program was loaded from, watched for edits
+	std::string vertexFile;
+	std::string fragmentFile;
+	unsigned int vertexVersion = 0;
+	unsigned int fragmentVersion = 0;
+	unsigned int watchGeneration = 0;
+
+	// Program that is still being compiled or linked by the driver
+	GLuint pendingID = 0;
+	GLuint pendingVertexShader = 0;
+	GLuint pendingFragmentShader = 0;
+	std::string pendingCachePath;
+	bool pendingFromCache = false;
+	float pendingMilliseconds = 0.0f;
+
+	static ShaderCacheStats cacheStats;
+
+	bool IsComplete() const;
+	void Finish();
+	void DiscardPending();
+	bool LoadBinary(const std::string& path);
+	void SaveBinary(GLuint program, const std::string& path);
+	bool CheckCompileErrors(GLuint shader, std::string type);
+};
+
+// All variants of one vertex/fragment pair. Sources are read once, a variant is created the
+// first time its feature key is requested and compiled when it is first activated.
+class ShaderPermutations
+{
+public:
+	// Passed on to every variant, see Shader::onCompile
+	std::function<void(Shader&)> onCompile;
+
+	ShaderPermutations(const char* vertexFile, const char* fragmentFile);
+
+	// Returns the variant if it is ready, otherwise starts compiling it and returns the ready
+	// variant with the most of the requested features. Only waits if no variant is ready yet.
+	Shader& Get(unsigned int features);
+	// Starts compiling a variant ahead of its first use
+	void Submit(unsigned int features);
+	// Polls every variant and recompiles them after an edit of the shader files, once per frame
+	void Poll();
+	// Applies state to every variant compiled so far
+	void ForEach(const std::function<void(Shader&)>& function);
+	void Delete();
+
+	size_t NumVariants() const { return variants.size(); }
+	size_t NumCompiled() const;
+	static std::string Defines(unsigned int features);
+
+private:
+	std::string vertexCode;
+	std::string fragmentCode;
+	std::string vertexFile;
+	std::string fragmentFile;
+	unsigned int vertexVersion = 0;
+	unsigned int fragmentVersion = 0;
+	unsigned int watchGeneration = 0;
+	std::unordered_map<unsigned int, Shader> variants;
+
+	Shader& Variant(unsigned int features);
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "ShaderWatcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+#include "Shader.h"
+
+namespace
+{
+	struct WatchedFile
+	{
+		// Modification time and size together detect saves within the same second
+		long long modifiedTime = 0;
+		long long size = 0;
+		unsigned int version = 0;
+		std::string source;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, WatchedFile> files;
+	std::atomic<unsigned int> generation(0);
+	std::atomic<bool> running(false);
+	std::thread thread;
+
+	bool GetFileStamp(const std::string& path, long long& modifiedTime, long long& size)
+	{
+		struct stat fileStat;
+		if (stat(path.c_str(), &fileStat) != 0)
+			return false;
+		modifiedTime = (long long)fileStat.st_mtime;
+		size = (long long)fileStat.st_size;
+		return true;
+	}
+
+	void WatchFiles(int intervalMilliseconds)
+	{
+		while (running)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMilliseconds));
+
+			std::vector<std::pair<std::string, WatchedFile>> snapshot;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (auto& file : files)
+				{
+					WatchedFile stamp;
+					stamp.modifiedTime = file.second.modifiedTime;
+					stamp.size = file.second.size;
+					snapshot.emplace_back(file.first, stamp);
+				}
+			}
+
+			// Reading happens without the lock, the render thread never waits for the disk
+			for (auto& file : snapshot)
+			{
+				long long modifiedTime, size;
+				if (!GetFileStamp(file.first, modifiedTime, size)
+					|| (modifiedTime == file.second.modifiedTime && size == file.second.size))
+					continue;
+
+				std::string source;
+				try
+				{
+					source = get_file_contents(file.first.c_str());
+				}
+				catch (...)
+				{
+					// The editor may still be writing the file, try again next time
+					continue;
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				WatchedFile& watched = files[file.first];
+				watched.modifiedTime = modifiedTime;
+				watched.size = size;
+				watched.source = std::move(source);
+				watched.version++;
+				generation++;
+			}
+		}
+	}
+}
+
+void ShaderWatcher::Start(int intervalMilliseconds)
+{
+	if (running)
+		return;
+	running = true;
+	thread = std::thread(WatchFiles, intervalMilliseconds);
+}
+
+void ShaderWatcher::Stop()
+{
+	if (!running)
+		return;
+	running = false;
+	thread.join();
+}
+
+bool ShaderWatcher::IsRunning()
+{
+	return running;
+}
+
+unsigned int ShaderWatcher::Watch(const std::string& path, const std::string& source)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = files.find(path);
+	if (found != files.end())
+		return found->second.version;
+	WatchedFile& file = files[path];
+	GetFileStamp(path, file.modifiedTime, file.size);
+	file.source = source;
+	return file.version;
+}
+
+unsigned int ShaderWatcher::Generation()
+{
+	return generation;
+}
+
+bool ShaderWatcher::Changed(const std::string& path, unsigned int& version)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = files.find(path);
+	if (found == files.end() || found->second.version == version)
+		return false;
+	version = found->second.version;
+	return true;
+}
+
+std::string ShaderWatcher::GetSource(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = files.find(path);
+	return found != files.end() ? found->second.source : std::string();
+}
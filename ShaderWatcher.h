@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Watches shader source files on a background thread and reads them again once they change
+// on disk. The render thread only compares the generation counter each frame and picks up
+// the new sources of its own files, so an edit never waits for file IO.
+class ShaderWatcher
+{
+public:
+	static void Start(int intervalMilliseconds = 250);
+	static void Stop();
+	static bool IsRunning();
+
+	// Starts tracking a file with the contents that were just read from it, returns its version
+	static unsigned int Watch(const std::string& path, const std::string& source);
+	// Increased whenever any watched file changed, cheap enough to check every frame
+	static unsigned int Generation();
+	// True if the file changed since the given version, which is then updated
+	static bool Changed(const std::string& path, unsigned int& version);
+	static std::string GetSource(const std::string& path);
+};
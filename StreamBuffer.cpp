@@ -0,0 +1,128 @@
+#include "StreamBuffer.h"
+
+#include <iostream>
+
+const int StreamBuffer::NUM_REGIONS;
+bool StreamBuffer::allowPersistentMapping = true;
+
+// Texels are RGBA32F, a write starts on a whole texel
+static const size_t TEXEL_SIZE = 16;
+
+void StreamBuffer::Create(size_t regionBytes)
+{
+	glGenTextures(1, &textureID);
+	Allocate(regionBytes);
+}
+
+void StreamBuffer::Allocate(size_t regionBytes)
+{
+	StreamBuffer::regionBytes = (regionBytes + TEXEL_SIZE - 1) / TEXEL_SIZE * TEXEL_SIZE;
+	size_t totalBytes = StreamBuffer::regionBytes * NUM_REGIONS;
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_TEXTURE_BUFFER, ID);
+	if (allowPersistentMapping && GLAD_GL_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_TEXTURE_BUFFER, totalBytes, NULL, flags);
+		persistent = (unsigned char*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, totalBytes, flags);
+		if (!persistent)
+			std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAPPING_FAILED" << std::endl;
+	}
+	else
+	{
+		glBufferData(GL_TEXTURE_BUFFER, totalBytes, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, ID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	region = 0;
+	used = 0;
+}
+
+void StreamBuffer::Release()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	// Deleting unmaps, draws already submitted keep the storage alive until they are done
+	glDeleteBuffers(1, &ID);
+	ID = 0;
+	persistent = nullptr;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	region = (region + 1) % NUM_REGIONS;
+	used = 0;
+
+	GLsync& fence = fences[region];
+	if (!fence)
+		return;
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		stalls++;
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamBuffer::EndFrame()
+{
+	lastFrameBytes = used;
+	if (used > 0)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool StreamBuffer::Fits(size_t bytes) const
+{
+	return used + bytes <= regionBytes;
+}
+
+void* StreamBuffer::Map(size_t bytes, size_t& offset)
+{
+	offset = region * regionBytes + used;
+	used += (bytes + TEXEL_SIZE - 1) / TEXEL_SIZE * TEXEL_SIZE;
+	if (persistent)
+		return persistent + offset;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, ID);
+	return glMapBufferRange(GL_TEXTURE_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void StreamBuffer::Unmap()
+{
+	// Coherent mappings need neither an unmap nor a flush
+	if (persistent)
+		return;
+	glUnmapBuffer(GL_TEXTURE_BUFFER);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void StreamBuffer::Grow(size_t regionBytes)
+{
+	Release();
+	Allocate(regionBytes);
+}
+
+void StreamBuffer::Bind(GLuint unit)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+}
+
+void StreamBuffer::Delete()
+{
+	Release();
+	glDeleteTextures(1, &textureID);
+	textureID = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Buffer for data the CPU writes every frame, split into NUM_REGIONS regions that are used
+// in turn. Each frame writes linearly into its own region and ends with a fence, a region is
+// only written again once the GPU passed the fence of the frame that used it NUM_REGIONS
+// frames before.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and coherently. On plain
+// GL 3.3 every write maps its range with GL_MAP_UNSYNCHRONIZED_BIT, the fences keep that safe.
+// The data is read in shaders through a RGBA32F texture buffer over the whole buffer.
+class StreamBuffer
+{
+public:
+	static const int NUM_REGIONS = 3;
+
+	// Cleared to test the GL 3.3 path on drivers that have ARB_buffer_storage
+	static bool allowPersistentMapping;
+
+	GLuint ID = 0;
+	GLuint textureID = 0;
+
+	void Create(size_t regionBytes);
+	// Moves on to the next region, waits if the GPU still reads it
+	void BeginFrame();
+	void EndFrame();
+
+	bool Fits(size_t bytes) const;
+	// Where to write bytes in the current region, offset is counted from the start of the
+	// buffer. Every Map must be followed by Unmap before drawing.
+	void* Map(size_t bytes, size_t& offset);
+	void Unmap();
+	// Reallocates with larger regions, everything written in this frame is lost
+	void Grow(size_t regionBytes);
+
+	void Bind(GLuint unit);
+	void Delete();
+
+	bool IsPersistent() const { return persistent != nullptr; }
+	size_t RegionBytes() const { return regionBytes; }
+	size_t FrameBytes() const { return lastFrameBytes; }
+	// Frames that had to wait for the GPU to release their region
+	int Stalls() const { return stalls; }
+
+private:
+	size_t regionBytes = 0;
+	int region = 0;
+	size_t used = 0;
+	size_t lastFrameBytes = 0;
+	int stalls = 0;
+	GLsync fences[NUM_REGIONS] = {};
+	unsigned char* persistent = nullptr;
+
+	void Allocate(size_t regionBytes);
+	void Release();
+};
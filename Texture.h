@@ -12,16 +12,25 @@ enum textureType
 	SPECULAR
 };
 
+// One image in a layer of a TextureArray. Textures don't own anything, the arrays made by
+// createTextureArrays hold the images and must outlive the textures that point into them.
 class Texture
 {
 public:
-	GLuint ID;
-	textureType type;
+	static const GLuint DIFFUSE_UNIT = 0;
+	static const GLuint SPECULAR_UNIT = 1;
+
+	// Name of the GL_TEXTURE_2D_ARRAY that holds the image
+	GLuint ID = 0;
+	GLint layer = 0;
+	textureType type = DIFFUSE;
 	std::string path;
-	Texture(const char* imagePath, textureType type, GLuint slot);
+	// Only a path and type, createTextureArrays loads the image later
+	Texture() {}
+	Texture(const std::string& imagePath, textureType type) : type(type), path(imagePath) {}
 
-	void SetTextureUnit(Shader& shader, const char* uniformVariableName, GLuint unit);
-	void Bind(GLuint slot);
+	// Points the array samplers of a shader to their units, once after it got compiled
+	static void SetTextureUnits(Shader& shader);
+	void Bind(GLuint unit) const;
 	void Unbind();
-	void Delete();
-};
\ No newline at end of file
+};
@@ -0,0 +1,140 @@
+#include "TextureArray.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <stb/stb_image.h>
+
+#include "DeletionQueue.h"
+#include "ImageSource.h"
+#include "MemoryTracker.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+
+GLenum textureFormat(int channels)
+{
+	return channels == 1 ? GL_RED : channels == 2 ? GL_RG : GL_RGBA;
+}
+
+TextureArray::TextureArray(TextureArray&& other) noexcept :
+	ID(other.ID), width(other.width), height(other.height), channels(other.channels), paths(std::move(other.paths))
+{
+	other.ID = 0;
+}
+
+TextureArray& TextureArray::operator=(TextureArray&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		width = other.width;
+		height = other.height;
+		channels = other.channels;
+		paths = std::move(other.paths);
+		other.ID = 0;
+	}
+	return *this;
+}
+
+void TextureArray::Create()
+{
+	glGenTextures(1, &ID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	if (TextureStreamer::enabled)
+	{
+		TextureStreamer::Register(ID, paths, width, height, channels);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return;
+	}
+
+	GLenum format = textureFormat(channels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, (GLsizei)paths.size(), 0, format, GL_UNSIGNED_BYTE, nullptr);
+	for (size_t layer = 0; layer < paths.size(); layer++)
+	{
+		int widthImage, heightImage, numColorChannel;
+		unsigned char* imageData = loadImage(paths[layer], &widthImage, &heightImage, &numColorChannel, channels);
+		if (imageData)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1, format, GL_UNSIGNED_BYTE, imageData);
+		else
+			std::cout << "Failed to load texture at path " << paths[layer] << std::endl;
+		stbi_image_free(imageData);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// The mip chain adds another third
+	MemoryTracker::Allocate(MEMORY_TEXTURE, ID, (size_t)width * height * channels * paths.size() * 4 / 3);
+}
+
+void TextureArray::Bind(GLuint unit)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+}
+
+void TextureArray::Delete()
+{
+	if (ID == 0)
+		return;
+	TextureStreamer::Forget(ID);
+	MemoryTracker::Free(MEMORY_TEXTURE, ID);
+	DeletionQueue::Delete(GL_OBJECT_TEXTURE, ID);
+	ID = 0;
+}
+
+std::vector<TextureArray> createTextureArrays(std::vector<Texture>& textures)
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (maxLayers <= 0)
+		maxLayers = 256;
+
+	// Arrays being filled, by size and format
+	std::map<std::tuple<int, int, int>, size_t> open;
+	std::vector<TextureArray> arrays;
+	std::vector<size_t> arrayOfTexture(textures.size(), SIZE_MAX);
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		int width, height, numColorChannel;
+		if (!imageInfo(textures[i].path, &width, &height, &numColorChannel))
+		{
+			std::cout << "Failed to load texture at path " << textures[i].path << std::endl;
+			continue;
+		}
+
+		int channels = numColorChannel == 3 ? 4 : numColorChannel;
+		auto key = std::make_tuple(width, height, channels);
+		auto found = open.find(key);
+		if (found == open.end() || arrays[found->second].paths.size() >= (size_t)maxLayers)
+		{
+			arrays.emplace_back();
+			arrays.back().width = width;
+			arrays.back().height = height;
+			arrays.back().channels = channels;
+			open[key] = arrays.size() - 1;
+			found = open.find(key);
+		}
+
+		TextureArray& array = arrays[found->second];
+		textures[i].layer = (GLint)array.paths.size();
+		array.paths.push_back(textures[i].path);
+		arrayOfTexture[i] = found->second;
+	}
+
+	for (TextureArray& array : arrays)
+		array.Create();
+	for (size_t i = 0; i < textures.size(); i++)
+		textures[i].ID = arrayOfTexture[i] == SIZE_MAX ? 0 : arrays[arrayOfTexture[i]].ID;
+	return arrays;
+}
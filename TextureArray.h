@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+class Texture;
+
+// Images of one size and format stacked into the layers of a GL_TEXTURE_2D_ARRAY. Meshes whose
+// textures share an array only differ in a layer index, so they draw without rebinding.
+// Owns its texture, moving hands it over and destruction releases it to the DeletionQueue.
+class TextureArray
+{
+public:
+	GLuint ID = 0;
+	int width = 0;
+	int height = 0;
+	// After RGB got expanded to RGBA
+	int channels = 0;
+	std::vector<std::string> paths;
+
+	TextureArray() {}
+	TextureArray(TextureArray&& other) noexcept;
+	TextureArray& operator=(TextureArray&& other) noexcept;
+	TextureArray(const TextureArray&) = delete;
+	TextureArray& operator=(const TextureArray&) = delete;
+	~TextureArray() { Delete(); }
+
+	// Loads every path into its layer, or hands them to the TextureStreamer when it is enabled
+	void Create();
+	void Bind(GLuint unit);
+	// Releases the texture early, the destructor does it otherwise
+	void Delete();
+};
+
+// Format of images with 1, 2 or 4 channels
+GLenum textureFormat(int channels);
+// Puts the images of the textures into one array per size and format, and sets the array and
+// layer of every texture. Images that can't be read keep an ID of 0.
+std::vector<TextureArray> createTextureArrays(std::vector<Texture>& textures);
@@ -0,0 +1,448 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stb/stb_image.h>
+
+#include "ImageSource.h"
+#include "MemoryTracker.h"
+#include "TextureArray.h"
+
+const int TextureStreamer::TAIL_SIZE;
+bool TextureStreamer::enabled = true;
+size_t TextureStreamer::budgetBytes = 0;
+
+namespace
+{
+	// Finished loads uploaded per frame, at least one is always taken
+	const size_t UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+	struct StreamedTexture
+	{
+		// Tells loads of a texture apart from loads of an earlier texture with the same name
+		unsigned int serial = 0;
+		// One per layer
+		std::vector<std::string> paths;
+		int width = 0;
+		int height = 0;
+		// RGB is expanded to RGBA, odd rows of three bytes would need their own alignment
+		int channels = 0;
+		GLenum format = GL_RGBA;
+		int numLevels = 0;
+		// The coarsest level larger than TAIL_SIZE is tailLevel - 1
+		int tailLevel = 0;
+		// Finest level on the GPU, the levels below it have no storage
+		int residentLevel = 0;
+		// Only the 1x1 placeholder in the last level is resident
+		bool placeholder = true;
+		int wantedLevel = 0;
+		unsigned long long lastNeeded = 0;
+		bool loading = false;
+		// Every layer failed to load
+		bool failed = false;
+		bool reported = false;
+	};
+
+	struct LoadJob
+	{
+		GLuint ID;
+		unsigned int serial;
+		std::vector<std::string> paths;
+		int width;
+		int height;
+		int channels;
+		int firstLevel;
+		int endLevel;
+	};
+
+	struct LoadResult
+	{
+		GLuint ID;
+		unsigned int serial;
+		int firstLevel;
+		// All layers of a level one after another
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<std::string> failedPaths;
+	};
+
+	// Only touched by the render thread
+	std::unordered_map<GLuint, StreamedTexture> textures;
+	std::vector<LoadResult> uploads;
+	unsigned int nextSerial = 1;
+	unsigned long long frame = 1;
+
+	// Shared with the loader threads
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<LoadJob> jobs;
+	std::vector<LoadResult> finished;
+	std::vector<std::thread> loaders;
+	bool stopping = false;
+
+	int LevelSize(int size, int level)
+	{
+		return std::max(1, size >> level);
+	}
+
+	size_t LevelBytes(const StreamedTexture& texture, int level)
+	{
+		return (size_t)LevelSize(texture.width, level) * LevelSize(texture.height, level) * texture.channels * texture.paths.size();
+	}
+
+	size_t LevelRangeBytes(const StreamedTexture& texture, int firstLevel, int endLevel)
+	{
+		size_t bytes = 0;
+		for (int level = firstLevel; level < endLevel; level++)
+			bytes += LevelBytes(texture, level);
+		return bytes;
+	}
+
+	size_t TextureBytes(const StreamedTexture& texture)
+	{
+		return texture.placeholder ? (size_t)texture.channels * texture.paths.size() : LevelRangeBytes(texture, texture.residentLevel, texture.numLevels);
+	}
+
+	// 2x2 box filter, the last row and column repeat when a size is odd
+	std::vector<unsigned char> Downsample(const std::vector<unsigned char>& source, int width, int height, int channels)
+	{
+		int halfWidth = std::max(1, width / 2);
+		int halfHeight = std::max(1, height / 2);
+		std::vector<unsigned char> result((size_t)halfWidth * halfHeight * channels);
+		for (int y = 0; y < halfHeight; y++)
+		{
+			int y0 = std::min(y * 2, height - 1);
+			int y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < halfWidth; x++)
+			{
+				int x0 = std::min(x * 2, width - 1);
+				int x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < channels; c++)
+				{
+					int sum = source[((size_t)y0 * width + x0) * channels + c] + source[((size_t)y0 * width + x1) * channels + c]
+						+ source[((size_t)y1 * width + x0) * channels + c] + source[((size_t)y1 * width + x1) * channels + c];
+					result[((size_t)y * halfWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		return result;
+	}
+
+	// Decodes whole images, they have no smaller levels on disk to read instead. Layers that
+	// fail to load stay black.
+	LoadResult Load(const LoadJob& job)
+	{
+		int width = job.width;
+		int height = job.height;
+		LoadResult result{ job.ID, job.serial, job.firstLevel, {}, {} };
+		for (int i = job.firstLevel; i < job.endLevel; i++)
+			result.levels.emplace_back((size_t)LevelSize(width, i) * LevelSize(height, i) * job.channels * job.paths.size());
+
+		for (size_t layer = 0; layer < job.paths.size(); layer++)
+		{
+			int widthImage, heightImage, fileChannels;
+			unsigned char* imageData = loadImage(job.paths[layer], &widthImage, &heightImage, &fileChannels, job.channels);
+			if (!imageData || widthImage != width || heightImage != height)
+			{
+				stbi_image_free(imageData);
+				result.failedPaths.push_back(job.paths[layer]);
+				continue;
+			}
+
+			std::vector<unsigned char> level(imageData, imageData + (size_t)width * height * job.channels);
+			stbi_image_free(imageData);
+			for (int i = 0; i < job.endLevel; i++)
+			{
+				if (i > 0)
+					level = Downsample(level, LevelSize(width, i - 1), LevelSize(height, i - 1), job.channels);
+				if (i >= job.firstLevel)
+					std::copy(level.begin(), level.end(), result.levels[i - job.firstLevel].begin() + layer * level.size());
+			}
+		}
+		return result;
+	}
+
+	void LoadTextures()
+	{
+		while (true)
+		{
+			LoadJob job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [] { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				job = jobs.front();
+				jobs.pop_front();
+			}
+
+			LoadResult result = Load(job);
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(result));
+		}
+	}
+
+	void StartLoad(GLuint ID, StreamedTexture& texture, int firstLevel, int endLevel)
+	{
+		if (loaders.empty())
+		{
+			stopping = false;
+			unsigned int count = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+			for (unsigned int i = 0; i < count; i++)
+				loaders.emplace_back(LoadTextures);
+		}
+
+		texture.loading = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(LoadJob{ ID, texture.serial, texture.paths, texture.width, texture.height, texture.channels, firstLevel, endLevel });
+		}
+		wakeUp.notify_one();
+	}
+
+	void SetBaseLevel(GLuint ID, int level)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+	}
+
+	void Upload(StreamedTexture& texture, const LoadResult& result)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, result.ID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t i = 0; i < result.levels.size(); i++)
+		{
+			int level = result.firstLevel + (int)i;
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, texture.format, LevelSize(texture.width, level), LevelSize(texture.height, level),
+				(GLsizei)texture.paths.size(), 0, texture.format, GL_UNSIGNED_BYTE, result.levels[i].data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		texture.placeholder = false;
+		texture.residentLevel = std::min(texture.residentLevel, result.firstLevel);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, texture.residentLevel);
+		MemoryTracker::Resize(MEMORY_TEXTURE, result.ID, TextureBytes(texture));
+	}
+
+	// Levels that were not asked for this frame, or are finer than what was asked for
+	bool Evictable(const StreamedTexture& texture)
+	{
+		return !texture.loading && !texture.placeholder && texture.residentLevel < texture.tailLevel
+			&& (texture.lastNeeded < frame || texture.residentLevel < texture.wantedLevel);
+	}
+
+	size_t TotalResidentBytes()
+	{
+		size_t bytes = 0;
+		for (auto& texture : textures)
+			bytes += TextureBytes(texture.second);
+		return bytes;
+	}
+
+	// Drops the finest level of the least recently needed textures until the budget holds
+	void Evict(size_t residentBytes)
+	{
+		while (residentBytes > TextureStreamer::budgetBytes)
+		{
+			GLuint victimID = 0;
+			StreamedTexture* victim = nullptr;
+			for (auto& texture : textures)
+			{
+				StreamedTexture& candidate = texture.second;
+				if (!Evictable(candidate))
+					continue;
+				bool unwanted = candidate.residentLevel < candidate.wantedLevel;
+				bool victimUnwanted = victim && victim->residentLevel < victim->wantedLevel;
+				if (!victim || (unwanted && !victimUnwanted)
+					|| (unwanted == victimUnwanted && candidate.lastNeeded < victim->lastNeeded))
+				{
+					victimID = texture.first;
+					victim = &candidate;
+				}
+			}
+			if (!victim)
+				return;
+
+			int level = victim->residentLevel;
+			residentBytes -= LevelBytes(*victim, level);
+			victim->residentLevel++;
+			SetBaseLevel(victimID, victim->residentLevel);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, victim->format, 0, 0, 0, 0, victim->format, GL_UNSIGNED_BYTE, nullptr);
+			MemoryTracker::Resize(MEMORY_TEXTURE, victimID, TextureBytes(*victim));
+		}
+	}
+}
+
+void TextureStreamer::Register(GLuint ID, const std::vector<std::string>& paths, int width, int height, int channels)
+{
+	StreamedTexture texture;
+	texture.serial = nextSerial++;
+	texture.paths = paths;
+	texture.width = width;
+	texture.height = height;
+	texture.channels = channels;
+	texture.format = textureFormat(channels);
+	texture.numLevels = (int)std::floor(std::log2((float)std::max(width, height))) + 1;
+	while (texture.tailLevel < texture.numLevels - 1
+		&& std::max(LevelSize(width, texture.tailLevel), LevelSize(height, texture.tailLevel)) > TAIL_SIZE)
+		texture.tailLevel++;
+	texture.residentLevel = texture.numLevels - 1;
+	texture.wantedLevel = texture.tailLevel;
+
+	// Mid grey until the tail arrives, sampling an incomplete texture would give black
+	std::vector<unsigned char> placeholder(channels * paths.size(), 128);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, texture.numLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, texture.residentLevel);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, texture.residentLevel, texture.format, 1, 1, (GLsizei)paths.size(), 0, texture.format, GL_UNSIGNED_BYTE, placeholder.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	MemoryTracker::Allocate(MEMORY_TEXTURE, ID, TextureBytes(texture));
+
+	StreamedTexture& registered = textures[ID] = texture;
+	StartLoad(ID, registered, texture.tailLevel, texture.numLevels);
+}
+
+void TextureStreamer::Forget(GLuint ID)
+{
+	if (textures.erase(ID) == 0)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const LoadJob& job) { return job.ID == ID; }), jobs.end());
+}
+
+void TextureStreamer::Request(GLuint ID, float uvPerPixel)
+{
+	auto found = textures.find(ID);
+	if (found == textures.end())
+		return;
+
+	// The level whose texels are about as large as a pixel
+	StreamedTexture& texture = found->second;
+	float texelsPerPixel = uvPerPixel * std::max(texture.width, texture.height);
+	int level = texelsPerPixel > 1.0f ? (int)std::floor(std::log2(texelsPerPixel)) : 0;
+	level = std::min(level, texture.tailLevel);
+	texture.wantedLevel = texture.lastNeeded == frame ? std::min(texture.wantedLevel, level) : level;
+	texture.lastNeeded = frame;
+}
+
+void TextureStreamer::Update()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (LoadResult& result : finished)
+			uploads.push_back(std::move(result));
+		finished.clear();
+	}
+
+	size_t uploadedBytes = 0;
+	size_t taken = 0;
+	for (; taken < uploads.size() && (taken == 0 || uploadedBytes < UPLOAD_BYTES_PER_FRAME); taken++)
+	{
+		LoadResult& result = uploads[taken];
+		auto found = textures.find(result.ID);
+		if (found == textures.end() || found->second.serial != result.serial)
+			continue;
+
+		StreamedTexture& texture = found->second;
+		texture.loading = false;
+		if (!result.failedPaths.empty() && !texture.reported)
+		{
+			for (const std::string& path : result.failedPaths)
+				std::cout << "Failed to load texture at path " << path << std::endl;
+			texture.reported = true;
+		}
+		// Finer levels of images that can't be read are not worth asking for again
+		texture.failed = result.failedPaths.size() == texture.paths.size();
+		Upload(texture, result);
+		for (const std::vector<unsigned char>& level : result.levels)
+			uploadedBytes += level.size();
+	}
+	uploads.erase(uploads.begin(), uploads.begin() + taken);
+
+	size_t residentBytes = TotalResidentBytes();
+	if (budgetBytes > 0)
+		Evict(residentBytes);
+	residentBytes = TotalResidentBytes();
+
+	// Closest to being needed first: asked for this frame, then the largest gap in levels
+	std::vector<std::pair<GLuint, StreamedTexture*>> wanted;
+	size_t evictableBytes = 0;
+	for (auto& texture : textures)
+	{
+		StreamedTexture& candidate = texture.second;
+		if (!candidate.loading && !candidate.failed && !candidate.placeholder && candidate.wantedLevel < candidate.residentLevel)
+			wanted.emplace_back(texture.first, &candidate);
+		if (Evictable(candidate))
+			evictableBytes += LevelRangeBytes(candidate, candidate.residentLevel, candidate.lastNeeded < frame ? candidate.tailLevel : candidate.wantedLevel);
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const std::pair<GLuint, StreamedTexture*>& a, const std::pair<GLuint, StreamedTexture*>& b)
+	{
+		if (a.second->lastNeeded != b.second->lastNeeded)
+			return a.second->lastNeeded > b.second->lastNeeded;
+		return a.second->residentLevel - a.second->wantedLevel > b.second->residentLevel - b.second->wantedLevel;
+	});
+
+	// Loads start only if they fit once the levels nobody needs are evicted, so two textures
+	// can't keep pushing each other out. A texture that doesn't fit gets the finest level that does.
+	size_t available = budgetBytes > 0 ? budgetBytes + evictableBytes - std::min(budgetBytes + evictableBytes, residentBytes) : SIZE_MAX;
+	for (auto& request : wanted)
+	{
+		StreamedTexture& texture = *request.second;
+		int firstLevel = texture.wantedLevel;
+		while (firstLevel < texture.residentLevel && LevelRangeBytes(texture, firstLevel, texture.residentLevel) > available)
+			firstLevel++;
+		if (firstLevel == texture.residentLevel)
+			continue;
+		available -= std::min(available, LevelRangeBytes(texture, firstLevel, texture.residentLevel));
+		StartLoad(request.first, texture, firstLevel, texture.residentLevel);
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	frame++;
+}
+
+void TextureStreamer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	wakeUp.notify_all();
+	for (std::thread& loader : loaders)
+		loader.join();
+	loaders.clear();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	finished.clear();
+	uploads.clear();
+	for (auto& texture : textures)
+		texture.second.loading = false;
+}
+
+size_t TextureStreamer::ResidentBytes()
+{
+	return TotalResidentBytes();
+}
+
+int TextureStreamer::NumTextures()
+{
+	return (int)textures.size();
+}
+
+int TextureStreamer::NumLoading()
+{
+	int loading = 0;
+	for (auto& texture : textures)
+		loading += texture.second.loading ? 1 : 0;
+	return loading;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// Streams the mip levels of texture arrays on background threads. A streamed array starts with
+// a 1x1 placeholder, then gets the tail of its mip chain up to TAIL_SIZE texels. Larger
+// levels are loaded once meshes ask for them with Request, and the least recently needed
+// levels are evicted again whenever the resident levels exceed the budget.
+//
+// Levels below the resident ones are released by respecifying them with a size of zero and
+// hidden behind GL_TEXTURE_BASE_LEVEL, so the GL name of a texture never changes. Levels of an
+// array hold all of its layers, they are loaded and evicted together.
+class TextureStreamer
+{
+public:
+	static const int TAIL_SIZE = 64;
+
+	// Read by TextureArray::Create, arrays made while it is off load all levels at once
+	static bool enabled;
+	// Bytes the streamed levels may occupy together, 0 lets them grow without limit
+	static size_t budgetBytes;
+
+	// Starts streaming images of the given size and channels into the layers of an array
+	// texture that has no storage yet
+	static void Register(GLuint ID, const std::vector<std::string>& paths, int width, int height, int channels);
+	static void Forget(GLuint ID);
+	// Asks for the level whose texels are about as large as a pixel this frame, given the UV
+	// units that one pixel covers. The finest level asked for in a frame counts.
+	static void Request(GLuint ID, float uvPerPixel);
+
+	// Uploads finished levels, evicts over the budget and starts new loads, once per frame
+	static void Update();
+	// Waits for the loader threads, pending loads are dropped
+	static void Stop();
+
+	static size_t ResidentBytes();
+	static int NumTextures();
+	static int NumLoading();
+};
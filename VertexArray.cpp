@@ -1,14 +1,40 @@
 #include "VertexArray.h"
 
+#include "DeletionQueue.h"
+
 VertexArray::VertexArray()
 {
 	glGenVertexArrays(1, &ID);
 }
 
-void VertexArray::LinkAttrib(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
+VertexArray::VertexArray(VertexArray&& other) noexcept : ID(other.ID)
+{
+	other.ID = 0;
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
+void VertexArray::LinkAttrib(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset, GLboolean normalized)
+{
+	VBO.Bind();
+	glVertexAttribPointer(layout, numComponents, type, normalized, stride, offset);
+	glEnableVertexAttribArray(layout);
+	VBO.Unbind();
+}
+
+void VertexArray::LinkAttribInteger(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
 {
 	VBO.Bind();
-	glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
+	glVertexAttribIPointer(layout, numComponents, type, stride, offset);
 	glEnableVertexAttribArray(layout);
 	VBO.Unbind();
 }
@@ -25,5 +51,6 @@ void VertexArray::Unbind()
 
 void VertexArray::Delete()
 {
-	glDeleteVertexArrays(1, &ID);
+	DeletionQueue::Delete(GL_OBJECT_VERTEX_ARRAY, ID);
+	ID = 0;
 }
\ No newline at end of file
@@ -3,14 +3,23 @@
 #include <glad/glad.h>
 #include "VertexBuffer.h"
 
+// Owns its vertex array, moving hands it over and destruction releases it to the DeletionQueue
 class VertexArray
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
 	VertexArray();
+	VertexArray(VertexArray&& other) noexcept;
+	VertexArray& operator=(VertexArray&& other) noexcept;
+	VertexArray(const VertexArray&) = delete;
+	VertexArray& operator=(const VertexArray&) = delete;
+	~VertexArray() { Delete(); }
 
-	void LinkAttrib(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
+	void LinkAttrib(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset, GLboolean normalized = GL_FALSE);
+	// Integer components reach the shader unconverted, for ivec and uvec inputs
+	void LinkAttribInteger(VertexBuffer& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
 	void Bind();
 	void Unbind();
+	// Releases the vertex array early, the destructor does it otherwise
 	void Delete();
 };
\ No newline at end of file
@@ -1,16 +1,52 @@
 #include "VertexBuffer.h"
 
+#include "DeletionQueue.h"
+#include "MemoryTracker.h"
+
 std::ostream& operator<<(std::ostream& os, const glm::vec3& vec)
 {
 	os << "(" << vec.x << ", " << vec.y << ", " << vec.z << ")";
 	return os;
 }
 
-VertexBuffer::VertexBuffer(std::vector<Vertex>& vertices)
+VertexBuffer::VertexBuffer(const std::vector<Vertex>& vertices)
 {
 	glGenBuffers(1, &ID);
 	glBindBuffer(GL_ARRAY_BUFFER, ID);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	MemoryTracker::Allocate(MEMORY_VERTEX_BUFFER, ID, vertices.size() * sizeof(Vertex));
+}
+
+VertexBuffer::VertexBuffer(size_t numVertices, const void* data)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(Vertex), data, GL_STATIC_DRAW);
+	MemoryTracker::Allocate(MEMORY_VERTEX_BUFFER, ID, numVertices * sizeof(Vertex));
+}
+
+VertexBuffer::VertexBuffer(size_t numVertices, const VertexSkin* skins)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(VertexSkin), skins, GL_STATIC_DRAW);
+	MemoryTracker::Allocate(MEMORY_VERTEX_BUFFER, ID, numVertices * sizeof(VertexSkin));
+}
+
+VertexBuffer::VertexBuffer(VertexBuffer&& other) noexcept : ID(other.ID)
+{
+	other.ID = 0;
+}
+
+VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
 }
 
 void VertexBuffer::Bind()
@@ -23,7 +59,36 @@ void VertexBuffer::Unbind()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+Vertex* VertexBuffer::Map(size_t numVertices)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	Vertex* vertices = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, numVertices * sizeof(Vertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!vertices)
+		std::cout << "ERROR::VERTEX_BUFFER::MAPPING_FAILED" << std::endl;
+	return vertices;
+}
+
+VertexSkin* VertexBuffer::MapSkins(size_t numVertices)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	VertexSkin* skins = (VertexSkin*)glMapBufferRange(GL_ARRAY_BUFFER, 0, numVertices * sizeof(VertexSkin), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!skins)
+		std::cout << "ERROR::VERTEX_BUFFER::MAPPING_FAILED" << std::endl;
+	return skins;
+}
+
+void VertexBuffer::Unmap()
+{
+	// False if the contents got lost while mapped, e.g. on a display mode change
+	if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+		std::cout << "ERROR::VERTEX_BUFFER::CONTENTS_LOST" << std::endl;
+}
+
 void VertexBuffer::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	if (ID == 0)
+		return;
+	MemoryTracker::Free(MEMORY_VERTEX_BUFFER, ID);
+	DeletionQueue::Delete(GL_OBJECT_BUFFER, ID);
+	ID = 0;
 }
\ No newline at end of file
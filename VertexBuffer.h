@@ -13,15 +13,39 @@ struct Vertex
 	glm::vec2 texureUV;
 };
 
+// The joints moving a vertex of a skinned mesh, kept in a stream of its own next to the
+// vertices. Joints index the model's palette, the weights are normalized bytes adding up to 255.
+struct VertexSkin
+{
+	GLushort joints[4];
+	GLubyte weights[4];
+};
+
 std::ostream& operator<<(std::ostream& os, const glm::vec3& vec);
 
+// Owns its buffer, moving hands it over and destruction releases it to the DeletionQueue
 class VertexBuffer
 {
 public:
-	GLuint ID;
-	VertexBuffer(std::vector<Vertex>& vertices);
+	GLuint ID = 0;
+	VertexBuffer() {}
+	VertexBuffer(const std::vector<Vertex>& vertices);
+	// Storage for numVertices vertices, copied from data or filled through Map if it is null
+	explicit VertexBuffer(size_t numVertices, const void* data = NULL);
+	// Storage for the skins of numVertices vertices, copied from skins or filled through MapSkins
+	VertexBuffer(size_t numVertices, const VertexSkin* skins);
+	VertexBuffer(VertexBuffer&& other) noexcept;
+	VertexBuffer& operator=(VertexBuffer&& other) noexcept;
+	VertexBuffer(const VertexBuffer&) = delete;
+	VertexBuffer& operator=(const VertexBuffer&) = delete;
+	~VertexBuffer() { Delete(); }
 
 	void Bind();
 	void Unbind();
+	// Binds the buffer and maps all of it for writing, the previous contents are discarded
+	Vertex* Map(size_t numVertices);
+	VertexSkin* MapSkins(size_t numVertices);
+	void Unmap();
+	// Releases the buffer early, the destructor does it otherwise
 	void Delete();
 };
\ No newline at end of file
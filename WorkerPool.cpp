@@ -0,0 +1,126 @@
+#include "WorkerPool.h"
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Held by the thread whose loop the workers run
+	std::mutex loopMutex;
+
+	// Shared with the workers
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::condition_variable finished;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+	// Counts the loops, a worker joins each one once
+	unsigned long long generation = 0;
+	const std::function<void(size_t)>* loopBody = nullptr;
+	size_t loopCount = 0;
+	std::atomic<size_t> nextIndex(0);
+	// Workers that join the current loop and workers still inside it
+	size_t loopWorkers = 0;
+	size_t busyWorkers = 0;
+	// What the workers allocated during the loop, handed to the thread that started it. The
+	// peaks are summed, the workers needn't reach theirs at the same time.
+	size_t loopAllocations = 0;
+	long long loopBytes = 0;
+	long long loopPeakBytes = 0;
+
+	void RunLoop()
+	{
+		for (size_t i = nextIndex++; i < loopCount; i = nextIndex++)
+			(*loopBody)(i);
+	}
+
+	void Work(size_t worker)
+	{
+		unsigned long long seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wakeUp.wait(lock, [&]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			if (worker >= loopWorkers)
+				continue;
+
+			lock.unlock();
+			size_t allocations = AllocationCounter::Count();
+			long long liveBytes = AllocationCounter::LiveBytes();
+			AllocationCounter::ResetPeak();
+			RunLoop();
+			lock.lock();
+			loopAllocations += AllocationCounter::Count() - allocations;
+			loopBytes += AllocationCounter::LiveBytes() - liveBytes;
+			loopPeakBytes += AllocationCounter::PeakBytes() - liveBytes;
+			if (--busyWorkers == 0)
+				finished.notify_one();
+		}
+	}
+}
+
+void WorkerPool::Stop()
+{
+	std::lock_guard<std::mutex> loopLock(loopMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+	stopping = false;
+}
+
+size_t WorkerPool::NumWorkers()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return workers.size();
+}
+
+void parallelFor(size_t count, unsigned int numThreads, const std::function<void(size_t)>& body)
+{
+	if (numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	size_t numWorkers = std::min<size_t>(numThreads, count);
+	numWorkers = numWorkers > 0 ? numWorkers - 1 : 0;
+	std::unique_lock<std::mutex> loopLock(loopMutex, std::defer_lock);
+	if (numWorkers == 0 || !loopLock.try_lock())
+	{
+		for (size_t i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (workers.size() < numWorkers)
+			workers.emplace_back(Work, workers.size());
+		loopBody = &body;
+		loopCount = count;
+		nextIndex = 0;
+		loopWorkers = numWorkers;
+		busyWorkers = numWorkers;
+		loopAllocations = 0;
+		loopBytes = 0;
+		loopPeakBytes = 0;
+		generation++;
+	}
+	wakeUp.notify_all();
+	RunLoop();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, []() { return busyWorkers == 0; });
+	loopBody = nullptr;
+	AllocationCounter::Add(loopAllocations, loopBytes, loopPeakBytes);
+}
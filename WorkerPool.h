@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Threads shared by every parallel loop of the renderer. They are started the first time a
+// loop needs them and sleep between loops, so work that runs every frame, like cluster
+// binning and pose sampling, doesn't pay for creating and joining threads each time.
+class WorkerPool
+{
+public:
+	// Waits for the workers to finish and ends them, the next loop starts them again
+	static void Stop();
+	static size_t NumWorkers();
+};
+
+// Runs body for every index below count on up to numThreads threads, the calling thread
+// included, 0 for one per core. Returns once every index is done. A loop started while the
+// pool is busy, from another thread or from inside a body, runs on its calling thread alone.
+// The workers' allocations are counted for the calling thread, see AllocationCounter.
+void parallelFor(size_t count, unsigned int numThreads, const std::function<void(size_t)>& body);
@@ -6,13 +6,23 @@ in vec2 texCoord;
 
 out vec4 FragColor;
 
+// Feature defines are injected by ShaderPermutations, see Shader.h
+
 uniform vec3 cameraPosition;
-uniform sampler2D textureDiffuse0;
-uniform sampler2D textureSpecular0;
 uniform float shininess;
 
-vec3 objectDiffuse = texture(textureDiffuse0, texCoord).rgb;
-vec3 objectSpecular = vec3(texture(textureSpecular0, texCoord).r);
+#ifdef TEXTURED
+uniform sampler2DArray textureDiffuse;
+uniform sampler2DArray textureSpecular;
+uniform int diffuseLayer;
+uniform int specularLayer;
+
+vec3 objectDiffuse = texture(textureDiffuse, vec3(texCoord, diffuseLayer)).rgb;
+vec3 objectSpecular = vec3(texture(textureSpecular, vec3(texCoord, specularLayer)).r);
+#else
+vec3 objectDiffuse = vec3(0.7f);
+vec3 objectSpecular = vec3(0.0f);
+#endif
 
 
 struct DirLight {
@@ -35,40 +45,47 @@ struct PointLight {
 	vec3 specular;
 };
 
-struct SpotLight {
-	vec3 position;
-	vec3 direction;
-	float cutOff;
-	float outerCutOff;
 
-	float constant;
-	float linear;
-	float quadratic;
+uniform DirLight dirLight;
+uniform PointLight pointLight;
 
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
+uniform mat4 view;
 
 
+#ifdef CLUSTERED_LIGHTING
+// Clustered lights, see ClusteredLights.h for the buffer layouts
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndices;
 
-#define MAX_POINT_LIGHTS 4
-#define MAX_SPOT_LIGHTS 4
+uniform vec2 screenSize;
+uniform float clusterNear;
+uniform float clusterFar;
+
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+#endif
 
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
 
-uniform int numSpotLights = 0;
+#ifdef SHADOWS
+// Cascaded shadow maps of the directional light, see CascadedShadowMap.h
+#define NUM_CASCADES 4
 
-uniform bool lighting = true;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpaceMatrices[NUM_CASCADES];
+uniform float cascadeSplits[NUM_CASCADES];
+#endif
 
 
 
 // Function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#ifdef CLUSTERED_LIGHTING
+vec3 CalcClusteredLights(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+#ifdef SHADOWS
+float CalcShadow(vec3 normal, vec3 fragPos);
+#endif
 
 
 
@@ -80,17 +97,15 @@ void main()
 	if (objectDiffuse == vec3(0.0f))
 		objectDiffuse = vec3(0.7f);
 
-	vec3 result;
-
-	if (lighting)
-	{
-		result = CalcDirLight(dirLight, normal, viewDir);
-		//	result += CalcPointLight(pointLight, normal, FragPosition, viewDir);
-		//	for (int i = 0; i < min(numSpotLights, MAX_SPOT_LIGHTS); i++)
-		//		result += CalcSpotLight(spotLights[i], normal, FragPosition, viewDir);
-	}
-	else
-		result = objectDiffuse;
+#ifdef LIGHTING
+	vec3 result = CalcDirLight(dirLight, normal, viewDir);
+	//	result += CalcPointLight(pointLight, normal, FragPosition, viewDir);
+#ifdef CLUSTERED_LIGHTING
+	result += CalcClusteredLights(normal, FragPosition, viewDir);
+#endif
+#else
+	vec3 result = objectDiffuse;
+#endif
 	
 		
 	FragColor = vec4(result, 1.0);
@@ -109,9 +124,89 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 	float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
 	vec3 specular = light.specular * specularAmount * objectSpecular;
 
+#ifdef SHADOWS
+	float shadow = CalcShadow(normal, FragPosition);
+#else
+	float shadow = 0.0;
+#endif
+
+	return (ambient + (1.0 - shadow) * (diffuse + specular));
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 frag2Light = normalize(light.position - FragPosition);
+
+	// Attenuation
+	float dist = length(light.position - FragPosition);
+	float attenuation = 1.0 / (light.quadratic * dist * dist + light.linear * dist + light.constant);
+
+
+
+	vec3 ambient = light.ambient * objectDiffuse;
+
+	vec3 diffuse = light.diffuse * max(dot(normal, frag2Light), 0.0) * objectDiffuse;
+
+	vec3 reflectionDirection = reflect(-frag2Light, normal);
+	float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
+	vec3 specular = light.specular * specularAmount * objectSpecular;
+
+
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+#ifdef CLUSTERED_LIGHTING
+vec3 CalcClusteredLights(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+#ifdef SHADOWS
+float CalcShadow(vec3 normal, vec3 fragPos);
+#endif
+
+
+
+void main()
+{
+	vec3 normal = normalize(Normal);
+	vec3 viewDir = normalize(cameraPosition - FragPosition);
+
+	if (objectDiffuse == vec3(0.0f))
+		objectDiffuse = vec3(0.7f);
+
+#ifdef LIGHTING
+	vec3 result = CalcDirLight(dirLight, normal, viewDir);
+	//	result += CalcPointLight(pointLight, normal, FragPosition, viewDir);
+#ifdef CLUSTERED_LIGHTING
+	result += CalcClusteredLights(normal, FragPosition, viewDir);
+#endif
+#else
+	vec3 result = objectDiffuse;
+#endif
+	
+		
+	FragColor = vec4(result, 1.0);
+}
+
+
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+{
+	vec3 ambient = light.ambient * objectDiffuse;
 
+	vec3 lightDirection = normalize(-light.direction);
+	vec3 diffuse = light.diffuse * max(dot(normal, lightDirection), 0.0) * objectDiffuse;
 
-	return (ambient + diffuse + specular);
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
+	vec3 specular = light.specular * specularAmount * objectSpecular;
+
+#ifdef SHADOWS
+	float shadow = CalcShadow(normal, FragPosition);
+#else
+	float shadow = 0.0;
+#endif
+
+	return (ambient + (1.0 - shadow) * (diffuse + specular));
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -164,4 +259,81 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 	
 	return (ambient + diffuse + specular) * intensity * attenuation;
-}
\ No newline at end of file
+}
+
+#ifdef CLUSTERED_LIGHTING
+vec3 CalcClusteredLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	// Find the froxel this fragment falls in, matching ClusteredLights::SliceDepth
+	float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+	int slice = int(log(viewDepth / clusterNear) / log(clusterFar / clusterNear) * float(CLUSTER_GRID.z));
+	ivec2 tile = ivec2(gl_FragCoord.xy / screenSize * vec2(CLUSTER_GRID.xy));
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), CLUSTER_GRID - 1);
+	uvec2 range = texelFetch(clusterGrid, (cluster.z * CLUSTER_GRID.y + cluster.y) * CLUSTER_GRID.x + cluster.x).rg;
+
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int base = int(texelFetch(lightIndices, int(range.x + i)).r) * 5;
+		vec4 positionRadius = texelFetch(lightData, base);
+		vec4 diffuseConstant = texelFetch(lightData, base + 1);
+		vec4 specularLinear = texelFetch(lightData, base + 2);
+		vec4 directionQuadratic = texelFetch(lightData, base + 3);
+		vec4 cone = texelFetch(lightData, base + 4);
+
+		vec3 frag2Light = positionRadius.xyz - fragPos;
+		float dist = length(frag2Light);
+		if (dist > positionRadius.w)
+			continue;
+		frag2Light /= dist;
+
+		// Attenuation
+		float attenuation = 1.0 / (directionQuadratic.w * dist * dist + specularLinear.w * dist + diffuseConstant.w);
+
+		vec3 diffuse = diffuseConstant.rgb * max(dot(normal, frag2Light), 0.0) * objectDiffuse;
+
+		vec3 reflectionDirection = reflect(-frag2Light, normal);
+		float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
+		vec3 specular = specularLinear.rgb * specularAmount * objectSpecular;
+
+		// Spotlight intensity, point lights have cone.z == 0
+		float intensity = 1.0;
+		if (cone.z > 0.0)
+		{
+			float angle = dot(frag2Light, -directionQuadratic.xyz);
+			intensity = clamp((angle - cone.y) / (cone.x - cone.y), 0.0, 1.0);
+		}
+
+		result += (diffuse + specular) * intensity * attenuation;
+	}
+	return result;
+}
+#endif
+
+#ifdef SHADOWS
+float CalcShadow(vec3 normal, vec3 fragPos)
+{
+	// Pick the first cascade whose split lies beyond the fragment
+	float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+	int cascade = 0;
+	while (cascade < NUM_CASCADES && viewDepth > cascadeSplits[cascade])
+		cascade++;
+	if (cascade == NUM_CASCADES)
+		return 0.0;
+
+	vec4 lightSpacePosition = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
+	vec3 projected = lightSpacePosition.xyz / lightSpacePosition.w * 0.5 + 0.5;
+	if (projected.z > 1.0)
+		return 0.0;
+
+	// 3x3 PCF on top of the hardware comparison
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+	{
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadowMap, vec4(projected.xy + vec2(x, y) * texelSize, float(cascade), projected.z));
+	}
+	return 1.0 - lit / 9.0;
+}
+#endif
\ No newline at end of file
@@ -3,20 +3,53 @@
 layout (location = 0) in vec3 aPosition;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+#ifdef SKINNING
+// Four palette entries and their weights per vertex
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+#endif
 
 out vec3 Normal;
 out vec3 FragPosition;
 out vec2 texCoord;
 
 uniform mat4 camera;
-uniform mat4 model;
-uniform mat3 normalMatrix;
+// Matrices of this draw in the per-frame draw data, see DrawData.h for the layout
+uniform samplerBuffer drawData;
+uniform int drawIndex;
+#ifdef SKINNING
+// Rows of the joint matrices of this frame, 3 texels per palette entry, see Animator.h
+uniform samplerBuffer bonePalette;
+uniform int paletteBase;
+#endif
 
 void main()
 {
-	vec4 currentPosition = model * vec4(aPosition, 1.0);
+	int base = drawIndex * 7;
+	mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+	mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+#ifdef SKINNING
+	// Blends the rows of the weighted joint matrices, the weights add up to one
+	vec4 row0 = vec4(0.0);
+	vec4 row1 = vec4(0.0);
+	vec4 row2 = vec4(0.0);
+	for (int i = 0; i < 4; i++)
+	{
+		int entry = paletteBase + int(aJoints[i]) * 3;
+		row0 += aWeights[i] * texelFetch(bonePalette, entry);
+		row1 += aWeights[i] * texelFetch(bonePalette, entry + 1);
+		row2 += aWeights[i] * texelFetch(bonePalette, entry + 2);
+	}
+	vec4 position = vec4(aPosition, 1.0);
+	vec3 localPosition = vec3(dot(row0, position), dot(row1, position), dot(row2, position));
+	vec3 localNormal = vec3(dot(row0.xyz, aNormal), dot(row1.xyz, aNormal), dot(row2.xyz, aNormal));
+#else
+	vec3 localPosition = aPosition;
+	vec3 localNormal = aNormal;
+#endif
+	vec4 currentPosition = model * vec4(localPosition, 1.0);
 	gl_Position = camera * currentPosition;
 	FragPosition = vec3(currentPosition);
-	Normal = normalMatrix * aNormal;
+	Normal = normalMatrix * localNormal;
 	texCoord = aTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 330 core
+
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseCamera;
+uniform vec3 cameraPosition;
+uniform float shininess;
+
+
+struct DirLight {
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+uniform DirLight dirLight;
+
+
+
+void main()
+{
+	float depth = texture(gDepth, texCoord).r;
+	// Nothing was drawn here, keep the clear color
+	if (depth == 1.0)
+		discard;
+
+	vec4 clipPosition = vec4(vec3(texCoord, depth) * 2.0 - 1.0, 1.0);
+	vec4 worldPosition = inverseCamera * clipPosition;
+	vec3 fragPosition = worldPosition.xyz / worldPosition.w;
+
+	vec4 albedoSpecular = texture(gAlbedoSpecular, texCoord);
+	vec3 objectDiffuse = albedoSpecular.rgb;
+	vec3 objectSpecular = vec3(albedoSpecular.a);
+	vec3 normal = texture(gNormal, texCoord).xyz;
+	vec3 viewDir = normalize(cameraPosition - fragPosition);
+
+	vec3 ambient = dirLight.ambient * objectDiffuse;
+
+	vec3 lightDirection = normalize(-dirLight.direction);
+	vec3 diffuse = dirLight.diffuse * max(dot(normal, lightDirection), 0.0) * objectDiffuse;
+
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
+	vec3 specular = dirLight.specular * specularAmount * objectSpecular;
+
+	FragColor = vec4(ambient + diffuse + specular, 1.0);
+}
@@ -0,0 +1,73 @@
+#version 330 core
+
+flat in int lightIndex;
+
+out vec4 FragColor;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform vec2 screenSize;
+uniform mat4 inverseCamera;
+uniform vec3 cameraPosition;
+uniform float shininess;
+
+// Shared light buffer, see LightManager.h for the layout
+uniform samplerBuffer lightData;
+
+
+
+void main()
+{
+	// Light volumes are rasterized in screen space, so the G-buffer is sampled at the fragment itself
+	vec2 uv = gl_FragCoord.xy / screenSize;
+	float depth = texture(gDepth, uv).r;
+
+	vec4 clipPosition = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	vec4 worldPosition = inverseCamera * clipPosition;
+	vec3 fragPosition = worldPosition.xyz / worldPosition.w;
+
+	int base = lightIndex * 5;
+	vec4 positionRadius = texelFetch(lightData, base);
+	vec4 diffuseConstant = texelFetch(lightData, base + 1);
+	vec4 specularLinear = texelFetch(lightData, base + 2);
+	vec4 directionQuadratic = texelFetch(lightData, base + 3);
+	vec4 cone = texelFetch(lightData, base + 4);
+
+	float dist = length(positionRadius.xyz - fragPosition);
+	if (dist > positionRadius.w)
+		discard;
+
+	vec4 albedoSpecular = texture(gAlbedoSpecular, uv);
+	vec3 objectDiffuse = albedoSpecular.rgb;
+	vec3 objectSpecular = vec3(albedoSpecular.a);
+	vec3 normal = texture(gNormal, uv).xyz;
+	vec3 viewDir = normalize(cameraPosition - fragPosition);
+	vec3 frag2Light = (positionRadius.xyz - fragPosition) / dist;
+
+	// Attenuation
+	float attenuation = 1.0 / (directionQuadratic.w * dist * dist + specularLinear.w * dist + diffuseConstant.w);
+
+
+
+	vec3 diffuse = diffuseConstant.rgb * max(dot(normal, frag2Light), 0.0) * objectDiffuse;
+
+	vec3 reflectionDirection = reflect(-frag2Light, normal);
+	float specularAmount = pow(max(dot(viewDir, reflectionDirection), 0.0), shininess);
+	vec3 specular = specularLinear.rgb * specularAmount * objectSpecular;
+
+
+
+	// Spotlight intensity, point lights have cone.z == 0
+	float intensity = 1.0;
+	if (cone.z > 0.0)
+	{
+		float angle = dot(frag2Light, -directionQuadratic.xyz);
+		intensity = clamp((angle - cone.y) / (cone.x - cone.y), 0.0, 1.0);
+	}
+
+
+
+	FragColor = vec4((diffuse + specular) * intensity * attenuation, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPosition;
+
+flat out int lightIndex;
+
+uniform mat4 camera;
+uniform samplerBuffer lightData;
+
+void main()
+{
+	// One instance per light, the unit cube is placed and scaled from the shared light buffer
+	lightIndex = gl_InstanceID;
+	vec4 positionRadius = texelFetch(lightData, gl_InstanceID * 5);
+	gl_Position = camera * vec4(positionRadius.xyz + aPosition * positionRadius.w, 1.0);
+}
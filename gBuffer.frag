@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormal;
+
+in vec3 Normal;
+in vec3 FragPosition;
+in vec2 texCoord;
+
+uniform sampler2DArray textureDiffuse;
+uniform sampler2DArray textureSpecular;
+uniform int diffuseLayer;
+uniform int specularLayer;
+
+void main()
+{
+	vec3 objectDiffuse = texture(textureDiffuse, vec3(texCoord, diffuseLayer)).rgb;
+	if (objectDiffuse == vec3(0.0f))
+		objectDiffuse = vec3(0.7f);
+
+	gAlbedoSpecular = vec4(objectDiffuse, texture(textureSpecular, vec3(texCoord, specularLayer)).r);
+	gNormal = vec4(normalize(Normal), 0.0);
+}
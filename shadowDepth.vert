@@ -0,0 +1,41 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPosition;
+#ifdef SKINNING
+// Four palette entries and their weights per vertex
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+#endif
+
+uniform mat4 lightSpace;
+// Model matrix in the first 4 texels of the draw, see DrawData.h
+uniform samplerBuffer drawData;
+uniform int drawIndex;
+#ifdef SKINNING
+// Rows of the joint matrices of this frame, see default.vert
+uniform samplerBuffer bonePalette;
+uniform int paletteBase;
+#endif
+
+void main()
+{
+	int base = drawIndex * 7;
+	mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+#ifdef SKINNING
+	vec4 row0 = vec4(0.0);
+	vec4 row1 = vec4(0.0);
+	vec4 row2 = vec4(0.0);
+	for (int i = 0; i < 4; i++)
+	{
+		int entry = paletteBase + int(aJoints[i]) * 3;
+		row0 += aWeights[i] * texelFetch(bonePalette, entry);
+		row1 += aWeights[i] * texelFetch(bonePalette, entry + 1);
+		row2 += aWeights[i] * texelFetch(bonePalette, entry + 2);
+	}
+	vec4 position = vec4(aPosition, 1.0);
+	vec3 localPosition = vec3(dot(row0, position), dot(row1, position), dot(row2, position));
+#else
+	vec3 localPosition = aPosition;
+#endif
+	gl_Position = lightSpace * model * vec4(localPosition, 1.0);
+}
\ No newline at end of file